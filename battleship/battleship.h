@@ -1,83 +1,188 @@
 #ifndef BATTLESHIP_H
 #define BATTLESHIP_H
 
-#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <ctype.h>
 #include "../common/protocol.h"
 
-#define BOARD_SIZE    8
-#define TOTAL_SHIPS   4  // SUBMARINO(1) + FRAGATA(2) + DESTROYER(1)
-#define MAX_NAME_LEN  32
-#define MAX_CLIENTS   2
+#define BOARD_SIZE      8     // tabuleiro do modo clássico
+#define MAX_NAME_LEN    32
+#define MAX_CLIENTS     2
 
-// Tipos de navio
-typedef enum { SUBMARINE = 1, FRAGATA = 2, DESTROYER = 3 } ShipType;
+// Limites dos modos de jogo configuráveis em tempo de execução
+#define MAX_BOARD_DIM   1024
+#define MAX_SHIP_LEN    64    // cabe no bitset de segmentos atingidos
+#define MAX_SHIP_KINDS  8
+#define MAX_FLEET_SHIPS 255   // índice de navio cabe em um byte no índice espacial
+#define MAX_KIND_NAME   16
+#define MAX_MODE_NAME   16
+#define MAX_MODES       8
+
+// Tipo de navio: índice em GameMode.kinds
+typedef int ShipType;
 typedef enum { HORIZONTAL, VERTICAL } Orientation;
 
 // Estrutura de coordenada
 typedef struct { int x, y; } Coord;
 
-// Tabuleiro protegido por mutex
+// Verbos do protocolo de texto
+typedef enum { CK_JOIN, CK_POS, CK_READY, CK_FIRE, CK_WATCH, CK_RESUME, CK_UNKNOWN } CommandKind;
+
+// Trecho de uma linha de comando, sem '\0' no fim
+typedef struct { const char *s; int len; } Token;
+
+// Linha de comando separada por parse_command; os Tokens apontam para a própria linha
+typedef struct {
+    CommandKind kind;
+    bool        valid;       // argumentos no formato do verbo (senão ERR_BAD_FORMAT)
+    union {
+        struct { Token name, mode; }              join;    // mode.len == 0 sem modo
+        struct { Token type; int x, y; char ori; } pos;    // ori é 'H', 'h', 'V' ou 'v'
+        struct { int x, y; }                      fire;
+        struct { Token arg; uint32_t match; }     attach;  // WATCH <partida> (match), RESUME <sessão>
+    };
+} Command;
+
+// Um tipo de embarcação de um modo de jogo
+typedef struct {
+    char name[MAX_KIND_NAME];
+    int  size;                   // células ocupadas
+    int  count;                  // quantas cada jogador posiciona
+} ShipKind;
+
+// Descritor de modo de jogo: dimensões do tabuleiro e composição da frota
 typedef struct {
-    int grid[BOARD_SIZE][BOARD_SIZE];  // 0=vazio, >0=navio intacto, <0=navio atingido
-    pthread_mutex_t lock;
+    char     name[MAX_MODE_NAME];
+    int      width, height;      // x em 0..width-1, y em 0..height-1
+    int      kind_count;
+    ShipKind kinds[MAX_SHIP_KINDS];
+    int      total_ships;        // soma de kinds[].count
+    int      total_cells;        // soma de size * count
+} GameMode;
+
+// Bitboard: um bit por célula, bit (x * height + y); só para tabuleiros de até 64 células
+typedef uint64_t Bitboard;
+#define BITBOARD_CELLS 64
+
+// Tabuleiros pequenos usam bitboards; nos grandes, o estado fica nos navios e
+// num índice espacial célula -> navio, então o custo cresce com a frota e não com a área.
+typedef struct {
+    const GameMode *mode;
+    Bitboard  occupied;          // células com navio (tabuleiros pequenos)
+    Bitboard  hit;               // células de navio já atingidas (tabuleiros pequenos)
+    uint32_t *index;             // hash aberto: ((célula + 1) << 8) | navio; NULL nos pequenos
+    int       index_bits;        // capacidade do índice = 1 << index_bits
+    int       live_cells;        // células de navio ainda intactas
 } Board;
 
-// Representação de uma embarcação
+// Representação de uma embarcação. É o que mais se repete por partida (a frota dos dois
+// jogadores), então os campos usam a menor largura que os limites dos modos permitem:
+// 24 bytes, sem buracos de alinhamento.
 typedef struct {
-    ShipType   type;              // tipo (tamanho)
-    int        size;              // cópia de (int)type
-    int        hits;              // quantos acertos já sofreu
-    Coord      coords[BOARD_SIZE];// posições ocupadas
-    int        coord_count;       // quantas posições (== size)
+    uint64_t   hits;              // bitset de segmentos atingidos (bit i = i-ésima célula)
+    Bitboard   cells;             // posições ocupadas (tabuleiros pequenos)
+    struct { int16_t x, y; } origin;  // primeira célula (até MAX_BOARD_DIM)
+    uint8_t    type;              // ShipType: índice em mode->kinds
+    uint8_t    size;              // células ocupadas (até MAX_SHIP_LEN)
+    uint8_t    orientation;       // Orientation
     bool       placed;            // se já foi posicionado
 } Ship;
 
-// Estado de cada jogador
+// Estado de cada jogador (campos agrupados por largura para não sobrar preenchimento)
 typedef struct {
     int sockfd;
-    char name[MAX_NAME_LEN];
     int player_id;         // 1 ou 2
+    int      ship_count;        // quantas embarcações já registrou
+    unsigned errors;   // respostas de erro já enviadas (o servidor limita a taxa delas)
+    char name[MAX_NAME_LEN];
     bool joined;           // se fez JOIN
-    Ship     ships[TOTAL_SHIPS];
-    int      ship_count;        // quantos embarcações já registrou (até 4)
-    Board board;
+    bool binary;       // negociou o protocolo binário (ver protocol.h)
     bool ready;        // Se já está pronto
     bool active_turn;  // Seu turno está ativo
+    Ship    *ships;             // mode->total_ships posições
+    struct OutBuf *out; // saída acumulada da conexão no servidor; NULL envia direto
+    Board board;
 } Player;
 
-// Estado global do jogo
+// Estado de uma partida (uma instância por partida em andamento).
+// Sem locks: a partida tem um único dono, que aplica os comandos em ordem (no servidor,
+// o shard que a recebeu do lobby; nas ferramentas, a thread que a simula).
 typedef struct {
+    const GameMode *mode;      // dimensões e frota desta partida
+    void *storage;             // bloco único com navios e índices dos dois jogadores
+    struct Audience *audience; // espectadores no servidor (eventos públicos); NULL sem nenhum
     Player players[MAX_CLIENTS];
+    uint32_t id;               // identificador da partida no servidor (0: nenhuma)
     int count;
-    pthread_mutex_t mutex;     // protege players e cond_ready
-    pthread_cond_t cond_ready; // sinaliza quando ambos deram READY
+    unsigned turns;            // turnos anunciados; muda sempre que a vez passa
+    int forfeit;               // player_id de quem perdeu por W.O. (0 se ninguém)
     bool game_over;
     bool game_started;         // controla se o jogo já começou
+    bool owns_storage;         // storage alocado por init_game (e liberado por destroy_game)
 } Game;
 
-// Seta o necessário para inicar um jogo
-void init_game(Game *game);
+// Seta o necessário para inicar um jogo no modo indicado; false se faltar memória
+bool init_game(Game *game, const GameMode *mode);
+// Tamanho do bloco com os navios e índices dos dois jogadores no modo
+size_t game_storage_size(const GameMode *mode);
+// Como init_game, mas sobre um bloco zerado de game_storage_size() bytes que continua
+// sendo de quem chamou (ex.: uma fatia do snapshot mapeado em memória)
+void init_game_in(Game *game, const GameMode *mode, void *storage);
+// Refaz contadores, bitboards e índices a partir dos navios já gravados no bloco
+void game_restore_boards(Game *game);
+// Reenvia a um jogador que reconectou (RESUME) o contexto da partida
+void rejoin_player(Game *game, Player *p);
+// Libera os recursos (memória dos tabuleiros e plateia) de uma partida encerrada
+void destroy_game(Game *game);
 // Adiciona um jogador ao servidor
 bool add_player(Game *game, int sockfd);
-// Lida com os comandos que o player manda para o servidor
-void *handle_client(void *arg);
 // Envia uma mensagem para um jogador em especifíco
 void send_to_player(Player *p, const char *msg);
-// Envia uma mensagem para ambos os jogadores
+// Envia um quadro do protocolo binário para um jogador que o negociou
+void send_frame(Player *p, const uint8_t *frame, size_t len);
+// Envia uma mensagem para ambos os jogadores (e para os espectadores)
 void broadcast(const Game *game, const char *msg);
+// Separa verbo e argumentos de uma linha de len bytes (sem o \n) numa passada, sem cópia
+void parse_command(const char *line, size_t len, Command *cmd);
+// Aplica à partida um comando já separado
+void apply_command(Game *game, Player *p, const Command *cmd);
+// parse_command + apply_command de uma linha terminada em '\0'
 void process_command(Game *game, Player *p, const char *cmd);
+// Aplica um quadro binário completo (opcode + payload) vindo do jogador
+void process_frame(Game *game, Player *p, const uint8_t *frame);
+// Converte um quadro binário de comando na linha de texto equivalente
+void format_frame(const Game *game, const uint8_t *frame, char *out, size_t size);
+// Banner de texto e quadro OP_MODE (6 + 2*BIN_MAX_KINDS bytes) que descrevem o modo
+void format_mode_banner(const GameMode *mode, char *out, size_t size);
+size_t build_mode_frame(const GameMode *mode, uint8_t *frame);
 // Verifica se pode posicionar uma embarcação na coordenas solicitadas
 bool can_place(Player *p, ShipType type, Coord c, Orientation o);
 // Adiciona a embarcação nas coordenadas solicitadas
 bool place_ship(Player *p, ShipType type, Coord c, Orientation o);
+// Índice em p->ships do navio que ocupa a célula; -1 se é água ou está fora do tabuleiro
+int ship_at(const Player *p, Coord c);
 // Lida com as regras de um tiro por um jogador
 void handle_fire(Game *game, Player *p, Coord c);
-// Verifica as condições para um jogador vencer
+// Verifica as condições para um jogador vencer (inclusive por W.O.)
 bool check_winner(Game *game, Player **winner, Player **loser);
-// Faz a conversão de uma string para o tipo de embarcação(enum ShyType)
-ShipType parse_ship_type(const char *s);
+// Prazo da fase esgotado: perde quem não ficou pronto no posicionamento ou o jogador da
+// vez na batalha; se ninguém ficou pronto a partida termina sem vencedor
+void game_timeout(Game *game);
+// Encerra a partida com loser perdendo por W.O. (NULL: sem vencedor)
+void forfeit_game(Game *game, Player *loser);
+// Faz a conversão de uma string para o tipo de embarcação do modo; -1 se não existir
+ShipType parse_ship_type(const GameMode *mode, const char *s);
+// Nome de jogador aceito no JOIN: não vazio, sem espaços nem bytes de controle
+bool valid_player_name(const char *name, size_t len);
+// Modo clássico: 8x8 com SUBMARINO, 2 FRAGATAs e DESTROYER
+const GameMode *classic_game_mode(void);
+// Modo de evento: tabuleiro grande com frota numerosa (registrar com parse_game_mode)
+#define EVENT_MODE_SPEC "EVENTO:1024x1024:PORTA-AVIOES=5x10,ENCOURACADO=4x20," \
+                        "CRUZADOR=3x30,FRAGATA=2x40,SUBMARINO=1x50"
+// Lê um modo no formato NOME:LxA:TIPO=TAMxQTD[,TIPO=TAMxQTD...]; false se inválido
+bool parse_game_mode(const char *spec, GameMode *out);
 // Procura por um player pelo id do socket
 Player* find_player_by_socket(Game *g, int sockfd);
 
@@ -2,15 +2,28 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/ioctl.h>
 #include <arpa/inet.h>
 #include <sys/select.h>
 #include <ctype.h>
 
 #include "battleship.h"
 #include "../common/protocol.h"
+#include "../common/histogram.h"
 
 #define SERVER_PORT 8080
 #define SERVER_IP "127.0.0.1"
+#define SCRIPT_MAX_CMDS 1024
+#define SCRIPT_IDLE_SECS 30   // sem nada do servidor por este tempo, o script desiste
+
+// Códigos de saída do modo script
+#define EXIT_WIN        0
+#define EXIT_LOSE       1
+#define EXIT_UNFINISHED 2   // conexão perdida, tempo esgotado ou partida sem resultado
 
 void print_instructions() {
     printf("\n=== BATALHA NAVAL ===\n");
@@ -45,34 +58,193 @@ void print_separator() {
     printf("----------------------------------------\n");
 }
 
-int main() {
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) {
-        perror("socket");
-        return 1;
+static bool has_prefix(const char *s, const char *prefix) {
+    return strncmp(s, prefix, strlen(prefix)) == 0;
+}
+
+// player_id do BEM-VINDO ou da SESSÃO RETOMADA
+static bool parse_player_id(const char *line, int *id) {
+    return sscanf(line, "=== BEM-VINDO, %*s VOCÊ É O PLAYER %d", id) == 1 ||
+           sscanf(line, "=== SESSÃO RETOMADA: %*s VOCÊ É O PLAYER %d", id) == 1;
+}
+
+/* ---------------------------------------------------------------------------
+ * Tabuleiros (modo interativo)
+ *
+ * O cliente guarda uma cópia dos dois tabuleiros. A própria frota vem das
+ * confirmações de POS, e os tiros dos dois lados vêm das linhas ATACOU. Os
+ * tabuleiros ficam no topo do terminal e as mensagens rolam numa região abaixo
+ * deles (DECSTBM). Cada mudança redesenha só a célula alterada, posicionando o
+ * cursor com ANSI, sem reimprimir a tela: em SSH lento ou tabuleiro grande, um
+ * tiro custa poucos bytes.
+ * ------------------------------------------------------------------------- */
+
+enum { CELL_WATER, CELL_SHIP, CELL_HIT, CELL_MISS, CELL_SUNK };
+static const char cell_glyph[] = { '.', 'N', 'X', 'o', '*' };
+
+#define BOARD_LABEL 4   // coluna dos números das linhas
+#define BOARD_GAP   4   // espaço entre os dois tabuleiros
+#define MIN_LOG_ROWS 6  // linhas mínimas para as mensagens abaixo dos tabuleiros
+
+typedef struct {
+    bool     on;            // desenhando (terminal ANSI com espaço para os tabuleiros)
+    int      rows, cols;    // x de 1 a rows (linhas), y de 1 a cols (colunas)
+    int      cell_w;        // colunas do terminal por célula
+    int      own_col, target_col;  // coluna do terminal da primeira célula de cada um
+    int      me;            // player_id; os tiros dele vão para o alvo
+    int      kind_count;
+    char     kind_names[MAX_SHIP_KINDS][MAX_KIND_NAME];
+    int      kind_sizes[MAX_SHIP_KINDS];
+    uint8_t *own, *target;  // CELL_*, linha a linha
+} Boards;
+
+static Boards boards;
+
+// Devolve o terminal ao normal (região de rolagem inteira, cursor no fim)
+static void boards_restore_terminal(void) {
+    if (!boards.on) return;
+    static const char reset[] = "\033[r\033[999;1H\n";
+    if (write(STDOUT_FILENO, reset, sizeof(reset) - 1) < 0) {}
+}
+
+static void boards_on_signal(int sig) {
+    boards_restore_terminal();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+// Frota do banner do modo, ex.: "FROTA: SUBMARINO(1)x1, FRAGATA(2)x2 ==="
+static void parse_fleet(const char *fleet) {
+    boards.kind_count = 0;
+    const char *p = fleet;
+    int used;
+    char name[MAX_KIND_NAME];
+    int size, count;
+    while (boards.kind_count < MAX_SHIP_KINDS &&
+           sscanf(p, " %15[^(,](%d)x%d%n", name, &size, &count, &used) == 3)
+    {
+        snprintf(boards.kind_names[boards.kind_count], MAX_KIND_NAME, "%s", name);
+        boards.kind_sizes[boards.kind_count++] = size;
+        p += used;
+        if (*p == ',') p++;
     }
+}
 
-    struct sockaddr_in serv = {0};
-    serv.sin_family = AF_INET;
-    serv.sin_port   = htons(SERVER_PORT);
-    inet_pton(AF_INET, SERVER_IP, &serv.sin_addr);
+// Desenha a moldura e o conteúdo de um tabuleiro a partir da coluna col
+static void draw_board(const uint8_t *cells, int col, const char *title) {
+    printf("\033[1;%dH%s", col, title);
+    printf("\033[2;%dH", col);
+    for (int y = 1; y <= boards.cols; y++) printf("%-*d", boards.cell_w, y % 10);
+    for (int x = 1; x <= boards.rows; x++) {
+        printf("\033[%d;%dH%*d ", 2 + x, col - BOARD_LABEL, BOARD_LABEL - 1, x);
+        for (int y = 1; y <= boards.cols; y++) {
+            printf("%-*c", boards.cell_w, cell_glyph[cells[(x - 1) * boards.cols + (y - 1)]]);
+        }
+    }
+}
 
-    printf("Conectando ao servidor...\n");
-    if (connect(sock, (struct sockaddr*)&serv, sizeof(serv)) < 0) {
-        perror("Erro ao conectar");
-        close(sock);
-        return 1;
+// Tabuleiro rows x cols do modo da partida: prepara as cópias e, se o terminal
+// comportar, limpa a tela uma vez e desenha os dois tabuleiros
+static void boards_start(int rows, int cols) {
+    if (rows == boards.rows && cols == boards.cols && boards.own) return;  // RESUME
+    free(boards.own);
+    free(boards.target);
+    boards.rows   = rows;
+    boards.cols   = cols;
+    boards.own    = calloc((size_t)rows * cols, 1);
+    boards.target = calloc((size_t)rows * cols, 1);
+    boards_restore_terminal();
+    boards.on = false;
+    if (!boards.own || !boards.target || !isatty(STDOUT_FILENO)) return;
+
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1) return;
+    int need_rows = rows + 3 + MIN_LOG_ROWS;
+    for (boards.cell_w = 2; boards.cell_w >= 1; boards.cell_w--) {
+        int width = 2 * (BOARD_LABEL + cols * boards.cell_w) + BOARD_GAP;
+        if (width <= ws.ws_col) break;
     }
+    if (boards.cell_w == 0 || need_rows > ws.ws_row) {
+        printf("[tabuleiro %dx%d não cabe no terminal %dx%d; mostrando só as mensagens]\n",
+               rows, cols, ws.ws_col, ws.ws_row);
+        return;
+    }
+    boards.own_col    = 1 + BOARD_LABEL;
+    boards.target_col = boards.own_col + cols * boards.cell_w + BOARD_GAP + BOARD_LABEL;
+    boards.on = true;
 
-    printf("Conectado ao servidor!\n");
+    printf("\033[2J");
+    draw_board(boards.own, boards.own_col, "SUA FROTA");
+    draw_board(boards.target, boards.target_col, "ALVO");
+    // as mensagens rolam só abaixo dos tabuleiros
+    printf("\033[%d;%dr\033[%d;1H", rows + 4, ws.ws_row, rows + 4);
+    fflush(stdout);
+}
+
+// Muda uma célula da cópia e, se mudou, redesenha só ela (o cursor volta para onde estava).
+// x e y vêm do servidor: fora do tabuleiro a linha é ignorada.
+static void board_set(uint8_t *cells, int col, int x, int y, int value) {
+    if (!cells || x < 1 || x > boards.rows || y < 1 || y > boards.cols) return;
+    uint8_t *cell = &cells[(x - 1) * boards.cols + (y - 1)];
+    if (*cell == value) return;
+    // tiro repetido numa parte já atingida volta como MISS: não apaga o acerto
+    if (value == CELL_MISS && *cell >= CELL_HIT) return;
+    *cell = (uint8_t)value;
+    if (boards.on) {
+        printf("\0337\033[%d;%dH%c\0338", 2 + x, col + (y - 1) * boards.cell_w, cell_glyph[value]);
+    }
+}
+
+// Atualiza as cópias a partir de uma linha do servidor
+static void boards_line(const char *line) {
+    int id, rows, cols, x, y;
+    char name[MAX_KIND_NAME], ori, result[8];
+    const char *p;
+
+    if (parse_player_id(line, &id)) {
+        boards.me = id;
+    } else if (sscanf(line, "=== MODO %*s TABULEIRO %dx%d", &rows, &cols) == 2) {
+        if ((p = strstr(line, "FROTA: ")) != NULL) parse_fleet(p + strlen("FROTA: "));
+        boards_start(rows, cols);
+    } else if (sscanf(line, "*** %15s em %d,%d %c!", name, &x, &y, &ori) == 4) {
+        // POS confirmado: HORIZONTAL ocupa as colunas seguintes, VERTICAL as linhas
+        for (int k = 0; k < boards.kind_count; k++) {
+            if (strcmp(boards.kind_names[k], name) != 0) continue;
+            for (int i = 0; i < boards.kind_sizes[k]; i++) {
+                bool horizontal = (ori == 'H' || ori == 'h');
+                board_set(boards.own, boards.own_col,
+                          x + (horizontal ? 0 : i), y + (horizontal ? i : 0), CELL_SHIP);
+            }
+        }
+    } else if (sscanf(line, "=== PLAYER %d", &id) == 1 && (p = strstr(line, " ATACOU ")) &&
+               sscanf(p, " ATACOU %d %d: %7s", &x, &y, result) == 3)
+    {
+        int value = strcmp(result, CMD_SUNK) == 0 ? CELL_SUNK
+                  : strcmp(result, CMD_HIT) == 0  ? CELL_HIT : CELL_MISS;
+        bool mine = (id == boards.me);
+        uint8_t *cells = mine ? boards.target : boards.own;
+        int col = mine ? boards.target_col : boards.own_col;
+        board_set(cells, col, x, y, value);
+    }
+    if (boards.on) fflush(stdout);
+}
+
+// Modo interativo: comandos digitados no terminal
+static int run_interactive(int sock) {
     print_instructions();
-    print_board_guide();
+    // no terminal os tabuleiros da partida aparecem quando o modo for anunciado
+    if (!isatty(STDOUT_FILENO)) print_board_guide();
+    atexit(boards_restore_terminal);
+    signal(SIGINT, boards_on_signal);
+    signal(SIGTERM, boards_on_signal);
     
     printf("> ");
     fflush(stdout);
 
     fd_set fds;
     char buf[MAX_MSG];
+    char line[MAX_MSG];
+    size_t line_len = 0;
     bool game_ended = false;
 
     while (!game_ended) {
@@ -93,6 +265,17 @@ int main() {
                 break;
             }
             buf[n] = '\0';
+
+            // atualiza os tabuleiros com as linhas completas (uma linha pode vir partida)
+            for (ssize_t i = 0; i < n; i++) {
+                if (buf[i] == '\n' || line_len == sizeof(line) - 1) {
+                    line[line_len] = '\0';
+                    boards_line(line);
+                    line_len = 0;
+                } else {
+                    line[line_len++] = buf[i];
+                }
+            }
             
             // Remove \n no final se houver
             if (buf[n-1] == '\n') {
@@ -153,7 +336,274 @@ int main() {
         }
     }
 
+    boards_restore_terminal();
+    boards.on = false;
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * Modo script (--script)
+ *
+ * Envia os comandos de um arquivo o mais rápido que o protocolo permite. JOIN,
+ * POS e READY vão em sequência sem esperar resposta: o servidor guarda o que
+ * chegar antes do pareamento e responde na ordem. FIRE espera a vez do jogador.
+ * Cada resposta é casada com o comando mais antigo ainda sem resposta, o que dá
+ * o tempo de ida e volta de cada um.
+ * ------------------------------------------------------------------------- */
+
+enum { SC_JOIN, SC_POS, SC_READY, SC_FIRE, SC_OTHER };
+
+typedef struct {
+    char     line[MAX_MSG];
+    int      kind;      // SC_*
+    uint64_t sent_at;   // us
+} ScriptCmd;
+
+typedef struct {
+    ScriptCmd *cmds;
+    int        count;
+    int        sent;     // próximo a enviar
+    int        acked;    // próximo a receber resposta (cmds[acked..sent) estão pendentes)
+    int        me;       // player_id recebido no BEM-VINDO
+    bool       my_turn;
+    int        outcome;  // EXIT_*
+    bool       over;     // recebeu END
+    int        errors;
+    Histogram  rtt;
+} Script;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+static int command_kind(const char *line) {
+    if (has_prefix(line, CMD_JOIN))  return SC_JOIN;
+    if (has_prefix(line, CMD_POS))   return SC_POS;
+    if (has_prefix(line, CMD_READY)) return SC_READY;
+    if (has_prefix(line, CMD_FIRE))  return SC_FIRE;
+    return SC_OTHER;
+}
+
+// Lê os comandos do arquivo; linhas vazias e começadas por '#' são ignoradas
+static bool script_load(Script *sc, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    sc->cmds = calloc(SCRIPT_MAX_CMDS, sizeof(*sc->cmds));
+    if (!sc->cmds) {
+        perror("calloc");
+        fclose(f);
+        return false;
+    }
+    char line[MAX_MSG];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '\0' || *p == '#') continue;
+        if (sc->count == SCRIPT_MAX_CMDS) {
+            fprintf(stderr, "%s: mais de %d comandos\n", path, SCRIPT_MAX_CMDS);
+            break;
+        }
+        ScriptCmd *c = &sc->cmds[sc->count++];
+        snprintf(c->line, sizeof(c->line), "%s", p);
+        c->kind = command_kind(p);
+    }
+    fclose(f);
+    return true;
+}
+
+// Envia, num único send, tudo o que já pode ir. Retorna false se a conexão caiu.
+static bool script_send(Script *sc, int sock) {
+    char buf[MAX_MSG * 4];
+    size_t len = 0;
+    uint64_t now = now_us();
+    while (sc->sent < sc->count && !sc->over) {
+        ScriptCmd *c = &sc->cmds[sc->sent];
+        bool idle = sc->acked == sc->sent;
+        // FIRE só na própria vez; comandos desconhecidos um de cada vez, sem nada pendente
+        if (c->kind == SC_FIRE && (!idle || !sc->my_turn)) break;
+        if (c->kind == SC_OTHER && !idle) break;
+        if (sc->acked < sc->sent && sc->cmds[sc->sent - 1].kind == SC_OTHER) break;
+
+        size_t n = strlen(c->line);
+        if (len + n + 1 > sizeof(buf)) break;
+        memcpy(buf + len, c->line, n);
+        buf[len + n] = '\n';
+        len += n + 1;
+        c->sent_at = now;
+        sc->sent++;
+        if (c->kind == SC_FIRE) sc->my_turn = false;
+    }
+    if (len > 0 && send(sock, buf, len, MSG_NOSIGNAL) != (ssize_t)len) {
+        perror("Erro ao enviar comando");
+        return false;
+    }
+    return true;
+}
+
+// A resposta de kind chegou: fecha o comando pendente mais antigo
+static void script_ack(Script *sc, int kind, bool error) {
+    if (sc->acked == sc->sent) return;
+    ScriptCmd *c = &sc->cmds[sc->acked];
+    if (!error && kind != c->kind) return;
+    sc->acked++;
+    uint64_t rtt = now_us() - c->sent_at;
+    hist_record(&sc->rtt, rtt);
+    if (error) sc->errors++;
+    printf("[RTT] %-28s %8llu us%s\n", c->line, (unsigned long long)rtt, error ? " (erro)" : "");
+}
+
+// Interpreta uma linha do servidor: respostas aos comandos e mudanças de estado
+static void script_line(Script *sc, const char *line) {
+    int id;
+    if (has_prefix(line, "ERRO") || has_prefix(line, "COMANDO INVÁLIDO")) {
+        script_ack(sc, -1, true);
+    } else if (parse_player_id(line, &id)) {
+        sc->me = id;
+        script_ack(sc, has_prefix(line, "=== BEM-VINDO") ? SC_JOIN : SC_OTHER, false);
+    } else if (has_prefix(line, "*** ") && strstr(line, " navios) ***")) {
+        script_ack(sc, SC_POS, false);
+    } else if (sscanf(line, "*** PLAYER %d", &id) == 1 && strstr(line, "PRONTO")) {
+        if (id == sc->me) script_ack(sc, SC_READY, false);
+    } else if (sscanf(line, "=== PLAYER %d", &id) == 1 && strstr(line, " ATACOU ")) {
+        if (id == sc->me) script_ack(sc, SC_FIRE, false);
+    } else if (sscanf(line, "--- TURNO DO PLAYER %d", &id) == 1) {
+        sc->my_turn = (id == sc->me);
+    } else if (strstr(line, "VOCÊ VENCEU!")) {
+        sc->outcome = EXIT_WIN;
+    } else if (has_prefix(line, "=== ") && strstr(line, ") PERDEU! ===")) {
+        sc->outcome = EXIT_LOSE;
+    } else if (strcmp(line, "END") == 0) {
+        sc->over = true;
+    }
+}
+
+static void script_report(const Script *sc) {
+    const char *names[] = { [EXIT_WIN] = "VITÓRIA", [EXIT_LOSE] = "DERROTA",
+                            [EXIT_UNFINISHED] = "SEM RESULTADO" };
+    printf("[SCRIPT] resultado: %s; %d de %d comandos enviados, %d respondidos, %d erros\n",
+           names[sc->outcome], sc->sent, sc->count, sc->acked, sc->errors);
+    const Histogram *h = &sc->rtt;
+    if (h->total > 0) {
+        printf("[SCRIPT] ida e volta (us): n=%llu média=%llu p50=%llu p90=%llu p99=%llu máx=%llu\n",
+               (unsigned long long)h->total, (unsigned long long)(h->sum / h->total),
+               (unsigned long long)hist_percentile(h, 50),
+               (unsigned long long)hist_percentile(h, 90),
+               (unsigned long long)hist_percentile(h, 99),
+               (unsigned long long)h->max);
+    }
+}
+
+// Executa o script até o fim da partida; retorna o código de saída (EXIT_*)
+static int run_script(int sock, const char *path) {
+    Script sc = { .outcome = EXIT_UNFINISHED };
+    hist_init(&sc.rtt);
+    if (!script_load(&sc, path)) return EXIT_UNFINISHED;
+
+    char in[MAX_MSG * 4];
+    size_t inlen = 0;
+    while (!sc.over && script_send(&sc, sock)) {
+        struct pollfd pfd = { .fd = sock, .events = POLLIN };
+        int r = poll(&pfd, 1, SCRIPT_IDLE_SECS * 1000);
+        if (r < 0) {
+            perror("poll");
+            break;
+        }
+        if (r == 0) {
+            printf("[SCRIPT] nada do servidor em %d s; desistindo\n", SCRIPT_IDLE_SECS);
+            break;
+        }
+        ssize_t n = recv(sock, in + inlen, sizeof(in) - inlen - 1, 0);
+        if (n <= 0) {
+            printf("Conexão com servidor perdida.\n");
+            break;
+        }
+        inlen += (size_t)n;
+
+        // linhas completas; uma linha maior que o buffer é cortada
+        char *start = in, *nl;
+        in[inlen] = '\0';
+        while ((nl = memchr(start, '\n', in + inlen - start)) != NULL) {
+            *nl = '\0';
+            if (*start) printf("%s\n", start);
+            script_line(&sc, start);
+            start = nl + 1;
+        }
+        inlen -= (size_t)(start - in);
+        if (inlen == sizeof(in) - 1) inlen = 0;
+        memmove(in, start, inlen);
+    }
+    if (!sc.over) sc.outcome = EXIT_UNFINISHED;
+    script_report(&sc);
+    free(sc.cmds);
+    return sc.outcome;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Uso: %s [-H ip] [-p porta] [--script arquivo]\n"
+        "  -H ip            servidor (padrão %s)\n"
+        "  -p porta         porta do servidor (padrão %d)\n"
+        "  -s, --script arquivo\n"
+        "                   envia os comandos do arquivo sem interação e imprime o tempo\n"
+        "                   de ida e volta de cada um; sai com %d se vencer, %d se perder\n"
+        "                   e %d se a partida não terminar\n",
+        prog, SERVER_IP, SERVER_PORT, EXIT_WIN, EXIT_LOSE, EXIT_UNFINISHED);
+}
+
+int main(int argc, char *argv[]) {
+    const char *ip = SERVER_IP;
+    int port = SERVER_PORT;
+    const char *script = NULL;
+    static const struct option longopts[] = {
+        { "script", required_argument, NULL, 's' },
+        { "help",   no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "H:p:s:h", longopts, NULL)) != -1) {
+        switch (opt) {
+        case 'H': ip = optarg; break;
+        case 'p': port = atoi(optarg); break;
+        case 's': script = optarg; break;
+        default:  usage(argv[0]); return opt == 'h' ? 0 : EXIT_UNFINISHED;
+        }
+    }
+    if (port <= 0 || port > 65535) {
+        usage(argv[0]);
+        return EXIT_UNFINISHED;
+    }
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        return EXIT_UNFINISHED;
+    }
+
+    struct sockaddr_in serv = {0};
+    serv.sin_family = AF_INET;
+    serv.sin_port   = htons(port);
+    if (inet_pton(AF_INET, ip, &serv.sin_addr) != 1) {
+        fprintf(stderr, "Endereço inválido: %s\n", ip);
+        return EXIT_UNFINISHED;
+    }
+
+    printf("Conectando ao servidor...\n");
+    if (connect(sock, (struct sockaddr*)&serv, sizeof(serv)) < 0) {
+        perror("Erro ao conectar");
+        close(sock);
+        return EXIT_UNFINISHED;
+    }
+    printf("Conectado ao servidor!\n");
+
+    int status = script ? run_script(sock, script) : run_interactive(sock);
+
     close(sock);
     printf("Desconectado do servidor.\n");
-    return 0;
-}
\ No newline at end of file
+    return status;
+}
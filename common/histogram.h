@@ -0,0 +1,79 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+
+/* -------------------------------------------------------------------------
+ * Histograma log-linear (estilo HDR) para latências em microssegundos.
+ *
+ * Valores abaixo de 2^HIST_SUB_BITS têm balde próprio; acima disso cada
+ * potência de 2 é dividida em 2^HIST_SUB_BITS baldes, o que dá erro relativo
+ * de ~3% em qualquer escala com tamanho fixo e sem alocação.
+ * ------------------------------------------------------------------------- */
+
+#define HIST_SUB_BITS 5
+#define HIST_SUB      (1u << HIST_SUB_BITS)
+#define HIST_BUCKETS  ((64 - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t min, max;
+} Histogram;
+
+static inline void hist_init(Histogram *h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+static inline int hist_index(uint64_t v) {
+    if (v < HIST_SUB) return (int)v;
+    int msb   = 63 - __builtin_clzll(v);
+    int shift = msb - HIST_SUB_BITS;
+    return ((shift + 1) << HIST_SUB_BITS) + (int)((v >> shift) & (HIST_SUB - 1));
+}
+
+// Maior valor que cai no balde idx
+static inline uint64_t hist_bucket_max(int idx) {
+    if (idx < (int)HIST_SUB) return (uint64_t)idx;
+    int shift = (idx >> HIST_SUB_BITS) - 1;
+    uint64_t base = (uint64_t)(HIST_SUB + (idx & (HIST_SUB - 1)));
+    return ((base + 1) << shift) - 1;
+}
+
+static inline void hist_record(Histogram *h, uint64_t v) {
+    h->counts[hist_index(v)]++;
+    h->total++;
+    h->sum += v;
+    if (v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+}
+
+static inline void hist_merge(Histogram *dst, const Histogram *src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) dst->counts[i] += src->counts[i];
+    dst->total += src->total;
+    dst->sum   += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+// Valor do percentil p (0..100); 0 se o histograma está vazio
+static inline uint64_t hist_percentile(const Histogram *h, double p) {
+    if (h->total == 0) return 0;
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)h->total + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > h->total) rank = h->total;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint64_t v = hist_bucket_max(i);
+            return v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,62 @@
+#ifndef MPSC_H
+#define MPSC_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+/* -------------------------------------------------------------------------
+ * Fila intrusiva sem lock com vários produtores e um consumidor (Vyukov).
+ *
+ * Produzir é uma troca atômica do head e uma escrita no next do anterior;
+ * consumir só lê. O nó fica embutido no item (sem alocação por mensagem).
+ * Entre a troca e a escrita do next o produtor ainda não terminou: mpsc_pop
+ * devolve NULL nesse instante, então o produtor deve acordar o consumidor só
+ * depois de mpsc_push (ex.: escrevendo num eventfd) e o item sai na próxima vez.
+ * ------------------------------------------------------------------------- */
+
+typedef struct MpscNode {
+    _Atomic(struct MpscNode *) next;
+} MpscNode;
+
+typedef struct {
+    _Atomic(MpscNode *) head;   // último inserido (produtores)
+    MpscNode           *tail;   // próximo a sair (só o consumidor)
+    MpscNode            stub;
+} MpscQueue;
+
+static inline void mpsc_init(MpscQueue *q) {
+    atomic_store_explicit(&q->stub.next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&q->head, &q->stub, memory_order_relaxed);
+    q->tail = &q->stub;
+}
+
+static inline void mpsc_push(MpscQueue *q, MpscNode *n) {
+    atomic_store_explicit(&n->next, NULL, memory_order_relaxed);
+    MpscNode *prev = atomic_exchange_explicit(&q->head, n, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, n, memory_order_release);
+}
+
+// Próximo nó na ordem de inserção; NULL se vazia (ou com um push pela metade)
+static inline MpscNode *mpsc_pop(MpscQueue *q) {
+    MpscNode *tail = q->tail;
+    MpscNode *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (tail == &q->stub) {
+        if (!next) return NULL;
+        q->tail = tail = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+    if (next) {
+        q->tail = next;
+        return tail;
+    }
+    if (tail != atomic_load_explicit(&q->head, memory_order_acquire)) return NULL;
+
+    // tail é o único nó: recoloca o stub atrás dele para poder entregá-lo
+    mpsc_push(q, &q->stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (!next) return NULL;
+    q->tail = next;
+    return tail;
+}
+
+#endif // MPSC_H
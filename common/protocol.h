@@ -14,5 +14,121 @@
 #define CMD_SUNK "SUNK"
 #define CMD_WIN "WIN"
 #define CMD_LOSE "LOSE"
+#define CMD_WATCH "WATCH"
+#define CMD_RESUME "RESUME"
+
+/* ---------------------------------------------------------------------------
+ * Protocolo binário (opcional)
+ *
+ * Negociação: se o primeiro byte que o cliente envia na conexão for BIN_MAGIC,
+ * seguido de BIN_VERSION, o servidor responde com os mesmos dois bytes e a
+ * partir daí os dois lados trocam apenas quadros binários. Qualquer outro
+ * primeiro byte mantém o protocolo de texto.
+ *
+ * Quadro: [opcode u8][payload de tamanho fixo, definido pelo opcode].
+ * Inteiros em ordem de rede (big-endian); coordenadas começam em 1, como no
+ * texto; nomes são bytes com '\0' de preenchimento.
+ * ------------------------------------------------------------------------- */
+
+#define BIN_MAGIC   0xB5
+#define BIN_VERSION 2   // 2: id da partida à parte no OP_RESUME e no OP_SESSION
+
+#define BIN_NAME_LEN 32
+#define BIN_MODE_LEN 16
+#define BIN_MAX_KINDS 8
+
+// Cliente -> servidor
+#define OP_JOIN    0x01  // name[32] mode[16] (modo vazio = padrão do servidor)
+#define OP_POS     0x02  // kind u8, x u16, y u16, orientation u8 (0=H, 1=V)
+#define OP_READY   0x03  // -
+#define OP_FIRE    0x04  // x u16, y u16
+#define OP_WATCH   0x05  // match_id u32 (assistir à partida em vez de jogar)
+#define OP_RESUME  0x06  // match_id u32, segredo u64 (voltar ao assento de uma sessão)
+
+// Servidor -> cliente
+#define OP_WAITING 0x81  // -  (na fila do lobby)
+#define OP_WELCOME 0x82  // player_id u8, match_id u32
+#define OP_MODE    0x83  // width u16, height u16, kind_count u8, {size u8, count u8}[8]
+#define OP_PLACED  0x84  // kind u8, x u16, y u16, orientation u8, placed u8, total u8
+#define OP_READIED 0x85  // player_id u8
+#define OP_TURN    0x86  // player_id u8 (quem joga agora)
+#define OP_SHOT    0x87  // player_id u8, x u16, y u16, result u8
+#define OP_RESULT  0x88  // outcome u8 (OUTCOME_WIN / OUTCOME_LOSE)
+#define OP_END     0x89  // -
+#define OP_ERROR   0x8A  // code u8
+#define OP_WINNER  0x8B  // player_id u8 (só para espectadores)
+#define OP_SESSION 0x8C  // match_id u32, segredo u64 (para o RESUME depois de uma queda)
+
+// Resultado de um tiro
+#define RESULT_MISS 0
+#define RESULT_HIT  1
+#define RESULT_SUNK 2
+
+#define OUTCOME_WIN  1
+#define OUTCOME_LOSE 2
+
+// Códigos de erro do OP_ERROR (cada um corresponde a uma mensagem "ERRO: ..." do texto)
+#define ERR_UNKNOWN_COMMAND 1
+#define ERR_BAD_FORMAT      2
+#define ERR_NOT_JOINED      3
+#define ERR_ALREADY_JOINED  4
+#define ERR_UNKNOWN_MODE    5
+#define ERR_GAME_STARTED    6
+#define ERR_NOT_STARTED     7
+#define ERR_ALREADY_READY   8
+#define ERR_SHIPS_MISSING   9
+#define ERR_BAD_COORD       10
+#define ERR_BAD_TYPE        11
+#define ERR_TYPE_LIMIT      12
+#define ERR_BAD_POSITION    13
+#define ERR_NOT_YOUR_TURN   14
+#define ERR_UNKNOWN_MATCH   15
+#define ERR_BAD_SESSION     16
+#define ERR_DRAINING        17
+#define ERR_FLOOD           18
+#define ERR_TIMEOUT         19
+
+// Tamanho do payload de cada opcode; -1 se o opcode não existe
+static inline int bin_payload_size(unsigned char op) {
+    switch (op) {
+    case OP_JOIN:    return BIN_NAME_LEN + BIN_MODE_LEN;
+    case OP_POS:     return 6;
+    case OP_READY:   return 0;
+    case OP_FIRE:    return 4;
+    case OP_WATCH:   return 4;
+    case OP_RESUME:  return 12;
+    case OP_WAITING: return 0;
+    case OP_WELCOME: return 5;
+    case OP_MODE:    return 5 + 2 * BIN_MAX_KINDS;
+    case OP_PLACED:  return 8;
+    case OP_READIED: return 1;
+    case OP_TURN:    return 1;
+    case OP_SHOT:    return 6;
+    case OP_RESULT:  return 1;
+    case OP_END:     return 0;
+    case OP_ERROR:   return 1;
+    case OP_WINNER:  return 1;
+    case OP_SESSION: return 12;
+    default:         return -1;
+    }
+}
+
+static inline void bin_put16(unsigned char *p, unsigned v) {
+    p[0] = (unsigned char)(v >> 8);
+    p[1] = (unsigned char)v;
+}
+
+static inline void bin_put32(unsigned char *p, unsigned long v) {
+    bin_put16(p, (unsigned)(v >> 16));
+    bin_put16(p + 2, (unsigned)v);
+}
+
+static inline unsigned bin_get16(const unsigned char *p) {
+    return ((unsigned)p[0] << 8) | p[1];
+}
+
+static inline unsigned long bin_get32(const unsigned char *p) {
+    return ((unsigned long)bin_get16(p) << 16) | bin_get16(p + 2);
+}
 
 #endif
@@ -0,0 +1,419 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ai.h"
+#include "../common/protocol.h"
+
+#define DENSITY_PLANES 16   // bits do contador de densidade por célula
+#define TARGET_PLANE   5    // posições que cobrem um acerto pesam 2^5 na fase de alvo
+#define PLACE_TRIES    1000
+#define HUNT_SAMPLES   32   // células livres avaliadas por tiro na caça dos tabuleiros grandes
+
+struct Bot {
+    const GameMode *mode;
+    int       width, height;
+    uint32_t  cells;
+    uint64_t  rng;
+    int       remaining[MAX_SHIP_KINDS];  // navios ainda não afundados por tipo
+    int       max_size;                   // maior navio restante (alcance das corridas)
+
+    bool      pending;                    // tiro disparado aguardando resultado
+    Coord     last;
+
+    // tabuleiros de até 64 células
+    bool      small;
+    Bitboard  full;
+    Bitboard  miss, hit, sunk;            // hit: acertos em navios ainda não afundados
+    Bitboard  start_h[MAX_SHIP_KINDS];    // origens em que cada tipo cabe na horizontal
+    Bitboard  start_v[MAX_SHIP_KINDS];
+
+    // tabuleiros grandes
+    uint8_t  *shot_map;                   // bit por célula: já atirou
+    uint8_t  *live_map;                   // bit por célula: acerto em navio não afundado
+    Coord    *hits;                       // células de live_map, para a fase de alvo
+    int       hit_count;
+    uint32_t  perm_next, perm_mask, perm_a, perm_c;
+};
+
+// splitmix64
+static uint64_t next_rand(Bot *b) {
+    uint64_t z = (b->rng += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static inline uint32_t cell_index(const Bot *b, int x, int y) {
+    return (uint32_t)x * (uint32_t)b->height + (uint32_t)y;
+}
+
+static inline bool map_test(const uint8_t *map, uint32_t cell) {
+    return map[cell >> 3] & (1u << (cell & 7));
+}
+
+static inline void map_set(uint8_t *map, uint32_t cell) {
+    map[cell >> 3] |= (uint8_t)(1u << (cell & 7));
+}
+
+static inline void map_clear(uint8_t *map, uint32_t cell) {
+    map[cell >> 3] &= (uint8_t)~(1u << (cell & 7));
+}
+
+static void update_max_size(Bot *b) {
+    b->max_size = 1;
+    for (int k = 0; k < b->mode->kind_count; k++) {
+        int size = b->mode->kinds[k].size;
+        if (b->remaining[k] > 0 && size > b->max_size) b->max_size = size;
+    }
+}
+
+Bot *ai_create(const GameMode *mode, uint64_t seed) {
+    Bot *b = calloc(1, sizeof(*b));
+    if (!b) return NULL;
+    b->mode   = mode;
+    b->width  = mode->width;
+    b->height = mode->height;
+    b->cells  = (uint32_t)mode->width * (uint32_t)mode->height;
+    b->rng    = seed;
+    b->small  = b->cells <= BITBOARD_CELLS;
+    for (int k = 0; k < mode->kind_count; k++) b->remaining[k] = mode->kinds[k].count;
+    update_max_size(b);
+
+    if (b->small) {
+        b->full = b->cells == 64 ? ~(Bitboard)0 : ((Bitboard)1 << b->cells) - 1;
+        for (int k = 0; k < mode->kind_count; k++) {
+            int size = mode->kinds[k].size;
+            for (int x = 0; x < b->width; x++) {
+                for (int y = 0; y < b->height; y++) {
+                    Bitboard bit = (Bitboard)1 << cell_index(b, x, y);
+                    if (y + size <= b->height) b->start_h[k] |= bit;
+                    if (x + size <= b->width)  b->start_v[k] |= bit;
+                }
+            }
+        }
+        return b;
+    }
+
+    size_t map_size = (b->cells + 7) / 8;
+    b->shot_map = calloc(map_size, 1);
+    b->live_map = calloc(map_size, 1);
+    b->hits     = malloc((size_t)mode->total_cells * sizeof(Coord));
+    if (!b->shot_map || !b->live_map || !b->hits) {
+        ai_destroy(b);
+        return NULL;
+    }
+    // permutação completa das células: LCG com módulo potência de 2 (a = 1 mod 4, c ímpar)
+    b->perm_mask = 1;
+    while (b->perm_mask < b->cells) b->perm_mask <<= 1;
+    b->perm_mask--;
+    b->perm_a    = ((uint32_t)next_rand(b) & ~3u) | 1u;
+    b->perm_c    = (uint32_t)next_rand(b) | 1u;
+    b->perm_next = (uint32_t)next_rand(b) & b->perm_mask;
+    return b;
+}
+
+void ai_destroy(Bot *b) {
+    if (!b) return;
+    free(b->shot_map);
+    free(b->live_map);
+    free(b->hits);
+    free(b);
+}
+
+bool ai_next_placement(Bot *b, Player *self, ShipType *type, Coord *c, Orientation *o) {
+    const GameMode *mode = b->mode;
+    int placed[MAX_SHIP_KINDS] = {0};
+    for (int i = 0; i < self->ship_count; i++) placed[self->ships[i].type]++;
+
+    int k = 0;
+    while (k < mode->kind_count && placed[k] >= mode->kinds[k].count) k++;
+    if (k == mode->kind_count) return false;
+    *type = k;
+
+    for (int t = 0; t < PLACE_TRIES; t++) {
+        *o = (next_rand(b) & 1) ? VERTICAL : HORIZONTAL;
+        c->x = (int)(next_rand(b) % (uint64_t)b->width);
+        c->y = (int)(next_rand(b) % (uint64_t)b->height);
+        if (can_place(self, k, *c, *o)) return true;
+    }
+    // tabuleiro apertado: primeira posição livre em varredura
+    for (int x = 0; x < b->width; x++) {
+        for (int y = 0; y < b->height; y++) {
+            for (int v = 0; v < 2; v++) {
+                *c = (Coord){ x, y };
+                *o = v ? VERTICAL : HORIZONTAL;
+                if (can_place(self, k, *c, *o)) return true;
+            }
+        }
+    }
+    return false;
+}
+
+/* ---------------------------------------------------------------------------
+ * Tabuleiros pequenos: densidade com bitboards
+ * ------------------------------------------------------------------------- */
+
+// Soma bb (peso 2^plane) ao contador bit-sliced: uma soma com propagação de vai-um
+static inline void slice_add(Bitboard *planes, Bitboard bb, int plane) {
+    for (int p = plane; bb && p < DENSITY_PLANES; p++) {
+        Bitboard carry = planes[p] & bb;
+        planes[p] ^= bb;
+        bb = carry;
+    }
+}
+
+// Cada origem em starts conta uma vez para cada célula que o navio cobriria
+static inline void add_coverage(Bitboard *planes, Bitboard starts, int size, int step, int plane) {
+    for (int i = 0; i < size; i++) slice_add(planes, starts << (i * step), plane);
+}
+
+static Coord small_choose(Bot *b) {
+    Bitboard planes[DENSITY_PLANES] = {0};
+    Bitboard blocked = b->miss | b->sunk;
+
+    for (int k = 0; k < b->mode->kind_count; k++) {
+        int n = b->remaining[k];
+        if (n == 0) continue;
+        int size = b->mode->kinds[k].size;
+        for (int v = 0; v < 2; v++) {
+            int step = v ? b->height : 1;
+            Bitboard starts = v ? b->start_v[k] : b->start_h[k];
+            Bitboard covers_hit = 0;
+            for (int i = 0; i < size; i++) {
+                starts     &= ~(blocked >> (i * step));
+                covers_hit |= b->hit >> (i * step);
+            }
+            Bitboard on_hit = starts & covers_hit;
+            // n navios iguais: soma nas potências de 2 de n
+            for (int bit = 0; n >> bit; bit++) {
+                if (!((n >> bit) & 1)) continue;
+                add_coverage(planes, starts, size, step, bit);
+                if (on_hit) add_coverage(planes, on_hit, size, step, TARGET_PLANE + bit);
+            }
+        }
+    }
+
+    // maior contador: filtra do bit mais significativo para o menos
+    Bitboard cand = b->full & ~(b->miss | b->hit | b->sunk);
+    for (int p = DENSITY_PLANES - 1; p >= 0; p--) {
+        Bitboard t = cand & planes[p];
+        if (t) cand = t;
+    }
+    if (!cand) cand = b->full & ~(b->miss | b->hit | b->sunk);
+    if (!cand) return (Coord){ 0, 0 };
+
+    // empate: uma das melhores ao acaso
+    int skip = (int)(next_rand(b) % (uint64_t)__builtin_popcountll(cand));
+    while (skip--) cand &= cand - 1;
+    int cell = __builtin_ctzll(cand);
+    return (Coord){ cell / b->height, cell % b->height };
+}
+
+/* ---------------------------------------------------------------------------
+ * Tabuleiros grandes: densidade por corridas livres na caça e local em volta dos acertos
+ * ------------------------------------------------------------------------- */
+
+static inline bool large_blocked(const Bot *b, int x, int y) {
+    uint32_t cell = cell_index(b, x, y);
+    return map_test(b->shot_map, cell) && !map_test(b->live_map, cell);
+}
+
+// Posições dos navios restantes que cobrem c, não cruzam água/afundados e tocam um acerto
+static int local_density(const Bot *b, int cx, int cy) {
+    int score = 0;
+    for (int k = 0; k < b->mode->kind_count; k++) {
+        if (b->remaining[k] == 0) continue;
+        int size = b->mode->kinds[k].size;
+        for (int v = 0; v < 2; v++) {
+            int dx = v ? 1 : 0, dy = v ? 0 : 1;
+            for (int i = 0; i < size; i++) {
+                int sx = cx - i * dx, sy = cy - i * dy;
+                int ex = sx + (size - 1) * dx, ey = sy + (size - 1) * dy;
+                if (sx < 0 || sy < 0 || ex >= b->width || ey >= b->height) continue;
+                bool ok = true, touches = false;
+                for (int j = 0; j < size && ok; j++) {
+                    int x = sx + j * dx, y = sy + j * dy;
+                    ok = !large_blocked(b, x, y);
+                    touches |= map_test(b->live_map, cell_index(b, x, y));
+                }
+                if (ok && touches) score += b->remaining[k];
+            }
+        }
+    }
+    return score;
+}
+
+static bool large_target(Bot *b, Coord *out) {
+    static const int dx[] = { -1, 1, 0, 0 }, dy[] = { 0, 0, -1, 1 };
+    int best = 0;
+    for (int h = 0; h < b->hit_count; h++) {
+        for (int d = 0; d < 4; d++) {
+            // anda sobre acertos vivos até a primeira célula que não é acerto
+            int x = b->hits[h].x + dx[d], y = b->hits[h].y + dy[d];
+            while (x >= 0 && y >= 0 && x < b->width && y < b->height &&
+                   map_test(b->live_map, cell_index(b, x, y))) {
+                x += dx[d];
+                y += dy[d];
+            }
+            if (x < 0 || y < 0 || x >= b->width || y >= b->height) continue;
+            if (map_test(b->shot_map, cell_index(b, x, y))) continue;
+            int score = local_density(b, x, y);
+            if (score > best || (score == best && score > 0 && (next_rand(b) & 1))) {
+                best = score;
+                *out = (Coord){ x, y };
+            }
+        }
+    }
+    return best > 0;
+}
+
+// Células ainda não atiradas a partir de (x, y) na direção (dx, dy), sem contar (x, y)
+// e no máximo limit
+static int free_run(const Bot *b, int x, int y, int dx, int dy, int limit) {
+    int n = 0;
+    for (x += dx, y += dy; n < limit; x += dx, y += dy, n++) {
+        if (x < 0 || y < 0 || x >= b->width || y >= b->height) break;
+        if (map_test(b->shot_map, cell_index(b, x, y))) break;
+    }
+    return n;
+}
+
+// Posições dos navios restantes que cobrem (x, y) sem passar por células já atiradas.
+// Com a células livres antes e d depois na linha (ou coluna), um navio de tamanho s
+// cabe em min(a, s - 1) + min(d, s - 1) - s + 2 posições que cobrem a célula
+static int hunt_density(const Bot *b, int x, int y) {
+    int reach = b->max_size - 1;
+    int h_before = free_run(b, x, y, 0, -1, reach), h_after = free_run(b, x, y, 0, 1, reach);
+    int v_before = free_run(b, x, y, -1, 0, reach), v_after = free_run(b, x, y, 1, 0, reach);
+    int score = 0;
+    for (int k = 0; k < b->mode->kind_count; k++) {
+        if (b->remaining[k] == 0) continue;
+        int s = b->mode->kinds[k].size;
+        int h = (h_before < s - 1 ? h_before : s - 1) + (h_after < s - 1 ? h_after : s - 1) - s + 2;
+        int v = (v_before < s - 1 ? v_before : s - 1) + (v_after < s - 1 ? v_after : s - 1) - s + 2;
+        if (h > 0) score += b->remaining[k] * h;
+        if (v > 0) score += b->remaining[k] * v;
+    }
+    return score;
+}
+
+// Sorteia até HUNT_SAMPLES células livres pela permutação e atira na de maior densidade.
+// As que ficaram de fora voltam no próximo ciclo da permutação
+static Coord large_hunt(Bot *b) {
+    Coord best = { 0, 0 };
+    int best_score = -1, samples = 0;
+    for (uint64_t draws = 0; draws <= b->perm_mask && samples < HUNT_SAMPLES; draws++) {
+        uint32_t v = b->perm_next;
+        b->perm_next = (b->perm_a * b->perm_next + b->perm_c) & b->perm_mask;
+        if (v >= b->cells || map_test(b->shot_map, v)) continue;
+        samples++;
+        int x = (int)(v / (uint32_t)b->height), y = (int)(v % (uint32_t)b->height);
+        int score = hunt_density(b, x, y);
+        if (score > best_score) {
+            best_score = score;
+            best = (Coord){ x, y };
+        }
+    }
+    return best;
+}
+
+Coord ai_choose_shot(Bot *b) {
+    if (b->small) return small_choose(b);
+    Coord c;
+    if (b->hit_count > 0 && large_target(b, &c)) return c;
+    return large_hunt(b);
+}
+
+void ai_observe(Bot *b, Coord c, int result, const Ship *sunk) {
+    if (b->small) {
+        Bitboard bit = (Bitboard)1 << cell_index(b, c.x, c.y);
+        if (result == RESULT_MISS) b->miss |= bit;
+        else                       b->hit  |= bit;
+    } else {
+        uint32_t cell = cell_index(b, c.x, c.y);
+        map_set(b->shot_map, cell);
+        if (result != RESULT_MISS) {
+            map_set(b->live_map, cell);
+            b->hits[b->hit_count++] = c;
+        }
+    }
+    if (result != RESULT_SUNK || !sunk) return;
+
+    for (int i = 0; i < sunk->size; i++) {
+        int x = sunk->origin.x + (sunk->orientation == VERTICAL   ? i : 0);
+        int y = sunk->origin.y + (sunk->orientation == HORIZONTAL ? i : 0);
+        if (b->small) {
+            Bitboard bit = (Bitboard)1 << cell_index(b, x, y);
+            b->hit  &= ~bit;
+            b->sunk |= bit;
+        } else {
+            map_clear(b->live_map, cell_index(b, x, y));
+        }
+    }
+    if (!b->small) {
+        int n = 0;
+        for (int i = 0; i < b->hit_count; i++) {
+            if (map_test(b->live_map, cell_index(b, b->hits[i].x, b->hits[i].y))) {
+                b->hits[n++] = b->hits[i];
+            }
+        }
+        b->hit_count = n;
+    }
+    if (b->remaining[sunk->type] > 0) b->remaining[sunk->type]--;
+    update_max_size(b);
+}
+
+void ai_recall(Bot *b, const Player *opp) {
+    for (int i = 0; i < opp->ship_count; i++) {
+        const Ship *ship = &opp->ships[i];
+        bool sunk = ship->hits == (ship->size == 64 ? ~0ull : (1ull << ship->size) - 1);
+        for (int k = 0; k < ship->size; k++) {
+            if (!(ship->hits & (1ull << k))) continue;
+            Coord c = { ship->origin.x + (ship->orientation == VERTICAL   ? k : 0),
+                        ship->origin.y + (ship->orientation == HORIZONTAL ? k : 0) };
+            bool last = sunk && k == ship->size - 1;
+            ai_observe(b, c, last ? RESULT_SUNK : RESULT_HIT, last ? ship : NULL);
+        }
+    }
+}
+
+bool ai_next_command(Bot *b, Game *g, Player *self, char *cmd, size_t size) {
+    Player *opp = (self == &g->players[0]) ? &g->players[1] : &g->players[0];
+
+    // o resultado do último tiro já está no tabuleiro do adversário
+    if (b->pending) {
+        b->pending = false;
+        int idx = ship_at(opp, b->last);
+        const Ship *ship = idx == -1 ? NULL : &opp->ships[idx];
+        if (!ship) {
+            ai_observe(b, b->last, RESULT_MISS, NULL);
+        } else if (ship->hits == (ship->size == 64 ? ~0ull : (1ull << ship->size) - 1)) {
+            ai_observe(b, b->last, RESULT_SUNK, ship);
+        } else {
+            ai_observe(b, b->last, RESULT_HIT, NULL);
+        }
+    }
+    if (g->game_over || !self->joined) return false;
+
+    if (!g->game_started) {
+        if (self->ready) return false;
+        ShipType type;
+        Coord c;
+        Orientation o;
+        if (ai_next_placement(b, self, &type, &c, &o)) {
+            snprintf(cmd, size, "%s %s %d %d %c", CMD_POS, b->mode->kinds[type].name,
+                     c.x + 1, c.y + 1, o == VERTICAL ? 'V' : 'H');
+            return true;
+        }
+        if (self->ship_count != b->mode->total_ships) return false;
+        snprintf(cmd, size, "%s", CMD_READY);
+        return true;
+    }
+
+    if (!self->active_turn) return false;
+    b->last    = ai_choose_shot(b);
+    b->pending = true;
+    snprintf(cmd, size, "%s %d %d", CMD_FIRE, b->last.x + 1, b->last.y + 1);
+    return true;
+}
@@ -0,0 +1,40 @@
+#ifndef AI_H
+#define AI_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "battleship.h"
+
+// Oponente automático: posiciona a frota com can_place e escolhe os tiros por
+// densidade de probabilidade (caça/alvo) sobre todas as posições ainda possíveis
+// dos navios que restam.
+//
+// Tabuleiros de até 64 células usam bitboards: as posições de cada tipo são
+// calculadas em paralelo com deslocamentos e a contagem por célula fica em
+// contadores bit-sliced (um Bitboard por bit do contador), sem laço por célula.
+// Tabuleiros maiores avaliam na caça uma amostra de células: a densidade de cada uma
+// sai do comprimento das corridas livres na linha e na coluna dela. Perto dos acertos
+// a densidade é calculada posição por posição.
+
+typedef struct Bot Bot;
+
+// Cria o estado do bot para uma partida do modo; NULL se faltar memória
+Bot *ai_create(const GameMode *mode, uint64_t seed);
+void ai_destroy(Bot *bot);
+
+// Escolhe uma posição legal para o próximo navio do jogador; false se a frota está completa
+bool ai_next_placement(Bot *bot, Player *self, ShipType *type, Coord *c, Orientation *o);
+// Próxima célula a atacar (0-based); nunca repete um tiro
+Coord ai_choose_shot(Bot *bot);
+// Informa o resultado de um tiro (RESULT_*); em RESULT_SUNK, sunk é o navio afundado
+void ai_observe(Bot *bot, Coord c, int result, const Ship *sunk);
+
+// Reconstrói o que o bot sabe dos tiros a partir dos acertos já marcados no adversário
+// (partida retomada); os tiros na água não ficam registrados e podem se repetir
+void ai_recall(Bot *bot, const Player *opp);
+
+// Próximo comando de texto do bot nesta partida (POS, READY ou FIRE), já levando em conta
+// o resultado do tiro anterior; false se agora não é a vez dele agir
+bool ai_next_command(Bot *bot, Game *game, Player *self, char *cmd, size_t size);
+
+#endif // AI_H
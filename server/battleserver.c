@@ -1,570 +1,2157 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <getopt.h>
+#include <poll.h>
+#include <sched.h>
+#include <time.h>
+#include <stdatomic.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/random.h>
 #include <pthread.h>
 
 #include "battleship.h"
+#include "gamelog.h"
+#include "ai.h"
+#include "metrics.h"
+#include "outbuf.h"
+#include "spectator.h"
+#include "snapshot.h"
+#include "ratelimit.h"
+#include "timerwheel.h"
+#include "slab.h"
 #include "../common/protocol.h"
+#include "../common/mpsc.h"
 
-#define SERVER_PORT 8080
-#define SERVER_IP "127.0.0.1"
+#define SERVER_PORT     8080
+#define SERVER_IP       "127.0.0.1"
+#define DEFAULT_SHARDS  4
+#define MAX_SHARDS      64
+#define DEFAULT_ACCEPTORS 2
+#define MAX_ACCEPTORS   16
+#define DEFAULT_BACKLOG 4096  // o kernel limita a net.core.somaxconn
+#define MAX_EVENTS      256
+#define EPOLL_TIMEOUT   500   // ms; permite checar stop_server periodicamente
+#define STATS_BUF       8192  // resposta do STATS no socket de administração
+#define RESUME_WAIT_US  (120u * 1000000u)  // partida sem ninguém conectado é descartada
+#define DEFAULT_CMD_RATE  50   // comandos por segundo por conexão
+#define DEFAULT_CMD_BURST 512  // a frota inteira e o READY passam de uma vez
+#define ERROR_RATE      2      // respostas de erro por segundo por conexão...
+#define ERROR_BURST     32     // ...e quantas seguidas; passou disso a conexão cai
+#define DEFAULT_TURN_SECS   60   // prazo de cada jogada
+#define DEFAULT_PLACE_SECS  180  // prazo para posicionar a frota e dar READY
+#define DEFAULT_IDLE_SECS   60   // conexão nova sem JOIN, WATCH ou RESUME
+#define DEFAULT_QUEUE_SECS  600  // espera na fila do lobby sem adversário
 
-Game game;           // estado global do jogo
-int listenfd = -1;   // socket do servidor
-static FILE *log_file = NULL; // para gravar o log completo do jogo
+typedef struct Shard Shard;
+typedef struct Match Match;
+typedef struct Conn  Conn;
 
-ShipType parse_ship_type(const char *s) {
-    if (strcmp(s, "SUBMARINO")  == 0) return SUBMARINE;
-    if (strcmp(s, "FRAGATA")    == 0) return FRAGATA;
-    if (strcmp(s, "DESTROYER")  == 0) return DESTROYER;
-    return 0;
+#define container_of(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+
+// Mensagem na fila de entrada de um shard ou do lobby, embutida na sala ou na conexão que
+// ela leva
+enum {
+    MSG_MATCH,   // sala nova ou retomada (lobby -> shard)
+    MSG_ATTACH,  // conexão do WATCH ou RESUME (lobby -> shard)
+    MSG_CONN,    // conexão aceita (aceitador -> lobby)
+    MSG_ENDED,   // sala encerrada, para o lobby tirar do índice e liberar (shard -> lobby)
+};
+typedef struct {
+    MpscNode node;
+    int      kind;          // MSG_*
+} ShardMsg;
+
+// Temporizadores nas rodas do lobby e dos shards (Timer.kind)
+enum {
+    TIMER_PAUSE,     // conexão pausada pelo limite de comandos volta a ler (shard)
+    TIMER_DEADLINE,  // prazo do posicionamento ou da jogada (shard)
+    TIMER_ORPHAN,    // partida sem ninguém conectado é descartada (shard)
+    TIMER_IDLE,      // conexão nova sem JOIN, WATCH ou RESUME (lobby)
+    TIMER_QUEUE,     // fila do lobby sem adversário (lobby)
+};
+
+// Protocolo da conexão, decidido pelo primeiro byte recebido
+enum { PROTO_UNKNOWN, PROTO_TEXT, PROTO_BINARY };
+
+// Conexão de um jogador (ou espectador): pertence ao lobby até o pareamento, ou até o
+// WATCH, e depois ao shard da partida
+struct Conn {
+    int       fd;
+    int       seat;         // índice em game.players (-1 enquanto está no lobby)
+    Match    *match;
+    bool      joined;       // já fez JOIN e está na fila do lobby
+    int       mode;         // índice em modes[] pedido no JOIN
+    int       proto;        // PROTO_*
+    uint8_t   in[MAX_MSG];  // bytes recebidos ainda não consumidos (linhas ou quadros parciais)
+    int       inlen;
+    int       inoff;        // linhas já entregues no começo de in (texto), descartadas em lote
+    bool      skip_line;    // descartando o resto de uma linha maior que o buffer
+    bool      admin;        // conexão do socket de administração (só STATS)
+    OutBuf    out;          // respostas ainda não enviadas (socket não bloqueante)
+    bool      want_out;     // registrada com EPOLLOUT esperando espaço no socket
+    Spectator *spec;        // fila de eventos do espectador; NULL para jogadores
+    uint32_t  attach_id;    // partida pedida no WATCH/RESUME, até o shard recebê-la
+    uint64_t  resume_token; // segredo da sessão pedida no RESUME (0 no WATCH)
+    ShardMsg  msg;          // WATCH/RESUME a caminho do shard
+    char      name[MAX_NAME_LEN];
+    uint64_t  joined_at;    // instante do JOIN (us), para o tempo até a partida
+    uint32_t  addr;         // endereço IPv4 de origem (ordem da rede), para o limite por IP
+    TokenBucket cmds;       // comandos aplicados (-R)
+    TokenBucket errs;       // respostas de erro
+    unsigned  errors;       // erros respondidos pelo lobby ainda não cobrados de errs
+    bool      paused;       // sem EPOLLIN: passou do limite (timer armado) ou acumulou saída
+    Timer     timer;        // fim da pausa no shard; prazo do JOIN ou da fila no lobby
+    Conn     *prev, *next;  // fila de espera do lobby
+    Conn     *next_dead;    // lista de conexões a liberar no fim do lote de eventos
+};
+
+// Sala de jogo: o estado da partida mais as conexões dos jogadores. Vem do pool do modo
+// (match_pools), e sem -S o bloco de navios e índices do Game fica no mesmo objeto,
+// logo depois dela (MATCH_HEAD).
+struct Match {
+    Game      game;
+    Conn     *conns[MAX_CLIENTS];  // NULL no assento do bot
+    Shard    *shard;        // único shard que toca nesta partida
+    Bot      *bot;          // oponente automático, criado pelo shard (NULL sem bot)
+    int       bot_seat;     // assento do bot; -1 em partida só de humanos
+    int       connected;    // conexões abertas
+    uint64_t  queued_at;    // JOIN do jogador mais antigo da sala (us)
+    ShardMsg  msg;          // a caminho do shard; no fim, de volta ao lobby
+    Match    *next;         // lista de liberação
+    Match    *live_prev, *live_next;  // salas em andamento do shard (busca do WATCH)
+    uint64_t  tokens[MAX_CLIENTS];    // segredos das sessões do RESUME (0: assento sem sessão)
+    SnapSlot *snap;         // fatia do snapshot com o estado da partida (NULL sem -S)
+    Slab     *pool;         // de onde veio e para onde volta
+    Timer     orphan;       // sem ninguém conectado: prazo para alguém voltar com RESUME
+    Timer     deadline;     // prazo do posicionamento ou da jogada da vez
+    unsigned  deadline_turn; // game.turns quando o prazo foi armado
+    bool      restored;     // veio do snapshot da execução anterior
+};
+
+#define MATCH_HEAD slab_align(sizeof(Match))  // início do bloco do Game no objeto do pool
+
+// Shard: thread fixada em um núcleo que é dona exclusiva das suas salas
+struct Shard {
+    int             id;
+    int             cpu;
+    int             epfd;
+    int             wakefd;       // eventfd sinalizado quando chega sala nova
+    pthread_t       tid;
+
+    MpscQueue       inbox;        // salas, WATCH e RESUME vindos do lobby (sem lock)
+
+    Match          *live;         // salas em andamento
+    TimerWheel      timers;       // prazos das salas e pausas das conexões
+
+    Match          *dead_matches; // partidas encerradas neste lote de eventos
+    Conn           *dead_conns;
+
+    // estatísticas lidas pelo lobby
+    atomic_int      inbox_depth;
+    atomic_int      inbox_max;
+    atomic_int      active;       // salas em andamento
+    atomic_int      spectators;
+    atomic_ulong    rooms;        // salas já recebidas
+    atomic_ulong    ttm_total_us; // soma dos tempos JOIN -> sala no shard
+    atomic_ulong    ttm_max_us;
+};
+
+static Shard  shards[MAX_SHARDS];
+static int    shard_count = DEFAULT_SHARDS;
+static int    adminfd  = -1;         // socket Unix de administração (-A)
+static ino_t  admin_ino;             // inode do socket criado, para não apagar o de outro processo
+static Conn   admin_listener;        // marca o adminfd no epoll do lobby
+static volatile sig_atomic_t stop_server = 0;
+
+// Modos de jogo disponíveis; o JOIN escolhe um pelo nome (padrão: default_mode)
+static GameMode modes[MAX_MODES];
+static int      mode_count   = 0;
+static int      default_mode = 0;
+// Partidas de cada modo: Match mais o bloco do Game (só o Match com -S, em que o bloco
+// fica na fatia do snapshot)
+static Slab     match_pools[MAX_MODES];
+
+// Fila de espera de um modo: jogadores que já fizeram JOIN e aguardam um adversário
+typedef struct {
+    Conn *head, *tail;
+    int   depth;
+} LobbyQueue;
+
+// Lobby (só a thread do lobby mexe)
+static LobbyQueue lobby[MAX_MODES];
+static int        lobby_depth = 0;   // soma das filas
+static int        lobby_epfd = -1;
+static TimerWheel lobby_timers;      // prazo do JOIN e da fila de cada conexão
+static uint64_t match_seq    = 0;   // partidas já numeradas (o id sai daqui, ver take_match_id)
+static bool   snapshot_full_warned;   // aviso de fatias esgotadas já dado (até uma voltar)
+static int    next_shard    = 0;
+static uint64_t bot_wait_us = 0;     // espera no lobby antes de ganhar um bot (0 desliga)
+// Shard de cada partida em andamento, para o WATCH e o RESUME acharem o dono. Tabela
+// aberta só do lobby: o shard devolve a sala encerrada (MSG_ENDED) e o lobby tira o id
+// antes de liberá-la, então o tamanho acompanha as salas vivas, não as já criadas.
+typedef struct {
+    uint32_t id;             // 0: vazio
+    int      shard;
+} LiveEntry;
+static LiveEntry *live_index;
+static uint32_t   live_cap, live_count;  // live_cap é potência de 2
+static atomic_bool draining;         // sockets de escuta entregues a outro processo (HANDOFF)
+static RateLimit cmd_limit;          // comandos por conexão (-R); desligado com 0
+static RateLimit err_limit;          // respostas de erro por conexão; segue o -R
+static uint64_t  turn_us, place_us;  // prazos da partida (-T); 0 desliga
+static uint64_t  idle_us, queue_us;  // prazos do lobby (-W); 0 desliga
+
+// Aceitador: thread com o próprio socket de escuta na porta (SO_REUSEPORT); o kernel
+// espalha as conexões novas entre eles e cada um as entrega ao lobby pela fila sem lock
+typedef struct {
+    int       fd;
+    pthread_t tid;
+} Acceptor;
+
+static Acceptor   acceptors[MAX_ACCEPTORS];
+static int        acceptor_count = DEFAULT_ACCEPTORS;
+static bool       acceptors_running = false;
+static atomic_bool accepting;
+static int        accept_stopfd = -1;  // eventfd que tira os aceitadores do poll
+static MpscQueue  lobby_inbox;         // conexões aceitas e salas encerradas, a caminho do lobby
+static int        lobby_wakefd = -1;
+static Conn       lobby_waker;         // marca o lobby_wakefd no epoll do lobby
+
+static void handle_stop(int sig) {
+    (void)sig;
+    stop_server = 1;
 }
 
-void init_game(Game *g) {
-    pthread_mutex_init(&g->mutex, NULL);
-    pthread_cond_init (&g->cond_ready, NULL);
-    g->count        = 0;
-    g->game_over    = false;
-    g->game_started = false;
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        Player *p = &g->players[i];
-        p->sockfd       = -1;
-        memset(p->name, 0, MAX_NAME_LEN);
-        p->joined       = false;
-        p->ready        = false;
-        p->active_turn  = false;
-        pthread_mutex_init(&p->board.lock, NULL);
-        memset(p->board.grid, 0, sizeof(p->board.grid));
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
 
-        // inicializa lista de ships
-        p->ship_count = 0;
-        for (int s = 0; s < TOTAL_SHIPS; s++) {
-            p->ships[s].placed = false;
-            p->ships[s].hits   = 0;
-        }
-    }
+// Interesse da conexão no epfd dono: EPOLLIN salvo quando pausada, EPOLLOUT enquanto há
+// saída presa no buffer ou a pausa espera a saída esvaziar
+static void conn_watch(Conn *c, int epfd) {
+    bool out = c->want_out || (c->paused && !timer_armed(&c->timer));
+    struct epoll_event ev = { .events = (c->paused ? 0 : EPOLLIN) | (out ? EPOLLOUT : 0),
+                              .data.ptr = c };
+    epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
 }
 
-void send_to_player(Player *p, const char *msg) {
-    if (p->sockfd != -1) {
-        send(p->sockfd, msg, strlen(msg), 0);
-    }
+static void conn_want_out(Conn *c, int epfd, bool want) {
+    if (want == c->want_out) return;
+    c->want_out = want;
+    conn_watch(c, epfd);
 }
 
-void broadcast(const Game *g, const char *msg) {
-    for (int i = 0; i < g->count; i++) {
-        if (g->players[i].sockfd != -1) {
-            send(g->players[i].sockfd, msg, strlen(msg), 0);
+// Envia o buffer de saída com um writev e ajusta o interesse em EPOLLOUT no epfd dono
+// da conexão. Retorna false se a conexão deve ser fechada (erro ou leitor lento demais).
+static bool conn_flush(Conn *c, int epfd) {
+    if (c->out.overflow) return false;
+    int r = outbuf_flush(&c->out, c->fd);
+    if (r < 0) return false;
+    conn_want_out(c, epfd, r == 0);
+    return true;
+}
+
+// No lobby cada resposta sai logo: são poucas e a conexão pode mudar de dono em seguida
+static void lobby_send(Conn *c, const void *buf, size_t len) {
+    outbuf_append(&c->out, buf, len);
+    conn_flush(c, lobby_epfd);
+}
+
+// Responde no protocolo da conexão (texto ou quadro binário)
+static void conn_reply(Conn *c, const char *msg, const uint8_t *frame, size_t len) {
+    if (c->proto == PROTO_BINARY) lobby_send(c, frame, len);
+    else                          lobby_send(c, msg, strlen(msg));
+}
+
+// Descarta as linhas já entregues por conn_next_line
+static void conn_compact(Conn *c) {
+    if (c->inoff == 0) return;
+    c->inlen -= c->inoff;
+    memmove(c->in, c->in + c->inoff, c->inlen);
+    c->inoff = 0;
+}
+
+// Recebe bytes no buffer de entrada e, na primeira leitura, negocia o protocolo.
+// Retorna -1 se o cliente desconectou ou violou o protocolo.
+static int conn_fill(Conn *c) {
+    conn_compact(c);
+    int room = (int)sizeof(c->in) - c->inlen;
+    if (room == 0) return -1;  // quadro maior que o buffer: não acontece com quadros válidos
+    int bytes = recv(c->fd, c->in + c->inlen, room, MSG_DONTWAIT);
+    if (bytes < 0 && (errno == EAGAIN || errno == EINTR)) return 0;
+    if (bytes <= 0) return -1;
+    c->inlen += bytes;
+
+    if (c->proto == PROTO_UNKNOWN) {
+        if (c->in[0] != BIN_MAGIC) {
+            c->proto = PROTO_TEXT;
+        } else if (c->inlen >= 2) {
+            if (c->in[1] != BIN_VERSION) return -1;
+            uint8_t hello[] = { BIN_MAGIC, BIN_VERSION };
+            outbuf_append(&c->out, hello, sizeof(hello));
+            c->proto  = PROTO_BINARY;
+            c->inlen -= 2;
+            memmove(c->in, c->in + 2, c->inlen);
         }
     }
-     if (log_file) {
-        fprintf(log_file, "%s", msg);
-        fflush(log_file);
-    }
+    return bytes;
 }
 
-Player* find_player_by_socket(Game *g, int sockfd) {
-    for (int i = 0; i < g->count; i++) {
-        if (g->players[i].sockfd == sockfd) {
-            return &g->players[i];
+// Próxima linha completa, sem o \r\n e terminada em '\0' no próprio buffer de entrada
+// (sem cópia; vale até a próxima chamada). NULL se ainda não há linha completa: aí as
+// linhas entregues são descartadas de uma vez e uma linha partida espera o resto.
+static char *conn_next_line(Conn *c, int *len) {
+    if (c->proto != PROTO_TEXT) return NULL;
+    for (;;) {
+        uint8_t *line = c->in + c->inoff;
+        uint8_t *nl = memchr(line, '\n', c->inlen - c->inoff);
+        if (!nl) {
+            conn_compact(c);
+            if (c->inlen == (int)sizeof(c->in)) {
+                // linha maior que o buffer: descarta até o próximo \n
+                c->skip_line = true;
+                c->inlen     = 0;
+            }
+            return NULL;
         }
+
+        int n = (int)(nl - line);
+        bool skip = c->skip_line;
+        c->skip_line = false;
+        c->inoff += n + 1;
+        if (skip) continue;
+        if (n > 0 && line[n - 1] == '\r') n--;
+        line[n] = '\0';
+        *len = n;
+        return (char *)line;
     }
-    return NULL;
 }
 
-bool add_player(Game *g, int sockfd) {
-    pthread_mutex_lock(&g->mutex);
-    if (g->count >= MAX_CLIENTS) {
-        pthread_mutex_unlock(&g->mutex);
+// Extrai o próximo quadro binário completo; 0 se ainda incompleto, -1 se o opcode é inválido
+static int conn_next_frame(Conn *c, uint8_t *frame) {
+    if (c->proto != PROTO_BINARY || c->inlen == 0) return 0;
+    int size = bin_payload_size(c->in[0]);
+    if (size < 0 || c->in[0] >= OP_WAITING) return -1;
+    if (c->inlen < 1 + size) return 0;
+    memcpy(frame, c->in, 1 + size);
+    c->inlen -= 1 + size;
+    memmove(c->in, c->in + 1 + size, c->inlen);
+    return 1 + size;
+}
+
+/* ---------------------------------------------------------------------------
+ * Shards
+ * ------------------------------------------------------------------------- */
+
+// Suspende a leitura da conexão até until (limite de comandos) ou, com until 0, até a
+// saída acumulada ser enviada; os comandos já recebidos esperam no buffer
+static void conn_pause(Shard *s, Conn *c, uint64_t until) {
+    c->paused = true;
+    if (until) timer_arm(&s->timers, &c->timer, TIMER_PAUSE, until);
+    conn_watch(c, s->epfd);
+}
+
+static void conn_unpause(Shard *s, Conn *c) {
+    timer_cancel(&s->timers, &c->timer);
+    c->paused = false;
+    if (c->fd != -1) conn_watch(c, s->epfd);
+}
+
+// Se a conexão tem um comando a aplicar agora. Quem passou do limite de comandos ou
+// deixou acumular a saída é pausado, sem ler o socket: o TCP segura o resto do envio.
+static bool conn_may_read(Shard *s, Conn *c, uint64_t now) {
+    if (c->fd == -1 || c->paused || c->match->game.game_over || c->inlen == c->inoff) {
+        return false;
+    }
+    if (outbuf_pending(&c->out) > OUTBUF_PAUSE) {
+        metrics_limit(ML_OUTPUT);
+        conn_pause(s, c, 0);
+        return false;
+    }
+    uint64_t wait = rate_limit_on(&cmd_limit) ? bucket_wait_us(&c->cmds, &cmd_limit, now) : 0;
+    if (wait > 0) {
+        metrics_limit(ML_THROTTLED);
+        conn_pause(s, c, now + wait);
         return false;
     }
-    g->players[g->count].sockfd = sockfd;
-    g->players[g->count].player_id = g->count + 1; // Player 1 ou 2
-    g->count++;
-    pthread_mutex_unlock(&g->mutex);
     return true;
 }
 
-bool can_place(Player *p, ShipType type, Coord c, Orientation o) {
-    int size = (int)type;
-    for (int i = 0; i < size; i++) {
-        int x = c.x + (o == VERTICAL   ? i : 0);
-        int y = c.y + (o == HORIZONTAL ? i : 0);
-        if (x < 0 || x >= BOARD_SIZE ||
-            y < 0 || y >= BOARD_SIZE) return false;
-        if (p->board.grid[x][y] != 0)  return false;
+// Cobra um comando e as respostas de erro que ele gerou; false se a conexão passou do
+// limite de erros
+static bool conn_charge(Conn *c, unsigned errors, uint64_t now) {
+    if (!rate_limit_on(&cmd_limit)) return true;
+    bucket_charge(&c->cmds, &cmd_limit, now, 1);
+    return errors == 0 || bucket_charge(&c->errs, &err_limit, now, errors);
+}
+
+// Fecha a conexão e, se era a última da partida, agenda a liberação da partida
+static void conn_close(Shard *s, Conn *c) {
+    if (!c || c->fd == -1) return;
+    Match *m = c->match;
+
+    metrics_conn_closed();
+    iplimit_release(c->addr);
+    if (!c->out.overflow) outbuf_flush(&c->out, c->fd);  // última tentativa, sem esperar
+    epoll_ctl(s->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+    if (c->paused) conn_unpause(s, c);
+    m->game.players[c->seat].sockfd = -1;
+    m->game.players[c->seat].out    = NULL;
+    m->conns[c->seat] = NULL;  // o assento fica livre para o RESUME
+    c->next_dead  = s->dead_conns;
+    s->dead_conns = c;
+
+    if (--m->connected > 0) return;
+    if (m->game.game_over) {
+        m->next         = s->dead_matches;
+        s->dead_matches = m;
+        return;
     }
+    // partida com bot ou com os dois humanos fora: espera o RESUME antes de descartar;
+    // o prazo da jogada recomeça quando alguém volta
+    timer_cancel(&s->timers, &m->deadline);
+    timer_arm(&s->timers, &m->orphan, TIMER_ORPHAN, now_us() + RESUME_WAIT_US);
+}
+
+// Fecha a conexão de um espectador e o tira da plateia da partida
+static void spectator_close(Shard *s, Conn *c) {
+    if (c->fd == -1) return;
+    metrics_conn_closed();
+    iplimit_release(c->addr);
+    audience_remove(c->match->game.audience, c->spec);
+    spectator_clear(c->spec);
+    epoll_ctl(s->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+    c->next_dead  = s->dead_conns;
+    s->dead_conns = c;
+    atomic_fetch_sub(&s->spectators, 1);
+}
+
+// Como conn_flush(), para a fila de eventos compartilhados de um espectador
+static bool spectator_send(Shard *s, Conn *c) {
+    if (c->spec->overflow) return false;
+    int r = spectator_flush(c->spec);
+    if (r < 0) return false;
+    conn_want_out(c, s->epfd, r == 0);
     return true;
 }
 
-bool place_ship(Player *p, ShipType type, Coord c, Orientation o) {
-    int size = (int)type;
-    if (!can_place(p, type, c, o)) return false;
+// Espectadores só recebem: o que mandarem é descartado, e EOF ou erro encerra
+static void spectator_event(Shard *s, Conn *c, uint32_t events) {
+    if ((events & EPOLLOUT) && !spectator_send(s, c)) {
+        spectator_close(s, c);
+        return;
+    }
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        char junk[256];
+        ssize_t n = recv(c->fd, junk, sizeof(junk), MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) spectator_close(s, c);
+    }
+}
+
+// Resumo do snapshot em dia com o comando recém-aplicado, cujos acertos já estão no
+// mapeamento (ver snapshot.h)
+static void match_applied(Match *m) {
+    if (m->snap) snapshot_sync(m->snap, &m->game, m->tokens);
+}
 
-    // bloqueia o tabuleiro
-    pthread_mutex_lock(&p->board.lock);
-    // marca no grid
-    for (int i = 0; i < size; i++) {
-        int x = c.x + (o == VERTICAL   ? i : 0);
-        int y = c.y + (o == HORIZONTAL ? i : 0);
-        p->board.grid[x][y] = type;
+// Comando de um jogador no log, antes de ser aplicado. FIRE e POS bem formados levam os
+// campos que parse_command já separou; o log binário os grava sem reler o texto.
+static void log_command(const Match *m, const Player *p, const char *line, size_t len,
+                        const Command *cmd)
+{
+    LogEvent ev = { .type = LOG_CMD, .player = p->player_id, .text = line, .len = len };
+    if (cmd->valid && cmd->kind == CK_FIRE) {
+        ev.type = LOG_FIRE;
+        ev.x    = cmd->fire.x;
+        ev.y    = cmd->fire.y;
+    } else if (cmd->valid && cmd->kind == CK_POS) {
+        ev.type    = LOG_POS;
+        ev.x       = cmd->pos.x;
+        ev.y       = cmd->pos.y;
+        ev.result  = cmd->pos.ori;
+        ev.arg     = cmd->pos.type.s;
+        ev.arg_len = (size_t)cmd->pos.type.len;
     }
-    pthread_mutex_unlock(&p->board.lock);
+    gamelog_event(m->game.id, &ev);
+}
 
-    // registra no array de ships
-    Ship *ship = &p->ships[p->ship_count++];
-    ship->type        = type;
-    ship->size        = size;
-    ship->hits        = 0;
-    ship->coord_count = size;
-    ship->placed      = true;
-    for (int i = 0; i < size; i++) {
-        ship->coords[i] = (Coord){ c.x + (o == VERTICAL   ? i : 0),
-                                   c.y + (o == HORIZONTAL ? i : 0) };
+// Os comandos seguem o caminho dos de um jogador, inclusive no log.
+// Os comandos passam por parse_command e apply_command e vão para o log como os de um jogador.
+static void bot_play(Match *m) {
+    if (!m->bot) return;
+    Player *p = &m->game.players[m->bot_seat];
+    char cmd[MAX_MSG];
+    // limite de segurança: posicionar a frota inteira e o READY é o máximo por vez
+    for (int n = 0; n <= m->game.mode->total_ships + 1; n++) {
+        if (m->game.game_over || !ai_next_command(m->bot, &m->game, p, cmd, sizeof(cmd))) break;
+        Command c;
+        parse_command(cmd, strlen(cmd), &c);
+        log_command(m, p, cmd, strlen(cmd), &c);
+        apply_command(&m->game, p, &c);
+        match_applied(m);
     }
-    return true;
 }
 
-static Ship *get_ship_at_coord(Player *p, Coord c) {
-    for (int i = 0; i < p->ship_count; i++) {
-        Ship *s = &p->ships[i];
-        if (!s->placed) continue;
-        for (int j = 0; j < s->coord_count; j++) {
-            if (s->coords[j].x == c.x && s->coords[j].y == c.y) {
-                return s;
-            }
+// Rearma o prazo quando a fase ou a vez mudou; o relógio de uma jogada não recomeça a
+// cada comando recusado. Sem ninguém conectado quem decide é o prazo da retomada.
+static void match_schedule(Shard *s, Match *m) {
+    uint64_t limit = m->game.game_started ? turn_us : place_us;
+    if (m->game.game_over || m->connected == 0 || limit == 0) {
+        timer_cancel(&s->timers, &m->deadline);
+        return;
+    }
+    if (timer_armed(&m->deadline) && m->deadline_turn == m->game.turns) return;
+    m->deadline_turn = m->game.turns;
+    timer_arm(&s->timers, &m->deadline, TIMER_DEADLINE, now_us() + limit);
+}
+
+// Envia o que os comandos deste lote geraram para cada jogador, um writev por conexão.
+// O snapshot é atualizado antes: nada que sai daqui fica fora de uma retomada.
+static void match_flush(Shard *s, Match *m) {
+    match_schedule(s, m);
+    if (m->snap) snapshot_sync(m->snap, &m->game, m->tokens);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Conn *c = m->conns[i];
+        if (!c || c->fd == -1 || conn_flush(c, s->epfd)) continue;
+        if (c->out.overflow) {
+            printf("[SERVER] Partida %d: jogador %d não lê as respostas, desconectando\n",
+                   m->game.id, i + 1);
         }
+        conn_close(s, c);
+    }
+
+    // a plateia depois dos jogadores: o envio para ela não atrasa a partida
+    Audience *a = m->game.audience;
+    for (int i = 0; a && i < a->count; i++) {
+        Conn *c = a->list[i]->owner;
+        if (spectator_send(s, c)) continue;
+        if (c->spec->overflow) {
+            printf("[SERVER] Partida %d: espectador (socket %d) não lê os eventos, desconectando\n",
+                   m->game.id, c->fd);
+        }
+        spectator_close(s, c);  // a remoção traz o último da lista para a posição i
+        i--;
     }
-    return NULL;
 }
 
-static int count_ships_of_type(Player *p, ShipType type) {
-    int cnt = 0;
-    for (int i = 0; i < p->ship_count; i++) {
-        if (p->ships[i].type == type) cnt++;
+// Fim de jogo: encerra as conexões dos dois jogadores
+static void match_close_if_over(Shard *s, Match *m) {
+    if (m->game.game_over) {
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            conn_close(s, m->conns[i]);
+        }
     }
-    return cnt;
 }
 
-void handle_fire(Game *g, Player *p, Coord c) {
-    Player *opp = (p == &g->players[0])
-                  ? &g->players[1]
-                  : &g->players[0];
-    int result = 0;  // 0 = ÁGUA, 1 = ACERTO, 2 = AFUNDOU
+// Resposta a quem passa do limite de erros, no lobby ou na partida
+#define FLOOD_MSG "ERRO: Comandos inválidos demais, desconectando!\n"
 
-    // Converte para exibição (1..8)
-    char display_coords[32];
-    snprintf(display_coords, sizeof(display_coords), "%d %d",
-             c.x + 1, c.y + 1);
+// Jogador que só manda comandos recusados: a resposta de erro vai junto com o fechamento
+static void conn_flood(Shard *s, Conn *c) {
+    printf("[SERVER] Partida %d: jogador %d mandou comandos inválidos demais, desconectando\n",
+           c->match->game.id, c->seat + 1);
+    metrics_error(ERR_FLOOD);
+    metrics_limit(ML_FLOOD);
+    uint8_t frame[] = { OP_ERROR, ERR_FLOOD };
+    if (c->proto == PROTO_BINARY) outbuf_append(&c->out, frame, sizeof(frame));
+    else                          outbuf_append(&c->out, FLOOD_MSG, strlen(FLOOD_MSG));
+    conn_close(s, c);
+}
 
-    // Bloqueia o tabuleiro do oponente
-    pthread_mutex_lock(&opp->board.lock);
+// Aplica à partida os comandos já recebidos pela conexão, dentro do limite dela
+static void conn_process_input(Shard *s, Conn *c) {
+    Match *m = c->match;
+    Player *p = &m->game.players[c->seat];
+    uint64_t now = now_us();
 
-    // Verifica limite e conteúdo
-    if (c.x < 0 || c.x >= BOARD_SIZE ||
-        c.y < 0 || c.y >= BOARD_SIZE ||
-        opp->board.grid[c.x][c.y] <= 0)
-    {
-        result = 0;  // ÁGUA
+    if (c->proto == PROTO_TEXT) {
+        char *line;
+        int len;
+        while (conn_may_read(s, c, now) && (line = conn_next_line(c, &len)) != NULL) {
+            if (len == 0) continue;
+            uint64_t start = metrics_clock();
+            unsigned errors = p->errors;
+            Command cmd;
+            parse_command(line, (size_t)len, &cmd);
+            log_command(m, p, line, (size_t)len, &cmd);
+            apply_command(&m->game, p, &cmd);
+            match_applied(m);
+            metrics_command(metrics_command_kind(cmd.kind), start);
+            if (!conn_charge(c, p->errors - errors, now)) conn_flood(s, c);
+        }
     } else {
-        // Marca o acerto
-        int ship_type = opp->board.grid[c.x][c.y];
-        opp->board.grid[c.x][c.y] = -ship_type;
-        result = 1;  // ACERTO por padrão
-
-        // Identifica e atualiza o Ship atingido
-        Ship *hitShip = get_ship_at_coord(opp, c);
-        if (hitShip) {
-            hitShip->hits++;
-            if (hitShip->hits >= hitShip->size) {
-                result = 2;  // AFUNDOU
-            }
+        char buf[MAX_MSG];
+        uint8_t frame[MAX_MSG];
+        int len = 0;
+        while (conn_may_read(s, c, now) && (len = conn_next_frame(c, frame)) > 0) {
+            // o quadro vai para o log como a linha de texto equivalente
+            Command cmd;
+            format_frame(&m->game, frame, buf, sizeof(buf));
+            parse_command(buf, strlen(buf), &cmd);
+            log_command(m, p, buf, strlen(buf), &cmd);
+            uint64_t start = metrics_clock();
+            unsigned errors = p->errors;
+            process_frame(&m->game, p, frame);
+            match_applied(m);
+            metrics_command(metrics_frame_kind(frame[0]), start);
+            if (!conn_charge(c, p->errors - errors, now)) conn_flood(s, c);
         }
+        if (len < 0) conn_close(s, c);
     }
 
-    pthread_mutex_unlock(&opp->board.lock);
-
-    // Texto do resultado
-    const char *result_text = (result == 0) ? CMD_MISS
-                             : (result == 1) ? CMD_HIT
-                                             : CMD_SUNK;
+    bot_play(m);
+    match_flush(s, m);
+    match_close_if_over(s, m);
+}
 
-    // Broadcast do ataque
-    char msg[MAX_MSG];
-    snprintf(msg, sizeof(msg),
-             "=== PLAYER %d (%s) ATACOU %s: %s ===\n",
-             p->player_id, p->name, display_coords, result_text);
-    broadcast(g, msg);
-
-    // Verifica vencedor
-    Player *winner = NULL, *loser = NULL;
-    if (check_winner(g, &winner, &loser)) {
-        snprintf(msg, sizeof(msg),
-                 "=== PARABÉNS %s (PLAYER %d)! VOCÊ VENCEU! ===\n",
-                 winner->name, winner->player_id);
-        send_to_player(winner, msg);
-
-        snprintf(msg, sizeof(msg),
-                 "=== %s (PLAYER %d) PERDEU! ===\n",
-                 loser->name, loser->player_id);
-        send_to_player(loser, msg);
-        if (log_file) {
-            fprintf(log_file,
-                "RESULTADO: %s (Player %d) WINS; %s (Player %d) LOSES\n\n",
-                winner->name, winner->player_id,
-                loser->name, loser->player_id
-            );
-            fflush(log_file);
-        }
-        broadcast(g, "=== JOGO FINALIZADO ===\n");
-        for (int i = 0; i < 2; i++) {
-            send_to_player(&g->players[i], "END\n");
-        }
-        g->game_over = true;
+// Lê o que chegou na conexão e o aplica à partida dona dela
+static void conn_readable(Shard *s, Conn *c) {
+    if (conn_fill(c) < 0) {
+        conn_close(s, c);
         return;
     }
+    conn_process_input(s, c);
+}
+
+static void shard_track(Shard *s, Match *m) {
+    m->live_next = s->live;
+    if (s->live) s->live->live_prev = m;
+    s->live = m;
+}
+
+static void shard_untrack(Shard *s, Match *m) {
+    if (m->live_prev) m->live_prev->live_next = m->live_next;
+    else              s->live = m->live_next;
+    if (m->live_next) m->live_next->live_prev = m->live_prev;
+}
 
-    // Alterna turnos
-    p->active_turn   = false;
-    opp->active_turn = true;
+static Match *shard_find(Shard *s, uint32_t id) {
+    Match *m = s->live;
+    while (m && m->game.id != id) m = m->live_next;
+    return m;
+}
 
-    // Próximo turno
-    snprintf(msg, sizeof(msg),
-             "\n--- TURNO DO PLAYER %d (%s) ---\n",
-             opp->player_id, opp->name);
-    broadcast(g, msg);
-    send_to_player(opp, "*** SUA VEZ! Digite FIRE <x> <y> para atacar ***\n");
-    send_to_player(p,   "*** AGUARDE O TURNO DO ADVERSÁRIO ***\n");
+// Informa ao jogador a sessão com que ele volta ao assento depois de uma queda: o id da
+// partida seguido do segredo do assento
+static void send_session(Match *m, int seat) {
+    Player *p = &m->game.players[seat];
+    char msg[MAX_MSG];
+    snprintf(msg, sizeof(msg), "=== SESSÃO %08x%016llx: RESUME <sessão> volta para esta partida ===\n",
+             (unsigned)m->game.id, (unsigned long long)m->tokens[seat]);
+    uint8_t frame[13] = { OP_SESSION };
+    bin_put32(frame + 1, (unsigned long)m->game.id);
+    bin_put32(frame + 5, (unsigned long)(m->tokens[seat] >> 32));
+    bin_put32(frame + 9, (unsigned long)m->tokens[seat]);
+    send_to_player(p, msg);
+    send_frame(p, frame, sizeof(frame));
 }
 
-bool check_winner(Game *g, Player **winner, Player **loser) {
-    if (!g->game_started) return false;
+// Assume uma sala vinda do lobby: registra as conexões e executa os JOINs na ordem da fila
+static void shard_adopt(Shard *s, Match *m) {
+    uint64_t ttm = now_us() - m->queued_at;
+    atomic_fetch_add(&s->ttm_total_us, ttm);
+    uint64_t max = atomic_load(&s->ttm_max_us);
+    while (ttm > max && !atomic_compare_exchange_weak(&s->ttm_max_us, &max, ttm)) {}
+
+    printf("[SERVER] Partida %u criada (shard %d)%s\n", m->game.id, s->id,
+           m->bot_seat >= 0 ? " contra o bot" : "");
+    shard_track(s, m);
+    metrics_game_started();
+    if (m->bot_seat >= 0) {
+        m->bot = ai_create(m->game.mode, now_us() ^ ((uint64_t)m->game.id << 32));
+        if (!m->bot) perror("ai_create");
+    }
     for (int i = 0; i < MAX_CLIENTS; i++) {
-        bool has_ships = false;
-        pthread_mutex_lock(&g->players[i].board.lock);
-        for (int x = 0; x < BOARD_SIZE && !has_ships; x++) {
-            for (int y = 0; y < BOARD_SIZE; y++) {
-                if (g->players[i].board.grid[x][y] > 0) {
-                    has_ships = true;
-                    break;
-                }
-            }
+        Conn *c = m->conns[i];
+        if (!c) {
+            add_player(&m->game, -1);
+            continue;
         }
-        pthread_mutex_unlock(&g->players[i].board.lock);
-        if (!has_ships) {
-            *loser  = &g->players[i];
-            *winner = &g->players[1 - i];
-            return true;
+        add_player(&m->game, c->fd);
+        m->game.players[i].binary = (c->proto == PROTO_BINARY);
+        m->game.players[i].out    = &c->out;
+        c->want_out = false;  // o registro no epoll do lobby não vale aqui
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, c->fd, &ev) == -1) {
+            perror("epoll_ctl");
         }
     }
-    return false;
+    for (int i = 0; i < MAX_CLIENTS && !m->game.game_over; i++) {
+        Player *p = &m->game.players[i];
+        const char *name = m->conns[i] ? m->conns[i]->name : "BOT";
+        Command cmd = { .kind = CK_JOIN, .valid = true,
+                        .join = { .name = { name, (int)strlen(name) } } };
+        char line[MAX_MSG];
+        int len = snprintf(line, sizeof(line), "%s %s", CMD_JOIN, name);
+        log_command(m, p, line, (size_t)len, &cmd);
+        apply_command(&m->game, p, &cmd);
+    }
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (m->conns[i] && m->tokens[i]) send_session(m, i);
+    }
+
+    // comandos enviados logo após o JOIN (pipelining) ficaram no buffer do lobby
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (m->conns[i] && m->conns[i]->fd != -1 && m->conns[i]->inlen > m->conns[i]->inoff) {
+            conn_process_input(s, m->conns[i]);
+        }
+    }
+    bot_play(m);
+    match_flush(s, m);
+    match_close_if_over(s, m);
 }
 
-void process_command(Game *g, Player *p, const char *cmd) {
-    if (g->game_over) return;
+// Resumo para quem começa a assistir: jogadores, modo e, se a batalha começou, a vez
+static void spectator_intro(Spectator *sp, const Game *g) {
+    const Player *turn = NULL;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (g->game_started && g->players[i].active_turn) turn = &g->players[i];
+    }
+
+    if (sp->binary) {
+        uint8_t buf[6 + 6 + 2 * BIN_MAX_KINDS + 2] = { OP_WELCOME, 0 };
+        bin_put32(buf + 2, (unsigned long)g->id);
+        size_t len = 6 + build_mode_frame(g->mode, buf + 6);
+        if (turn) {
+            buf[len++] = OP_TURN;
+            buf[len++] = (uint8_t)turn->player_id;
+        }
+        spectator_push(sp, buf, len);
+        return;
+    }
+
+    char msg[MAX_MSG];
+    int len = snprintf(msg, sizeof(msg),
+                       "=== ASSISTINDO À PARTIDA %d: %s (PLAYER 1) x %s (PLAYER 2) ===\n",
+                       g->id, g->players[0].name, g->players[1].name);
+    format_mode_banner(g->mode, msg + len, sizeof(msg) - len);
+    len += strlen(msg + len);
+    if (turn && len < (int)sizeof(msg)) {
+        snprintf(msg + len, sizeof(msg) - len, "--- TURNO DO PLAYER %d (%s) ---\n",
+                 turn->player_id, turn->name);
+    }
+    spectator_push(sp, msg, strlen(msg));
+}
 
-    // Copia cmd para uma string mutável e trim
-    char clean_cmd[MAX_MSG];
-    strncpy(clean_cmd, cmd, MAX_MSG-1);
-    clean_cmd[MAX_MSG-1] = '\0';
-    // Remove whitespace no fim
-    char *end = clean_cmd + strlen(clean_cmd) - 1;
-    while (end >= clean_cmd && isspace((unsigned char)*end)) {
-        *end = '\0'; end--;
+// Sala retomada do snapshot: ninguém está conectado; os jogadores voltam com RESUME
+static void shard_restore(Shard *s, Match *m) {
+    printf("[SERVER] Partida %u retomada do snapshot (shard %d)\n", m->game.id, s->id);
+    shard_track(s, m);
+    metrics_game_started();
+    gamelog_resume(m->game.id);
+    if (m->bot_seat >= 0 && (m->bot = ai_create(m->game.mode, now_us() ^ m->game.id)) != NULL) {
+        ai_recall(m->bot, &m->game.players[1 - m->bot_seat]);
     }
+    timer_arm(&s->timers, &m->orphan, TIMER_ORPHAN, now_us() + RESUME_WAIT_US);
+}
 
-    printf("[DEBUG] Player %d - Comando: '%s'\n", p->player_id, clean_cmd);
+// Sala sem ninguém conectado (retomada ou abandonada) em que ninguém voltou a tempo é
+// encerrada
+static void match_orphaned(Shard *s, Match *m) {
+    printf("[SERVER] Partida %u: ninguém voltou a tempo\n", m->game.id);
+    metrics_timeout(MT_RESUME);
+    m->next         = s->dead_matches;
+    s->dead_matches = m;
+}
 
-    // JOIN <nome>
-    if (strncmp(clean_cmd, CMD_JOIN, strlen(CMD_JOIN)) == 0 &&
-        isspace((unsigned char)clean_cmd[strlen(CMD_JOIN)]))
-    {
-        if (p->joined) {
-            send_to_player(p, "ERRO: Você já está fez JOIN!\n");
-            return;
-        }
-        char name[MAX_NAME_LEN];
-        if (sscanf(clean_cmd + strlen(CMD_JOIN) + 1, "%31s", name) != 1) {
-            send_to_player(p, "ERRO: Formato inválido! Use: JOIN <seu_nome>\n");
-            return;
-        }
-        strncpy(p->name, name, MAX_NAME_LEN);
-        p->joined = true;
-        char msg[MAX_MSG];
-        snprintf(msg, sizeof(msg),
-                 "=== BEM-VINDO, %s! VOCÊ É O PLAYER %d ===\n",
-                 p->name, p->player_id);
-        send_to_player(p, msg);
-
-        if (g->count == 1) {
-            send_to_player(p, "*** AGUARDANDO OUTRO JOGADOR... ***\n");
-        } else if (g->count == MAX_CLIENTS) {
-            bool both = g->players[0].joined && g->players[1].joined;
-            if (both) {
-                broadcast(g, "\n=== AMBOS JOGADORES CONECTADOS ===\n");
-                broadcast(g, "=== FASE DE POSICIONAMENTO INICIADA ===\n");
-                broadcast(g, "*** POSICIONE SEUS NAVIOS: POS <tipo> <x> <y> <H/V> ***\n");
-            }
-        }
+// Prazo da fase esgotado: as regras decidem quem perde por W.O. e a partida termina
+static void match_deadline(Shard *s, Match *m) {
+    if (m->game.game_over || m->connected == 0) return;
+    bool started = m->game.game_started;
+    printf("[SERVER] Partida %u: prazo %s esgotado\n", m->game.id,
+           started ? "da jogada" : "do posicionamento");
+    metrics_timeout(started ? MT_TURN : MT_PLACEMENT);
+    game_timeout(&m->game);
+    match_flush(s, m);
+    match_close_if_over(s, m);
+}
+
+// Recusa uma conexão vinda do lobby (WATCH ou RESUME) com o erro e a encerra
+static void shard_reject(Conn *c, int code, const char *msg) {
+    metrics_error(code);
+    uint8_t frame[] = { OP_ERROR, (uint8_t)code };
+    outbuf_append(&c->out, c->proto == PROTO_BINARY ? (const void *)frame : msg,
+                  c->proto == PROTO_BINARY ? sizeof(frame) : strlen(msg));
+    outbuf_flush(&c->out, c->fd);
+    metrics_conn_closed();
+    iplimit_release(c->addr);
+    close(c->fd);
+    outbuf_free(&c->out);
+    free(c);
+}
+
+// RESUME: devolve a conexão ao assento da sessão, se a partida segue e o assento está vago
+static void shard_resume(Shard *s, Conn *c) {
+    Match *m = shard_find(s, c->attach_id);
+    int seat = -1;
+    for (int i = 0; m && !m->game.game_over && i < MAX_CLIENTS; i++) {
+        if (i != m->bot_seat && !m->conns[i] && m->tokens[i] == c->resume_token) seat = i;
+    }
+    if (seat == -1) {
+        shard_reject(c, ERR_BAD_SESSION, "ERRO: Sessão inválida, em uso ou de partida encerrada!\n");
         return;
     }
 
-    // verificar se deu JOIN
-    if (!p->joined) {
-        send_to_player(p, "ERRO: Faça JOIN <seu_nome> primeiro!\n");
+    Player *p = &m->game.players[seat];
+    printf("[SERVER] Partida %u: player %d voltou (socket %d)\n", m->game.id, p->player_id, c->fd);
+    snprintf(c->name, sizeof(c->name), "%s", p->name);
+    c->seat     = seat;
+    c->match    = m;
+    c->want_out = false;
+    m->conns[seat] = c;
+    if (m->connected++ == 0) timer_cancel(&s->timers, &m->orphan);
+    p->sockfd = c->fd;
+    p->binary = (c->proto == PROTO_BINARY);
+    p->out    = &c->out;
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+    if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, c->fd, &ev) == -1) perror("epoll_ctl");
+
+    rejoin_player(&m->game, p);
+    conn_process_input(s, c);  // comandos enviados junto com o RESUME; envia tudo
+}
+
+// Coloca um espectador vindo do lobby na plateia da partida pedida, se ela ainda está
+// em andamento neste shard
+static void shard_watch(Shard *s, Conn *c) {
+    Match *m = shard_find(s, c->attach_id);
+
+    // resto do lobby (a resposta da negociação binária), antes dos eventos
+    outbuf_flush(&c->out, c->fd);
+
+    Spectator *sp = NULL;
+    if (m && !m->game.game_over && (sp = calloc(1, sizeof(*sp)))) {
+        sp->fd     = c->fd;
+        sp->binary = (c->proto == PROTO_BINARY);
+        sp->owner  = c;
+    }
+    if (!sp || !audience_add(&m->game.audience, sp)) {
+        free(sp);
+        shard_reject(c, ERR_UNKNOWN_MATCH, "ERRO: Partida não encontrada ou já encerrada!\n");
         return;
     }
+    outbuf_free(&c->out);
 
-    // READY
-    if (strcmp(clean_cmd, CMD_READY) == 0) {
-        if (p->ship_count != TOTAL_SHIPS) {
-            char msg[MAX_MSG];
-            snprintf(msg, sizeof(msg),
-                     "ERRO: Posicione todos os navios primeiro! (%d/%d)\n",
-                     p->ship_count, TOTAL_SHIPS);
-            send_to_player(p, msg);
-            return;
+    printf("[SERVER] Partida %u: espectador (socket %d) assistindo\n", m->game.id, c->fd);
+    c->spec     = sp;
+    c->match    = m;
+    c->want_out = false;
+    atomic_fetch_add(&s->spectators, 1);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+    if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, c->fd, &ev) == -1) perror("epoll_ctl");
+    spectator_intro(sp, &m->game);
+    if (!spectator_send(s, c)) spectator_close(s, c);
+}
+
+// Em atualização ninguém mais volta com RESUME para este processo: as partidas sem
+// conexão terminam já, em vez de esperar o prazo da retomada e atrasar a saída
+static void shard_drop_orphans(Shard *s) {
+    for (Match *m = s->live; m; m = m->live_next) {
+        if (m->connected > 0 || !timer_armed(&m->orphan)) continue;
+        timer_cancel(&s->timers, &m->orphan);
+        m->next         = s->dead_matches;
+        s->dead_matches = m;
+    }
+}
+
+static void shard_drain_inbox(Shard *s) {
+    uint64_t tmp;
+    if (read(s->wakefd, &tmp, sizeof(tmp)) < 0 && errno != EAGAIN) {
+        perror("read eventfd");
+    }
+
+    // na ordem de envio: a sala chega antes de um WATCH ou RESUME para ela
+    MpscNode *n;
+    while ((n = mpsc_pop(&s->inbox)) != NULL) {
+        ShardMsg *msg = container_of(n, ShardMsg, node);
+        if (msg->kind == MSG_MATCH) {
+            Match *m = container_of(msg, Match, msg);
+            atomic_fetch_sub(&s->inbox_depth, 1);
+            if (m->restored) shard_restore(s, m);
+            else             shard_adopt(s, m);
+        } else {
+            Conn *c = container_of(msg, Conn, msg);
+            if (c->resume_token) shard_resume(s, c);
+            else                 shard_watch(s, c);
         }
-        if (p->ready) {
-            send_to_player(p, "ERRO: Você já está pronto!\n");
-            return;
+    }
+}
+
+// Espera do epoll_wait: até o próximo temporizador da roda, no máximo EPOLL_TIMEOUT
+static int wheel_timeout(const TimerWheel *w) {
+    uint64_t next = timer_wheel_next(w), now = now_us();
+    if (next <= now) return 0;
+    uint64_t ms = (next - now + 999) / 1000;
+    return ms < EPOLL_TIMEOUT ? (int)ms : EPOLL_TIMEOUT;
+}
+
+static void shard_run_timers(Shard *s) {
+    uint64_t now = now_us();
+    Timer *t;
+    while ((t = timer_expire(&s->timers, now)) != NULL) {
+        switch (t->kind) {
+        case TIMER_PAUSE: {
+            Conn *c = container_of(t, Conn, timer);
+            conn_unpause(s, c);
+            conn_process_input(s, c);  // comandos que esperavam no buffer
+            break;
         }
-        p->ready = true;
-        char msg[MAX_MSG];
-        snprintf(msg, sizeof(msg),
-                 "*** PLAYER %d (%s) ESTÁ PRONTO! ***\n",
-                 p->player_id, p->name);
-        broadcast(g, msg);
-
-        // sinaliza condição de ambos prontos
-        pthread_mutex_lock(&g->mutex);
-        bool both = g->players[0].ready && g->players[1].ready;
-        pthread_mutex_unlock(&g->mutex);
-        if (both) {
-            broadcast(g, "\n=== AMBOS JOGADORES PRONTOS ===\n");
-            broadcast(g, "=== INICIANDO BATALHA NAVAL ===\n");
-            g->game_started = true;
-            g->players[0].active_turn = true;
-            g->players[1].active_turn = false;
-
-            snprintf(msg, sizeof(msg),
-                     "\n--- TURNO DO PLAYER 1 (%s) ---\n",
-                     g->players[0].name);
-            broadcast(g, msg);
-            send_to_player(&g->players[0],
-                           "*** SUA VEZ! Digite FIRE <x> <y> ***\n");
+        case TIMER_DEADLINE:
+            match_deadline(s, container_of(t, Match, deadline));
+            break;
+        case TIMER_ORPHAN:
+            match_orphaned(s, container_of(t, Match, orphan));
+            break;
         }
-        return;
     }
+}
 
-    // POS <tipo> <x> <y> <H/V>
-    if (strncmp(clean_cmd, CMD_POS, strlen(CMD_POS)) == 0) {
-        if (g->game_started) {
-            send_to_player(p, "ERRO: Jogo já iniciado!\n");
-            return;
-        }
-        if (p->ready) {
-            send_to_player(p, "ERRO: Você já está pronto!\n");
-            return;
+// Devolve ao lobby uma sala encerrada: ele tira o id do índice e a libera
+static void lobby_post_ended(Match *m) {
+    uint64_t one = 1;
+    m->msg.kind = MSG_ENDED;
+    mpsc_push(&lobby_inbox, &m->msg.node);
+    if (write(lobby_wakefd, &one, sizeof(one)) < 0) perror("write eventfd");
+}
+
+static void *shard_loop(void *arg) {
+    Shard *s = arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    // fixa o shard em um núcleo: o estado das salas nunca troca de thread nem de cache
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(s->cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        fprintf(stderr, "[SERVER] shard %d: não foi possível fixar no núcleo %d\n",
+                s->id, s->cpu);
+    }
+
+    while (!stop_server) {
+        int n = epoll_wait(s->epfd, events, MAX_EVENTS, wheel_timeout(&s->timers));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
         }
-        char type_str[16];
-        int rx, ry;
-        char ori;
-        if (sscanf(clean_cmd + strlen(CMD_POS) + 1,
-                   "%15s %d %d %c",
-                   type_str, &rx, &ry, &ori) == 4)
-        {
-            if (rx < 1 || rx > BOARD_SIZE ||
-                ry < 1 || ry > BOARD_SIZE)
-            {
-                send_to_player(p,
-                    "ERRO: Coordenadas devem ser 1 a 8!\n");
-                return;
-            }
-            ShipType type = parse_ship_type(type_str);
-            if (type == 0) {
-                send_to_player(p,
-                    "ERRO: Tipo inválido! Use SUBMARINO, FRAGATA ou DESTROYER\n");
-                return;
+        for (int i = 0; i < n; i++) {
+            Conn *c = events[i].data.ptr;
+            if (!c) {
+                shard_drain_inbox(s);
+                continue;
             }
-            // limite de cada tipo
-            int used = count_ships_of_type(p, type);
-            int limit = (type == FRAGATA) ? 2 : 1;
-            if (used >= limit) {
-                send_to_player(p,
-                    "ERRO: Limite deste tipo atingido!\n");
-                return;
+            if (c->fd == -1) continue;  // fechada por outro evento deste lote
+            if (c->spec) {
+                spectator_event(s, c, events[i].events);
+                continue;
             }
-            Coord c = { rx-1, ry-1 };
-            Orientation o = (ori=='H'||ori=='h') ? HORIZONTAL : VERTICAL;
-            if (place_ship(p, type, c, o)) {
-                char msg[MAX_MSG];
-                snprintf(msg, sizeof(msg),
-                         "*** %s em %d,%d %c! (%d/%d navios) ***\n",
-                         type_str, rx, ry, ori,
-                         p->ship_count, TOTAL_SHIPS);
-                send_to_player(p, msg);
-                if (p->ship_count == TOTAL_SHIPS) {
-                    send_to_player(p,
-                        "*** TODOS POSICIONADOS! Digite READY ***\n");
+            if (events[i].events & EPOLLOUT) {
+                if (!conn_flush(c, s->epfd)) {
+                    conn_close(s, c);
+                    continue;
+                }
+                if (c->paused && !timer_armed(&c->timer) && outbuf_pending(&c->out) == 0) {
+                    conn_unpause(s, c);
+                    conn_process_input(s, c);  // comandos que esperavam no buffer
                 }
-            } else {
-                send_to_player(p,
-                    "ERRO: Posição inválida ou ocupada!\n");
             }
-        } else {
-            send_to_player(p,
-                "ERRO: Use: POS <tipo> <x> <y> <H/V>\n");
+            if (c->fd != -1 && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                conn_readable(s, c);
+            }
+        }
+
+        shard_run_timers(s);
+        if (draining) shard_drop_orphans(s);
+
+        // só libera depois do lote, pois ainda podem haver eventos pendentes destas conexões
+        while (s->dead_matches) {
+            Match *m = s->dead_matches;
+            s->dead_matches = m->next;
+            printf("[SERVER] Partida %u encerrada (shard %d)\n", m->game.id, s->id);
+            Audience *a = m->game.audience;
+            while (a && a->count > 0) {
+                Conn *c = a->list[0]->owner;
+                if (!c->spec->overflow) spectator_flush(c->spec);  // última tentativa, sem esperar
+                spectator_close(s, c);
+            }
+            shard_untrack(s, m);
+            timer_cancel(&s->timers, &m->deadline);
+            timer_cancel(&s->timers, &m->orphan);
+            gamelog_end(m->game.id);
+            metrics_game_ended(m->game.game_over);
+            ai_destroy(m->bot);
+            destroy_game(&m->game);
+            if (m->snap) snapshot_release(m->snap);
+            atomic_fetch_sub(&s->active, 1);
+            lobby_post_ended(m);
+        }
+        while (s->dead_conns) {
+            Conn *c = s->dead_conns;
+            s->dead_conns = c->next_dead;
+            outbuf_free(&c->out);
+            free(c->spec);
+            free(c);
         }
-        return;
     }
+    return NULL;
+}
 
-    // FIRE <x> <y>
-    if (strncmp(clean_cmd, CMD_FIRE, strlen(CMD_FIRE)) == 0) {
-        if (!g->game_started) {
-            send_to_player(p, "ERRO: Jogo não iniciado!\n");
-            return;
+static void shard_wake(Shard *s) {
+    uint64_t one = 1;
+    if (write(s->wakefd, &one, sizeof(one)) < 0) perror("write eventfd");
+}
+
+// O shard só acorda depois do push: um item pela metade nunca fica sem um aviso depois
+static void shard_post(Shard *s, Match *m) {
+    m->msg.kind = MSG_MATCH;
+    int depth = atomic_fetch_add(&s->inbox_depth, 1) + 1;
+    mpsc_push(&s->inbox, &m->msg.node);
+
+    int max = atomic_load(&s->inbox_max);
+    while (depth > max && !atomic_compare_exchange_weak(&s->inbox_max, &max, depth)) {}
+
+    shard_wake(s);
+}
+
+// Entrega ao shard uma conexão que pediu WATCH ou RESUME de uma partida dele
+static void shard_post_attach(Shard *s, Conn *c) {
+    c->msg.kind = MSG_ATTACH;
+    mpsc_push(&s->inbox, &c->msg.node);
+    shard_wake(s);
+}
+
+static void shard_start(Shard *s, int id, int ncpu) {
+    s->id     = id;
+    s->cpu    = id % ncpu;
+    s->epfd   = epoll_create1(0);
+    s->wakefd = eventfd(0, EFD_NONBLOCK);
+    if (s->epfd == -1 || s->wakefd == -1) { perror("epoll/eventfd"); exit(1); }
+    mpsc_init(&s->inbox);
+    timer_wheel_init(&s->timers, now_us());
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    epoll_ctl(s->epfd, EPOLL_CTL_ADD, s->wakefd, &ev);
+    if (pthread_create(&s->tid, NULL, shard_loop, s) != 0) {
+        perror("pthread_create"); exit(1);
+    }
+}
+
+// Escolhe o shard com menos salas ativas; empates em rodízio
+static Shard *pick_shard(void) {
+    Shard *best = NULL;
+    int best_load = 0;
+    for (int k = 0; k < shard_count; k++) {
+        Shard *s = &shards[(next_shard + k) % shard_count];
+        int load = atomic_load(&s->active) + atomic_load(&s->inbox_depth);
+        if (!best || load < best_load) {
+            best = s;
+            best_load = load;
         }
-        if (!p->active_turn) {
-            Player *opp = (p == &g->players[0])
-                          ? &g->players[1]
-                          : &g->players[0];
-            char msg[MAX_MSG];
-            snprintf(msg, sizeof(msg),
-                     "ERRO: Aguarde PLAYER %d (%s)\n",
-                     opp->player_id, opp->name);
-            send_to_player(p, msg);
-            return;
+    }
+    next_shard = (next_shard + 1) % shard_count;
+    return best;
+}
+
+static void report_shards(void) {
+    printf("[LOBBY] fila de espera: %d jogador(es)\n", lobby_depth);
+    for (int i = 0; i < shard_count; i++) {
+        Shard *s = &shards[i];
+        unsigned long rooms = atomic_load(&s->rooms);
+        unsigned long avg = rooms ? atomic_load(&s->ttm_total_us) / rooms : 0;
+        printf("[LOBBY] shard %d (cpu %d): fila=%d (máx %d) salas=%lu ativas=%d "
+               "tempo até partida médio=%luus máx=%luus\n",
+               s->id, s->cpu,
+               atomic_load(&s->inbox_depth), atomic_load(&s->inbox_max),
+               rooms, atomic_load(&s->active),
+               avg, atomic_load(&s->ttm_max_us));
+    }
+    fflush(stdout);
+}
+
+// Valores instantâneos que acompanham as métricas (só a thread do lobby chama)
+static void read_gauges(MetricsGauges *g) {
+    g->lobby_waiting  = lobby_depth;
+    g->matches_active = 0;
+    g->spectators     = 0;
+    for (int i = 0; i < shard_count; i++) {
+        g->matches_active += atomic_load(&shards[i].active);
+        g->spectators     += atomic_load(&shards[i].spectators);
+    }
+    g->log_dropped    = gamelog_dropped();
+    g->pool_count     = mode_count;
+    for (int i = 0; i < mode_count; i++) {
+        SlabStats st;
+        slab_stats(&match_pools[i], &st);
+        g->pools[i] = (MetricsPool){ modes[i].name, st.obj_size, st.in_use, st.capacity, st.bytes };
+    }
+}
+
+// Métricas acumuladas de todas as threads, no formato do STATS
+static void report_metrics(void) {
+    static Metrics m;
+    MetricsGauges g;
+    metrics_snapshot(&m);
+    read_gauges(&g);
+    char out[STATS_BUF];
+    metrics_format(&m, &g, false, out, sizeof(out));
+    for (char *line = strtok(out, "\n"); line; line = strtok(NULL, "\n")) {
+        printf("[STATS] %s\n", line);
+    }
+    fflush(stdout);
+}
+
+/* ---------------------------------------------------------------------------
+ * Aceitadores
+ * ------------------------------------------------------------------------- */
+
+// Socket de escuta na porta, compartilhada com os dos outros aceitadores; -1 em erro
+static int open_listener(int port, int backlog) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd == -1) {
+        perror("socket");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == -1) {
+        perror("SO_REUSEPORT");
+        close(fd);
+        return -1;
+    }
+    struct sockaddr_in addr = {
+        .sin_family      = AF_INET,
+        .sin_addr.s_addr = INADDR_ANY,
+        .sin_port        = htons(port)
+    };
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, backlog) == -1) {
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Aceita tudo o que está na fila do kernel e acorda o lobby uma vez pelo lote
+static void acceptor_drain(Acceptor *a) {
+    int handed = 0;
+    for (;;) {
+        struct sockaddr_in addr = { 0 };
+        socklen_t addrlen = sizeof(addr);
+        int fd = accept4(a->fd, (struct sockaddr *)&addr, &addrlen, SOCK_NONBLOCK);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN) perror("accept");
+            break;
         }
-        int rx, ry;
-        if (sscanf(clean_cmd + strlen(CMD_FIRE) + 1,
-                   "%d %d", &rx, &ry) == 2)
-        {
-            if (rx < 1 || rx > BOARD_SIZE ||
-                ry < 1 || ry > BOARD_SIZE)
-            {
-                send_to_player(p,
-                    "ERRO: Coordenadas 1 a 8!\n");
-                return;
-            }
-            handle_fire(g, p, (Coord){rx-1, ry-1});
-        } else {
-            send_to_player(p,
-                "ERRO: Use: FIRE <x> <y>\n");
+        // endereço com conexões demais: fecha antes de custar memória ou trabalho do lobby
+        if (!iplimit_acquire(addr.sin_addr.s_addr, now_us())) {
+            metrics_limit(ML_IP_REFUSED);
+            close(fd);
+            continue;
+        }
+        // as respostas já saem agrupadas por comando: o Nagle só atrasaria o envio
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        Conn *c = calloc(1, sizeof(*c));
+        if (!c) {
+            iplimit_release(addr.sin_addr.s_addr);
+            close(fd);
+            continue;
+        }
+        c->fd   = fd;
+        c->seat = -1;
+        c->addr = addr.sin_addr.s_addr;
+        c->msg.kind = MSG_CONN;
+        metrics_conn_opened();
+        mpsc_push(&lobby_inbox, &c->msg.node);
+        handed++;
+    }
+    if (handed > 0) {
+        uint64_t one = 1;
+        if (write(lobby_wakefd, &one, sizeof(one)) < 0) perror("write eventfd");
+    }
+}
+
+static void *acceptor_loop(void *arg) {
+    Acceptor *a = arg;
+    struct pollfd pfd[2] = {
+        { .fd = a->fd,          .events = POLLIN },
+        { .fd = accept_stopfd,  .events = POLLIN },
+    };
+    while (!stop_server && atomic_load(&accepting)) {
+        int n = poll(pfd, 2, EPOLL_TIMEOUT);
+        if (n < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        if (n > 0 && (pfd[0].revents & POLLIN) && atomic_load(&accepting)) acceptor_drain(a);
+    }
+    return NULL;
+}
+
+static void acceptors_start(void) {
+    atomic_store(&accepting, true);
+    for (int i = 0; i < acceptor_count; i++) {
+        if (pthread_create(&acceptors[i].tid, NULL, acceptor_loop, &acceptors[i]) != 0) {
+            perror("pthread_create"); exit(1);
         }
-        return;
     }
+    acceptors_running = true;
+}
 
-    // Comando inválido
-    send_to_player(p,
-        "COMANDO INVÁLIDO! JOIN, POS, READY ou FIRE\n");
+// Para de aceitar; as conexões que chegarem esperam na fila do kernel de cada socket
+static void acceptors_stop(void) {
+    if (!acceptors_running) return;
+    atomic_store(&accepting, false);
+    uint64_t one = 1;
+    if (write(accept_stopfd, &one, sizeof(one)) < 0) perror("write eventfd");
+    for (int i = 0; i < acceptor_count; i++) pthread_join(acceptors[i].tid, NULL);
+    if (read(accept_stopfd, &one, sizeof(one)) < 0 && errno != EAGAIN) perror("read eventfd");
+    acceptors_running = false;
 }
 
-void *handle_client(void *arg) {
-    Player *p = arg;
-    char buf[MAX_MSG];
+// Pede ao servidor em execução (socket de administração em path) os sockets de escuta dele.
+// Retorna quantos vieram em fds e, em seq, as partidas já numeradas; -1 em erro.
+static int handoff_receive(const char *path, int *fds, uint64_t *seq) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Caminho do socket de administração longo demais: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        send(fd, "HANDOFF\n", 8, MSG_NOSIGNAL) == -1)
+    {
+        perror(path);
+        if (fd != -1) close(fd);
+        return -1;
+    }
+
+    char msg[MAX_MSG];
+    struct iovec iov = { .iov_base = msg, .iov_len = sizeof(msg) - 1 };
+    union {
+        struct cmsghdr hdr;
+        char           buf[CMSG_SPACE(sizeof(int) * MAX_ACCEPTORS)];
+    } ctl;
+    struct msghdr mh = {
+        .msg_iov = &iov, .msg_iovlen = 1,
+        .msg_control = ctl.buf, .msg_controllen = sizeof(ctl.buf)
+    };
+    ssize_t len = recvmsg(fd, &mh, MSG_CMSG_CLOEXEC);
+    close(fd);
+    if (len <= 0) {
+        fprintf(stderr, "[SERVER] %s não respondeu ao HANDOFF\n", path);
+        return -1;
+    }
+    msg[len] = '\0';
+
+    int n = 0;
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+    if (cm && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS) {
+        n = (int)((cm->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        memcpy(fds, CMSG_DATA(cm), n * sizeof(int));
+    }
+    unsigned long long count;
+    if (n == 0 || sscanf(msg, "HANDOFF %llu", &count) != 1) {
+        for (int i = 0; i < n; i++) close(fds[i]);
+        fprintf(stderr, "[SERVER] %s recusou o HANDOFF: %s", path, msg);
+        return -1;
+    }
+    *seq = count;
+    return n;
+}
 
-    printf("[DEBUG] Cliente conectado (socket %d)\n", p->sockfd);
+/* ---------------------------------------------------------------------------
+ * Lobby
+ * ------------------------------------------------------------------------- */
+
+static void lobby_unlink(Conn *c) {
+    LobbyQueue *q = &lobby[c->mode];
+    if (c->prev) c->prev->next = c->next; else q->head = c->next;
+    if (c->next) c->next->prev = c->prev; else q->tail = c->prev;
+    c->prev = c->next = NULL;
+    q->depth--;
+    lobby_depth--;
+}
+
+static void lobby_close(Conn *c) {
+    if (!c->admin) {
+        metrics_conn_closed();
+        iplimit_release(c->addr);
+    }
+    if (c->joined) lobby_unlink(c);
+    timer_cancel(&lobby_timers, &c->timer);
+    epoll_ctl(lobby_epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    outbuf_free(&c->out);
+    free(c);
+}
+
+static uint32_t live_hash(uint32_t id) {
+    return (id * 2654435761u) & (live_cap - 1);
+}
+
+// Shard da partida em andamento; -1 se o id não é de nenhuma
+static int live_shard(uint32_t id) {
+    if (live_count == 0 || id == 0) return -1;
+    for (uint32_t i = live_hash(id);; i = (i + 1) & (live_cap - 1)) {
+        if (live_index[i].id == id) return live_index[i].shard;
+        if (live_index[i].id == 0)  return -1;
+    }
+}
+
+static void live_insert(LiveEntry e) {
+    uint32_t i = live_hash(e.id);
+    while (live_index[i].id != 0) i = (i + 1) & (live_cap - 1);
+    live_index[i] = e;
+    live_count++;
+}
+
+// false sem memória: a partida joga, só não pode ser assistida nem retomada
+static bool live_add(uint32_t id, const Shard *s) {
+    if ((live_count + 1) * 2 > live_cap) {  // no máximo meia cheia
+        LiveEntry *old = live_index;
+        uint32_t   cap = live_cap;
+        LiveEntry *map = calloc(cap ? cap * 2 : 1024, sizeof(*map));
+        if (!map) return false;
+        live_index = map;
+        live_cap   = cap ? cap * 2 : 1024;
+        live_count = 0;
+        for (uint32_t i = 0; i < cap; i++) {
+            if (old[i].id != 0) live_insert(old[i]);
+        }
+        free(old);
+    }
+    live_insert((LiveEntry){ id, s->id });
+    return true;
+}
+
+// Tira o id e puxa para trás os que vinham depois dele na mesma sequência, para a busca
+// não parar no buraco
+static void live_remove(uint32_t id) {
+    if (live_count == 0) return;
+    uint32_t i = live_hash(id);
+    while (live_index[i].id != id) {
+        if (live_index[i].id == 0) return;
+        i = (i + 1) & (live_cap - 1);
+    }
+    for (uint32_t j = (i + 1) & (live_cap - 1); live_index[j].id != 0; j = (j + 1) & (live_cap - 1)) {
+        uint32_t home = live_hash(live_index[j].id);
+        // j fica se a posição ideal dele está em (i, j]
+        if (((j - home) & (live_cap - 1)) < ((j - i) & (live_cap - 1))) continue;
+        live_index[i] = live_index[j];
+        i = j;
+    }
+    live_index[i].id = 0;
+    live_count--;
+}
+
+// Id da próxima partida. A contagem (64 bits, continua a do snapshot) não volta, mas o id
+// vai em 32 bits no protocolo e na sessão: depois de UINT32_MAX partidas ele recomeça do
+// 1, pulando os de salas ainda em andamento.
+static uint32_t take_match_id(void) {
+    uint32_t id;
+    do {
+        id = (uint32_t)(match_seq++ % UINT32_MAX) + 1;
+    } while (live_shard(id) != -1);
+    snapshot_set_match_seq(match_seq);
+    return id;
+}
+
+// Segredo da sessão de um assento: 64 bits do getrandom (o id da partida vai à parte, para
+// o lobby achar o shard). Sem getrandom o assento fica sem sessão (0) em vez de receber
+// um segredo adivinhável.
+static uint64_t session_secret(uint32_t match_id) {
+    uint64_t r = 0;
+    while (r == 0) {
+        if (getrandom(&r, sizeof(r), 0) != (ssize_t)sizeof(r)) {
+            fprintf(stderr, "[SERVER] Partida %u sem sessão para RESUME: getrandom: %s\n",
+                    match_id, strerror(errno));
+            return 0;
+        }
+    }
+    return r;
+}
 
-    while (!game.game_over) {
-        int bytes = recv(p->sockfd, buf, MAX_MSG-1, 0);
-        if (bytes <= 0) {
-            printf("[DEBUG] Cliente desconectado (socket %d)\n", p->sockfd);
+static int find_mode(const char *name) {
+    for (int i = 0; i < mode_count; i++) {
+        if (strcasecmp(modes[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+// Retoma as partidas que estavam em andamento no snapshot da execução anterior: cada uma
+// vai para um shard e espera os jogadores voltarem com RESUME
+static void lobby_restore(void) {
+    // ids de partidas já encerradas também não voltam: seus logs seriam sobrescritos
+    if (snapshot_match_seq() > match_seq) match_seq = snapshot_match_seq();
+    int restored = 0;
+    for (int i = 0; i < snapshot_slot_count(); i++) {
+        SnapSlot *slot = snapshot_slot(i);
+        if (slot->state != SNAP_LIVE) continue;
+        // com -S os objetos de todos os pools têm o mesmo tamanho; o modo só escolhe a conta
+        int    mode = find_mode(slot->mode.name);
+        Slab  *pool = &match_pools[mode == -1 ? 0 : mode];
+        Match *m    = slab_alloc(pool);
+        if (!m) {
+            perror("malloc");
             break;
         }
-        buf[bytes] = '\0';
-        buf[strcspn(buf, "\r\n")] = '\0';
-        if (strlen(buf) > 0) {
-            if (log_file) {
-                fprintf(log_file, "PLAYER %d -> %s\n", p->player_id, buf);
-                fflush(log_file);
-            }
-            process_command(&game, p, buf);
+        m->pool = pool;
+        init_game_in(&m->game, &slot->mode, snapshot_storage(slot));
+        m->game.id = slot->match_id;
+        for (int k = 0; k < MAX_CLIENTS; k++) {
+            Player *p = &m->game.players[k];
+            add_player(&m->game, -1);
+            memcpy(p->name, slot->players[k].name, MAX_NAME_LEN);
+            p->joined      = slot->players[k].joined;
+            p->ready       = slot->players[k].ready;
+            p->active_turn = slot->players[k].active_turn;
+            m->tokens[k]   = slot->players[k].token;
         }
+        m->game.game_started = slot->started;
+        m->game.turns        = slot->turns;
+        m->game.forfeit      = slot->forfeit;
+        game_restore_boards(&m->game);
+
+        m->snap      = slot;
+        m->restored  = true;
+        m->bot_seat  = slot->bot_seat;
+        m->queued_at = now_us();
+        m->shard     = pick_shard();
+        live_add(m->game.id, m->shard);
+        atomic_fetch_add(&m->shard->active, 1);
+        atomic_fetch_add(&m->shard->rooms, 1);
+        shard_post(m->shard, m);
+        restored++;
     }
+    if (restored > 0) printf("[SERVER] %d partida(s) retomada(s) do snapshot\n", restored);
+}
 
-    close(p->sockfd);
-    p->sockfd = -1;
+// Forma uma sala com os humanos primeiros da fila do modo (os demais assentos ficam
+// para o bot) e a entrega a um shard
+static bool lobby_make_match(int mode, int humans) {
+    LobbyQueue *q = &lobby[mode];
+    int bot_seat = humans < MAX_CLIENTS ? humans : -1;
+    Slab  *pool = &match_pools[mode];
+    Match *m    = slab_alloc(pool);
+    if (!m) {
+        perror("malloc");
+        return false;
+    }
+    m->pool = pool;
+    uint32_t id = take_match_id();
+    if ((m->snap = snapshot_alloc(id, &modes[mode], bot_seat)) != NULL) {
+        init_game_in(&m->game, &modes[mode], snapshot_storage(m->snap));
+    } else if (pool->obj_size > MATCH_HEAD) {
+        init_game_in(&m->game, &modes[mode], (char *)m + MATCH_HEAD);
+    } else if (!init_game(&m->game, &modes[mode])) {  // -S sem fatia livre
+        perror("calloc");
+        slab_free(pool, m);
+        return false;
+    }
+    if (!m->snap && snapshot_slot_count() > 0) {
+        // a partida joga normalmente, mas não sobrevive a um reinício
+        metrics_snapshot_full();
+        if (!snapshot_full_warned) {
+            fprintf(stderr, "[SNAPSHOT] as %d fatias estão ocupadas: partidas novas ficam fora do "
+                    "snapshot (aumente com -s)\n", snapshot_slot_count());
+        }
+        snapshot_full_warned = true;
+    } else if (m->snap) {
+        snapshot_full_warned = false;
+    }
+    m->game.id   = id;
+    m->shard     = pick_shard();
+    live_add(m->game.id, m->shard);
+    m->connected = humans;
+    m->queued_at = q->head->joined_at;
+    m->bot_seat  = bot_seat;
+    for (int i = 0; i < humans; i++) m->tokens[i] = session_secret(m->game.id);
 
-    // decrementa contador e, se zerar, encerra servidor
-    pthread_mutex_lock(&game.mutex);
-    game.count--;
-    if (game.count <= 0) {
-        printf("[SERVER] Ambos jogadores desconectados, encerrando servidor.\n");
-        game.game_over = true;
+    for (int i = 0; i < humans; i++) {
+        Conn *c = q->head;
+        lobby_unlink(c);
+        timer_cancel(&lobby_timers, &c->timer);  // no shard o timer é o da pausa
+        epoll_ctl(lobby_epfd, EPOLL_CTL_DEL, c->fd, NULL);
+        c->seat  = i;
+        c->match = m;
+        m->conns[i] = c;
     }
-    pthread_mutex_unlock(&game.mutex);
+    atomic_fetch_add(&m->shard->active, 1);
+    atomic_fetch_add(&m->shard->rooms, 1);
+    shard_post(m->shard, m);
+    return true;
+}
 
-    return NULL;
+// Forma salas com os dois primeiros da fila do modo
+static void lobby_pair(int mode) {
+    while (lobby[mode].depth >= MAX_CLIENTS && lobby_make_match(mode, MAX_CLIENTS)) {}
 }
 
-int main() {
-    listenfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (listenfd == -1) { perror("socket"); exit(1); }
+// Quem espera sozinho há mais de bot_wait_us joga contra o bot no segundo assento
+static void lobby_seat_bots(void) {
+    if (bot_wait_us == 0) return;
+    uint64_t now = now_us();
+    for (int mode = 0; mode < mode_count; mode++) {
+        LobbyQueue *q = &lobby[mode];
+        while (q->head && now - q->head->joined_at >= bot_wait_us) {
+            if (!lobby_make_match(mode, 1)) break;
+        }
+    }
+}
 
-    int opt = 1;
-    setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+// Resposta a quem espera ou chega num processo que entregou os sockets (HANDOFF)
+#define DRAINING_MSG "ERRO: Servidor em atualização, conecte-se de novo!\n"
 
-    struct sockaddr_in addr = {
-        .sin_family      = AF_INET,
-        .sin_addr.s_addr = INADDR_ANY,
-        .sin_port        = htons(SERVER_PORT)
-    };
-    if (bind(listenfd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
-        perror("bind"); exit(1);
+static void lobby_error(Conn *c, int code, const char *msg) {
+    metrics_error(code);
+    c->errors++;
+    uint8_t frame[] = { OP_ERROR, (uint8_t)code };
+    conn_reply(c, msg, frame, sizeof(frame));
+}
+
+// Coloca o jogador na fila do modo pedido. Se retornar true a conexão pode já ter
+// sido entregue a um shard, então quem chama não deve mais tocar nela.
+static bool lobby_join(Conn *c, const char *name, const char *mode_name) {
+    if (draining) {
+        lobby_error(c, ERR_DRAINING, DRAINING_MSG);
+        return false;
+    }
+    if (name[0] == '\0') {
+        lobby_error(c, ERR_BAD_FORMAT, "ERRO: Formato inválido! Use: JOIN <seu_nome> [modo]\n");
+        return false;
     }
-    if (listen(listenfd, 5) == -1) {
-        perror("listen"); exit(1);
+    c->mode = mode_name[0] ? find_mode(mode_name) : default_mode;
+    if (c->mode == -1) {
+        char msg[MAX_MSG];
+        int off = snprintf(msg, sizeof(msg), "ERRO: Modo desconhecido! Disponíveis:");
+        for (int i = 0; i < mode_count; i++) {
+            off += snprintf(msg + off, sizeof(msg) - off, " %s", modes[i].name);
+        }
+        snprintf(msg + off, sizeof(msg) - off, "\n");
+        lobby_error(c, ERR_UNKNOWN_MODE, msg);
+        return false;
     }
+    snprintf(c->name, sizeof(c->name), "%s", name);
 
-    init_game(&game);
-    printf("[SERVER] Servidor Batalha Naval iniciado na porta %d\n", SERVER_PORT);
-    printf("[SERVER] Aguardando jogadores...\n");
+    LobbyQueue *q = &lobby[c->mode];
+    c->joined    = true;
+    c->joined_at = now_us();
+    c->prev      = q->tail;
+    if (q->tail) q->tail->next = c; else q->head = c;
+    q->tail = c;
+    q->depth++;
+    lobby_depth++;
+    if (queue_us) timer_arm(&lobby_timers, &c->timer, TIMER_QUEUE, c->joined_at + queue_us);
+    else          timer_cancel(&lobby_timers, &c->timer);
 
-    log_file = fopen("game_log.txt", "w");
-    if (!log_file) {
-        perror("fopen");
-        exit(1);
+    if (q->depth < MAX_CLIENTS) {
+        uint8_t waiting[] = { OP_WAITING };
+        conn_reply(c, "*** AGUARDANDO OUTRO JOGADOR... ***\n", waiting, sizeof(waiting));
     }
-    fprintf(log_file, "=== NOVO JOGO INICIADO ===\n\n");
-    fflush(log_file);
+    lobby_pair(c->mode);
+    return true;
+}
 
-    // aceita exatamente MAX_CLIENTS jogadores
-    while (game.count < MAX_CLIENTS) {
-        int conn = accept(listenfd, NULL, NULL);
-        if (conn == -1) {
-            perror("accept");
-            continue;
+// Sessão do RESUME em texto: o id da partida (8 dígitos hexadecimais) e o segredo (16)
+static bool parse_session(Token t, uint32_t *id, uint64_t *secret) {
+    if (t.len != 24) return false;
+    uint64_t v[2] = { 0, 0 };
+    for (int i = 0; i < t.len; i++) {
+        int d = t.s[i] >= '0' && t.s[i] <= '9' ? t.s[i] - '0'
+              : t.s[i] >= 'a' && t.s[i] <= 'f' ? t.s[i] - 'a' + 10
+              : t.s[i] >= 'A' && t.s[i] <= 'F' ? t.s[i] - 'A' + 10 : -1;
+        if (d == -1) return false;
+        v[i >= 8] = v[i >= 8] << 4 | (uint64_t)d;
+    }
+    *id     = (uint32_t)v[0];
+    *secret = v[1];
+    return *secret != 0;
+}
+
+// WATCH <partida> e RESUME <sessão>: entrega a conexão ao shard da partida, que a põe na
+// plateia ou de volta no assento (token != 0). Se retornar true a conexão já é do shard e
+// quem chama não deve mais tocar nela.
+static bool lobby_attach(Conn *c, uint32_t id, uint64_t token) {
+    int shard = live_shard(id);
+    if (shard == -1) {
+        if (token) lobby_error(c, ERR_BAD_SESSION, "ERRO: Sessão inválida, em uso ou de partida encerrada!\n");
+        else       lobby_error(c, ERR_UNKNOWN_MATCH, "ERRO: Partida não encontrada ou já encerrada!\n");
+        return false;
+    }
+    timer_cancel(&lobby_timers, &c->timer);
+    epoll_ctl(lobby_epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    c->attach_id    = id;
+    c->resume_token = token;
+    shard_post_attach(&shards[shard], c);
+    return true;
+}
+
+// Antes do pareamento só JOIN <nome> [modo], WATCH <partida> e RESUME <sessão> são aceitos
+// Retorna true se a conexão saiu do lobby ou pode já ter saído (ver lobby_join)
+static bool lobby_text_command(Conn *c, const char *line, int len) {
+    uint64_t start = metrics_clock();
+    Command cmd;
+    parse_command(line, (size_t)len, &cmd);
+
+    if (cmd.kind == CK_WATCH || cmd.kind == CK_RESUME) {
+        bool handed = false;
+        uint32_t id;
+        uint64_t secret;
+        if (cmd.kind == CK_WATCH && cmd.valid) {
+            handed = lobby_attach(c, cmd.attach.match, 0);
+        } else if (cmd.kind == CK_WATCH) {
+            lobby_error(c, ERR_BAD_FORMAT, "ERRO: Use: WATCH <partida>\n");
+        } else if (cmd.valid && parse_session(cmd.attach.arg, &id, &secret)) {
+            handed = lobby_attach(c, id, secret);
+        } else {
+            lobby_error(c, ERR_BAD_SESSION, "ERRO: Sessão inválida, em uso ou de partida encerrada!\n");
         }
-        if (!add_player(&game, conn)) {
-            send(conn, "ERRO: Jogo já está cheio!\n", 26, 0);
-            close(conn);
-            continue;
+        metrics_command(MC_OTHER, start);
+        return handed;
+    }
+    if (cmd.kind != CK_JOIN) {
+        lobby_error(c, ERR_NOT_JOINED, "ERRO: Faça JOIN <seu_nome> primeiro!\n");
+        metrics_command(metrics_command_kind(cmd.kind), start);
+        return false;
+    }
+    char name[MAX_NAME_LEN] = "";
+    char mode_name[MAX_MODE_NAME] = "";
+    if (cmd.valid) {
+        snprintf(name, sizeof(name), "%.*s", cmd.join.name.len, cmd.join.name.s);
+        snprintf(mode_name, sizeof(mode_name), "%.*s", cmd.join.mode.len, cmd.join.mode.s);
+    }
+    bool queued = lobby_join(c, name, mode_name);
+    metrics_command(MC_JOIN, start);
+    return queued;
+}
+
+// Como lobby_text_command(), para um quadro binário
+static bool lobby_frame_command(Conn *c, const uint8_t *frame) {
+    uint64_t start = metrics_clock();
+    if (frame[0] == OP_WATCH || frame[0] == OP_RESUME) {
+        uint64_t token = 0;
+        if (frame[0] == OP_RESUME) {
+            token = ((uint64_t)bin_get32(frame + 5) << 32) | bin_get32(frame + 9);
         }
-        pthread_t tid;
-        if (pthread_create(&tid, NULL, handle_client,
-                           &game.players[game.count-1]) != 0)
-        {
-            perror("pthread_create");
-            close(conn);
-            pthread_mutex_lock(&game.mutex);
-            game.count--;
-            pthread_mutex_unlock(&game.mutex);
+        bool handed = false;
+        if (frame[0] == OP_RESUME && token == 0) lobby_error(c, ERR_BAD_SESSION, NULL);
+        else handed = lobby_attach(c, (uint32_t)bin_get32(frame + 1), token);
+        metrics_command(MC_OTHER, start);
+        return handed;
+    }
+    if (frame[0] != OP_JOIN) {
+        lobby_error(c, ERR_NOT_JOINED, NULL);
+        metrics_command(metrics_frame_kind(frame[0]), start);
+        return false;
+    }
+    // nome fora do formato fica vazio: lobby_join recusa com ERR_BAD_FORMAT
+    char name[MAX_NAME_LEN] = "", mode_name[BIN_MODE_LEN + 1];
+    size_t name_len = strnlen((const char *)frame + 1, BIN_NAME_LEN);
+    if (valid_player_name((const char *)frame + 1, name_len)) {
+        snprintf(name, sizeof(name), "%.*s", (int)name_len, (const char *)frame + 1);
+    }
+    memcpy(mode_name, frame + 1 + BIN_NAME_LEN, BIN_MODE_LEN);
+    mode_name[BIN_MODE_LEN] = '\0';
+    mode_name[MAX_MODE_NAME - 1] = '\0';
+    bool queued = lobby_join(c, name, mode_name);
+    metrics_command(MC_JOIN, start);
+    return queued;
+}
+
+// Conexões novas deixadas pelos aceitadores passam a ser vigiadas pelo lobby; salas
+// encerradas pelos shards saem do índice e voltam ao pool
+static void lobby_drain_inbox(void) {
+    uint64_t tmp;
+    if (read(lobby_wakefd, &tmp, sizeof(tmp)) < 0 && errno != EAGAIN) {
+        perror("read eventfd");
+    }
+    MpscNode *n;
+    while ((n = mpsc_pop(&lobby_inbox)) != NULL) {
+        ShardMsg *msg = container_of(n, ShardMsg, node);
+        if (msg->kind == MSG_ENDED) {
+            Match *m = container_of(msg, Match, msg);
+            live_remove(m->game.id);
+            slab_free(m->pool, m);
             continue;
         }
-        pthread_detach(tid);
+        Conn *c = container_of(msg, Conn, msg);
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        if (epoll_ctl(lobby_epfd, EPOLL_CTL_ADD, c->fd, &ev) == -1) {
+            perror("epoll_ctl");
+            metrics_conn_closed();
+            iplimit_release(c->addr);
+            close(c->fd);
+            free(c);
+        } else if (idle_us) {
+            timer_arm(&lobby_timers, &c->timer, TIMER_IDLE, now_us() + idle_us);
+        }
+    }
+}
+
+// HANDOFF no socket de administração: um binário novo (-H) assume os sockets de escuta.
+// Os sockets continuam abertos no outro processo, então nada do que está na fila do
+// kernel se perde; este só termina as partidas em andamento e sai.
+static void lobby_handoff(Conn *c) {
+    if (draining) {
+        const char *err = "ERRO: Sockets de escuta já entregues\n";
+        send(c->fd, err, strlen(err), MSG_NOSIGNAL);
+        return;
+    }
+    acceptors_stop();
+    lobby_drain_inbox();  // as já aceitas continuam aqui
+
+    char msg[32];
+    int len = snprintf(msg, sizeof(msg), "HANDOFF %llu\n", (unsigned long long)match_seq);
+    struct iovec iov = { .iov_base = msg, .iov_len = len };
+    union {
+        struct cmsghdr hdr;
+        char           buf[CMSG_SPACE(sizeof(int) * MAX_ACCEPTORS)];
+    } ctl;
+    memset(&ctl, 0, sizeof(ctl));
+    struct msghdr mh = {
+        .msg_iov = &iov, .msg_iovlen = 1,
+        .msg_control = ctl.buf, .msg_controllen = CMSG_SPACE(sizeof(int) * acceptor_count)
+    };
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type  = SCM_RIGHTS;
+    cm->cmsg_len   = CMSG_LEN(sizeof(int) * acceptor_count);
+    int *fds = (int *)CMSG_DATA(cm);
+    for (int i = 0; i < acceptor_count; i++) fds[i] = acceptors[i].fd;
+
+    if (sendmsg(c->fd, &mh, MSG_NOSIGNAL) != len) {
+        perror("sendmsg");
+        acceptors_start();
+        return;
+    }
+    for (int i = 0; i < acceptor_count; i++) {
+        close(acceptors[i].fd);
+        acceptors[i].fd = -1;
+    }
+    draining = true;
+
+    // quem esperava adversário reconecta e entra na fila do processo novo
+    for (int mode = 0; mode < mode_count; mode++) {
+        while (lobby[mode].head) {
+            Conn *w = lobby[mode].head;
+            lobby_error(w, ERR_DRAINING, DRAINING_MSG);
+            lobby_close(w);
+        }
+    }
+    int active = 0;
+    for (int i = 0; i < shard_count; i++) active += atomic_load(&shards[i].active);
+    printf("[SERVER] Sockets de escuta entregues a outro processo; saindo depois de "
+           "%d partida(s) em andamento\n", active);
+    fflush(stdout);
+}
+
+// Responde STATS [JSON] no socket de administração com as métricas de todas as threads.
+// As respostas não entram na contagem de envios: são tráfego de operação, não de jogo.
+static void admin_command(Conn *c, const char *buf) {
+    char name[16] = "", format[16] = "";
+    sscanf(buf, "%15s %15s", name, format);
+    if (strcasecmp(name, "HANDOFF") == 0) {
+        lobby_handoff(c);
+        return;
+    }
+    if (strcasecmp(name, "STATS") != 0 || (format[0] && strcasecmp(format, "JSON") != 0)) {
+        const char *err = "ERRO: Use: STATS [JSON]\n";
+        send(c->fd, err, strlen(err), MSG_NOSIGNAL);
+        return;
     }
+    static Metrics m;
+    MetricsGauges g;
+    metrics_snapshot(&m);
+    read_gauges(&g);
 
-    // mantém servidor vivo até game_over = true
-    while (!game.game_over) {
-        sleep(1);
+    char out[STATS_BUF];
+    size_t len = metrics_format(&m, &g, format[0] != '\0', out, sizeof(out));
+    send(c->fd, out, len, MSG_NOSIGNAL);
+}
+
+// Cobra os erros que o lobby respondeu desde a última cobrança, no mesmo balde que a
+// partida usa; quem passou do limite é desconectado e aí retorna false
+static bool lobby_charge_errors(Conn *c) {
+    unsigned errors = c->errors;
+    c->errors = 0;
+    if (errors == 0 || !rate_limit_on(&err_limit) ||
+        bucket_charge(&c->errs, &err_limit, now_us(), errors)) {
+        return true;
     }
+    printf("[SERVER] Cliente (socket %d) mandou comandos inválidos demais, desconectando\n", c->fd);
+    metrics_limit(ML_FLOOD);
+    lobby_error(c, ERR_FLOOD, FLOOD_MSG);
+    lobby_close(c);
+    return false;
+}
 
-    close(listenfd);
-    fprintf(log_file, "\n=== JOGO FINALIZADO ===\n");
-    fclose(log_file);
+static void lobby_readable(Conn *c) {
+    if (c->joined && c->inlen - c->inoff == (int)sizeof(c->in)) {
+        // buffer cheio de comandos para a partida: pausa até o pareamento
+        struct epoll_event ev = { .events = 0, .data.ptr = c };
+        epoll_ctl(lobby_epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        return;
+    }
+    if (conn_fill(c) < 0) {
+        lobby_close(c);
+        return;
+    }
+    conn_flush(c, lobby_epfd);  // resposta da negociação do protocolo binário
+
+    char *line;
+    int len;
+    if (c->admin) {
+        while ((line = conn_next_line(c, &len)) != NULL) admin_command(c, line);
+        return;
+    }
+
+    // depois do JOIN o resto do buffer (POS, READY...) fica para o shard da partida. No
+    // lobby todo comando ou tira a conexão daqui ou é recusado, então só os erros contam.
+    if (c->proto == PROTO_TEXT) {
+        while (!c->joined && (line = conn_next_line(c, &len)) != NULL) {
+            if (len > 0 && lobby_text_command(c, line, len)) return;
+            if (!lobby_charge_errors(c)) return;
+        }
+        return;
+    }
+
+    uint8_t frame[MAX_MSG];
+    while (!c->joined && (len = conn_next_frame(c, frame)) != 0) {
+        if (len < 0) {
+            lobby_close(c);
+            return;
+        }
+        if (lobby_frame_command(c, frame)) return;
+        if (!lobby_charge_errors(c)) return;
+    }
+}
+
+// Conexão no socket de administração: fala texto e só entende STATS
+static void admin_accept(void) {
+    int fd = accept(adminfd, NULL, NULL);
+    if (fd == -1) {
+        if (errno != EINTR && errno != EAGAIN) perror("accept");
+        return;
+    }
+    Conn *c = calloc(1, sizeof(*c));
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+    if (!c || epoll_ctl(lobby_epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        close(fd);
+        free(c);
+        return;
+    }
+    c->fd    = fd;
+    c->seat  = -1;
+    c->admin = true;
+    c->proto = PROTO_TEXT;
+}
+
+// Abre o socket Unix de administração em path; false se não conseguir
+static bool admin_listen(const char *path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Caminho do socket de administração longo demais: %s\n", path);
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    adminfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (adminfd == -1 || bind(adminfd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(adminfd, 16) == -1)
+    {
+        perror(path);
+        return false;
+    }
+    struct stat st;
+    if (stat(path, &st) == 0) admin_ino = st.st_ino;
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &admin_listener };
+    epoll_ctl(lobby_epfd, EPOLL_CTL_ADD, adminfd, &ev);
+    return true;
+}
+
+// Conexão sem JOIN a tempo ou esperando adversário demais sai do lobby
+static void lobby_run_timers(void) {
+    uint64_t now = now_us();
+    Timer *t;
+    while ((t = timer_expire(&lobby_timers, now)) != NULL) {
+        Conn *c = container_of(t, Conn, timer);
+        if (t->kind == TIMER_IDLE) {
+            printf("[SERVER] Cliente (socket %d) não entrou a tempo, desconectando\n", c->fd);
+            metrics_timeout(MT_IDLE);
+            lobby_error(c, ERR_TIMEOUT, "ERRO: Tempo esgotado sem JOIN, desconectando!\n");
+        } else {
+            printf("[SERVER] %s esperou demais na fila, desconectando\n", c->name);
+            metrics_timeout(MT_LOBBY);
+            lobby_error(c, ERR_TIMEOUT, "ERRO: Nenhum adversário apareceu a tempo, tente de novo!\n");
+        }
+        lobby_close(c);
+    }
+}
+
+static void lobby_loop(int report_secs) {
+    struct epoll_event events[MAX_EVENTS];
+    uint64_t next_report = now_us() + (uint64_t)report_secs * 1000000u;
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &lobby_waker };
+    epoll_ctl(lobby_epfd, EPOLL_CTL_ADD, lobby_wakefd, &ev);
+
+    while (!stop_server) {
+        int n = epoll_wait(lobby_epfd, events, MAX_EVENTS, wheel_timeout(&lobby_timers));
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            Conn *c = events[i].data.ptr;
+            if (c == &admin_listener)   admin_accept();
+            else if (c == &lobby_waker) lobby_drain_inbox();
+            else                        lobby_readable(c);
+        }
+        lobby_run_timers();
+        lobby_seat_bots();
+        if (draining) {
+            int left = 0;
+            for (int i = 0; i < shard_count; i++) left += atomic_load(&shards[i].active);
+            if (left == 0) break;
+        }
+        if (report_secs > 0 && now_us() >= next_report) {
+            report_shards();
+            next_report = now_us() + (uint64_t)report_secs * 1000000u;
+        }
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Uso: %s [-p porta] [-a threads] [-B backlog] [-w shards] [-r segundos]\n"
+        "          [-M modo]... [-m nome] [-L diretório] [-G arquivo] [-F ms] [-b segundos]\n"
+        "          [-A socket] [-S arquivo] [-s fatias] [-H socket] [-R taxa[:rajada]] [-I conexões]\n"
+        "          [-T jogada[:posicionamento]] [-W ocioso[:fila]]\n"
+        "  -p porta     porta TCP de escuta (padrão %d)\n"
+        "  -a threads   threads que aceitam conexões, cada uma com seu socket (padrão %d, máx %d)\n"
+        "  -B backlog   fila de conexões pendentes de cada socket de escuta (padrão %d)\n"
+        "  -w shards    threads de partidas, uma por núcleo (padrão %d, máx %d)\n"
+        "  -r segundos  intervalo do relatório do lobby por shard (0 desliga)\n"
+        "  -M modo      registra um modo NOME:LxA:TIPO=TAMxQTD[,...] (até %d x %d)\n"
+        "  -m nome      modo usado quando o JOIN não indica um (padrão CLASSICO)\n"
+        "  -L diretório um log por partida (partida_<id>.txt) em vez de game_log.txt\n"
+        "  -G arquivo   log binário indexado por partida e turno em vez do texto (ver battlelog)\n"
+        "  -F ms        intervalo de gravação do log em disco (padrão %d)\n"
+        "  -b segundos  espera no lobby até jogar contra o bot (0 desliga, padrão)\n"
+        "  -A socket    socket Unix de administração que responde STATS [JSON]\n"
+        "  -S arquivo   snapshot das partidas em andamento, retomadas ao reiniciar\n"
+        "  -s fatias    partidas que cabem no snapshot (padrão %d, máx %d); as que passam\n"
+        "               jogam fora dele\n"
+        "  -H socket    assume os sockets de escuta do servidor com este socket de\n"
+        "               administração, que termina as partidas dele e sai\n"
+        "  -R taxa[:rajada] comandos por segundo por conexão, com rajadas de até rajada\n"
+        "               (padrão %d:%d); quem passa espera, e quem acumula erros cai (0 desliga)\n"
+        "  -I conexões  por endereço de origem: abertas ao mesmo tempo e novas por segundo\n"
+        "               (0 desliga, padrão)\n"
+        "  -T jogada[:posicionamento] segundos para cada jogada e para posicionar a frota;\n"
+        "               quem estoura perde por W.O. (padrão %d:%d, 0 desliga)\n"
+        "  -W ocioso[:fila] segundos até o JOIN numa conexão nova e de espera por um\n"
+        "               adversário na fila (padrão %d:%d, 0 desliga)\n",
+        prog, SERVER_PORT, DEFAULT_ACCEPTORS, MAX_ACCEPTORS, DEFAULT_BACKLOG, DEFAULT_SHARDS, MAX_SHARDS, MAX_BOARD_DIM, MAX_BOARD_DIM,
+        LOG_FLUSH_MS, SNAP_SLOTS, SNAP_MAX_SLOTS, DEFAULT_CMD_RATE, DEFAULT_CMD_BURST, DEFAULT_TURN_SECS, DEFAULT_PLACE_SECS,
+        DEFAULT_IDLE_SECS, DEFAULT_QUEUE_SECS);
+}
+
+static bool add_mode(const char *spec) {
+    if (mode_count == MAX_MODES) return false;
+    GameMode mode;
+    if (!parse_game_mode(spec, &mode)) return false;
+    int existing = find_mode(mode.name);
+    modes[existing == -1 ? mode_count++ : existing] = mode;
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    int port = SERVER_PORT;
+    int report_secs = 0;
+    const char *default_name = NULL;
+    GameLogConfig log_cfg = { .dir = NULL, .flush_ms = LOG_FLUSH_MS };
+    int bot_secs = 0;
+    const char *admin_path = NULL;
+    const char *snap_path  = NULL;
+    int snap_slots = SNAP_SLOTS;
+    const char *handoff_path = NULL;
+    int backlog = DEFAULT_BACKLOG;
+    int cmd_rate = DEFAULT_CMD_RATE, cmd_burst = DEFAULT_CMD_BURST;
+    int ip_max = 0;
+    int turn_secs = DEFAULT_TURN_SECS, place_secs = DEFAULT_PLACE_SECS;
+    int idle_secs = DEFAULT_IDLE_SECS, queue_secs = DEFAULT_QUEUE_SECS;
+    int opt;
+
+    modes[mode_count++] = *classic_game_mode();
+    add_mode(EVENT_MODE_SPEC);
+    while ((opt = getopt(argc, argv, "p:a:B:w:r:M:m:L:G:F:b:A:S:s:H:R:I:T:W:h")) != -1) {
+        switch (opt) {
+        case 'p': port = atoi(optarg); break;
+        case 'a': acceptor_count = atoi(optarg); break;
+        case 'B': backlog = atoi(optarg); break;
+        case 'w': shard_count = atoi(optarg); break;
+        case 'r': report_secs = atoi(optarg); break;
+        case 'm': default_name = optarg; break;
+        case 'L': log_cfg.dir = optarg; break;
+        case 'G': log_cfg.binary = optarg; break;
+        case 'F': log_cfg.flush_ms = atoi(optarg); break;
+        case 'b': bot_secs = atoi(optarg); break;
+        case 'A': admin_path = optarg; break;
+        case 'S': snap_path = optarg; break;
+        case 's': snap_slots = atoi(optarg); break;
+        case 'H': handoff_path = optarg; break;
+        case 'R':
+            if (sscanf(optarg, "%d:%d", &cmd_rate, &cmd_burst) < 1) cmd_rate = -1;
+            break;
+        case 'I': ip_max = atoi(optarg); break;
+        case 'T':
+            if (sscanf(optarg, "%d:%d", &turn_secs, &place_secs) < 1) turn_secs = -1;
+            break;
+        case 'W':
+            if (sscanf(optarg, "%d:%d", &idle_secs, &queue_secs) < 1) idle_secs = -1;
+            break;
+        case 'M':
+            if (!add_mode(optarg)) {
+                fprintf(stderr, "Modo inválido: %s\n", optarg);
+                return 1;
+            }
+            break;
+        default:  usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (default_name && (default_mode = find_mode(default_name)) == -1) {
+        fprintf(stderr, "Modo desconhecido: %s\n", default_name);
+        return 1;
+    }
+    if (port <= 0 || port > 65535 || report_secs < 0 || log_cfg.flush_ms <= 0 || bot_secs < 0 ||
+        shard_count < 1 || shard_count > MAX_SHARDS ||
+        acceptor_count < 1 || acceptor_count > MAX_ACCEPTORS || backlog < 1 ||
+        (log_cfg.dir && log_cfg.binary) || cmd_rate < 0 || cmd_burst < 1 || ip_max < 0 ||
+        snap_slots < 1 || snap_slots > SNAP_MAX_SLOTS ||
+        turn_secs < 0 || place_secs < 0 || idle_secs < 0 || queue_secs < 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    bot_wait_us = (uint64_t)bot_secs * 1000000u;
+    turn_us     = (uint64_t)turn_secs * 1000000u;
+    place_us    = (uint64_t)place_secs * 1000000u;
+    idle_us     = (uint64_t)idle_secs * 1000000u;
+    queue_us    = (uint64_t)queue_secs * 1000000u;
+    rate_limit_init(&cmd_limit, cmd_rate, cmd_burst);
+    rate_limit_init(&err_limit, cmd_rate ? ERROR_RATE : 0, ERROR_BURST);
+    if (!iplimit_init(ip_max)) exit(1);
+
+    // um cliente que some não pode derrubar o servidor inteiro
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction sa = { .sa_handler = handle_stop };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT,  &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // com -H os sockets vêm do servidor em execução; os que faltarem são abertos na mesma porta
+    int got = 0;
+    if (handoff_path) {
+        int fds[MAX_ACCEPTORS];
+        if ((got = handoff_receive(handoff_path, fds, &match_seq)) == -1) exit(1);
+        struct sockaddr_in addr;
+        socklen_t addrlen = sizeof(addr);
+        if (getsockname(fds[0], (struct sockaddr *)&addr, &addrlen) == 0) port = ntohs(addr.sin_port);
+        if (got > acceptor_count) acceptor_count = got;
+        for (int i = 0; i < got; i++) {
+            acceptors[i].fd = fds[i];
+            listen(fds[i], backlog);  // só ajusta o backlog
+        }
+        printf("[SERVER] %d socket(s) de escuta recebidos de %s\n", got, handoff_path);
+    }
+    for (int i = got; i < acceptor_count; i++) {
+        if ((acceptors[i].fd = open_listener(port, backlog)) == -1) exit(1);
+    }
+
+    // os logs de texto são sempre continuados; com snapshot ou HANDOFF os ids também, e
+    // o log de uma partida retomada segue de onde parou
+    if (snap_path && !snapshot_open(snap_path, modes, mode_count, snap_slots)) exit(1);
+    for (int i = 0; i < mode_count; i++) {
+        slab_init(&match_pools[i], MATCH_HEAD + (snap_path ? 0 : game_storage_size(&modes[i])));
+    }
+    log_cfg.same_ids = (snap_path != NULL || handoff_path != NULL);
+    if (!gamelog_start(&log_cfg)) exit(1);
+
+    lobby_epfd    = epoll_create1(0);
+    lobby_wakefd  = eventfd(0, EFD_NONBLOCK);
+    accept_stopfd = eventfd(0, EFD_NONBLOCK);
+    if (lobby_epfd == -1 || lobby_wakefd == -1 || accept_stopfd == -1) {
+        perror("epoll/eventfd"); exit(1);
+    }
+    mpsc_init(&lobby_inbox);
+    timer_wheel_init(&lobby_timers, now_us());
+    metrics_enable();
+    if (admin_path && !admin_listen(admin_path)) exit(1);
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1) ncpu = 1;
+    for (int i = 0; i < shard_count; i++) {
+        shard_start(&shards[i], i, (int)ncpu);
+    }
+
+    printf("[SERVER] Servidor Batalha Naval iniciado na porta %d (%d shards, %d aceitadores)\n",
+           port, shard_count, acceptor_count);
+    // no HANDOFF as partidas do snapshot continuam no processo antigo
+    if (!handoff_path) lobby_restore();
+    acceptors_start();
+    printf("[SERVER] Aguardando jogadores...\n");
+
+    lobby_loop(report_secs);
+    stop_server = 1;  // o lobby também sai quando termina de esvaziar depois do HANDOFF
+    acceptors_stop();
+
+    for (int i = 0; i < shard_count; i++) {
+        pthread_join(shards[i].tid, NULL);
+        close(shards[i].wakefd);
+        close(shards[i].epfd);
+    }
+    report_shards();
+    report_metrics();
+    close(lobby_epfd);
+    close(lobby_wakefd);
+    close(accept_stopfd);
+    for (int i = 0; i < acceptor_count; i++) {
+        if (acceptors[i].fd != -1) close(acceptors[i].fd);
+    }
+    if (adminfd != -1) {
+        // depois de um HANDOFF o caminho pode já ser do processo novo
+        struct stat st;
+        close(adminfd);
+        if (stat(admin_path, &st) == 0 && st.st_ino == admin_ino) unlink(admin_path);
+    }
+    gamelog_stop();
+    snapshot_close();
+    for (int i = 0; i < mode_count; i++) slab_destroy(&match_pools[i]);
     printf("[SERVER] Servidor finalizado.\n");
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,867 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "binlog.h"
+#include "../common/protocol.h"
+
+#define BLOG_MAGIC        0x474F4C42u   // "BLOG"
+#define BLOG_TRAILER      0x52544C42u   // "BLTR"
+#define BLOG_CHECKPOINT   0x50434C42u   // "BLCP"
+#define BLOG_VERSION      5             // 2: turnos de 32 bits (EVENTO passa de 65535);
+                                        // 3: execução do servidor no índice;
+                                        // 4: checkpoints do índice; 5: little-endian
+#define BLOG_CHECKPOINT_SEGS 64         // segmentos entre dois checkpoints
+#define BLOG_HEADER       64            // bytes de cada estrutura no arquivo
+#define BLOG_RECORD       24
+#define BLOG_ENTRY        32
+#define BLOG_TRAILER_SIZE 40
+#define BLOG_ALIGN        8             // tudo no arquivo tem tamanho múltiplo disto
+#define BLOG_RUN_MS       5000          // idade máxima de um trecho pendente
+#define BLOG_RUN_RECORDS  4096          // registros máximos de um trecho
+#define MATCH_BUCKETS     1024
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version, record_size, entry_size;
+    uint32_t runs;           // execuções que já abriram o arquivo
+} BinlogHeader;
+
+// Fim de um segmento; o índice fica logo antes dele. A cada BLOG_CHECKPOINT_SEGS
+// segmentos vem um checkpoint: um rodapé sem registros cujo índice junta os índices dos
+// segmentos desde o checkpoint anterior. O leitor vai de checkpoint em checkpoint e só
+// lê um a um os segmentos depois do último.
+typedef struct {
+    uint32_t magic;          // BLOG_TRAILER ou BLOG_CHECKPOINT
+    uint32_t count;          // entradas do índice
+    uint64_t index_offset;
+    uint64_t prev;           // rodapé anterior (segmento ou checkpoint); 0 no primeiro
+    uint64_t checkpoint;     // último checkpoint antes deste rodapé; 0 se nenhum
+    uint32_t since;          // segmentos depois desse checkpoint, contando este (0 no checkpoint)
+    uint32_t checksum;       // do índice e dos campos acima
+} BinlogTrailer;
+
+_Static_assert(BLOG_RECORD % BLOG_ALIGN == 0 && BLOG_ENTRY % BLOG_ALIGN == 0 &&
+               BLOG_TRAILER_SIZE % BLOG_ALIGN == 0, "estruturas desalinham os rodapés");
+
+// Registros pendentes de uma partida (só a escritora mexe)
+typedef struct BinMatch {
+    uint32_t      id;
+    uint32_t      run;
+    uint32_t      turn;
+    uint32_t      first_turn;    // turno no começo do trecho pendente
+    uint8_t       flags;         // BLOG_RUN_RESULT visto no trecho
+    uint8_t       winner;
+    bool          ended;
+    BinlogNames   names;
+    BinlogRecord *recs;
+    uint32_t      count, cap;
+    uint64_t      started;       // ms do primeiro registro pendente
+    struct BinMatch *next;
+} BinMatch;
+
+static int       log_fd = -1;
+static uint32_t  log_run;        // execução deste processo (BinlogHeader.runs ao abrir)
+static BinMatch *buckets[MATCH_BUCKETS];
+
+// Índice do arquivo para as retomadas, lido uma vez enquanto o arquivo não cresce (as
+// retomadas chegam juntas, na restauração do snapshot ou num HANDOFF). As entradas de
+// cada partida ficam encadeadas da mais nova para a mais antiga.
+static struct {
+    BinlogEntry *entries;
+    long         count;
+    long        *older;      // entrada anterior da mesma partida; -1 se não há
+    long        *newest;     // tabela por match_id: entrada mais nova; -1 se vazia
+    size_t       mask;
+    uint64_t     size;       // tamanho do arquivo quando foi lido
+} resume_index;
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + ts.tv_nsec / 1000000;
+}
+
+static uint32_t fnv1a(uint32_t h, const void *data, size_t len) {
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+// ---------------------------------------------------------------------------
+// Estruturas no arquivo: campos em posições fixas, inteiros em little-endian
+// ---------------------------------------------------------------------------
+
+static void put16(unsigned char *p, uint16_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void put32(unsigned char *p, uint32_t v) {
+    put16(p, (uint16_t)v);
+    put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static void put64(unsigned char *p, uint64_t v) {
+    put32(p, (uint32_t)v);
+    put32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint16_t get16(const unsigned char *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t get32(const unsigned char *p) {
+    return get16(p) | (uint32_t)get16(p + 2) << 16;
+}
+
+static uint64_t get64(const unsigned char *p) {
+    return get32(p) | (uint64_t)get32(p + 4) << 32;
+}
+
+static void header_encode(unsigned char *p, const BinlogHeader *h) {
+    memset(p, 0, BLOG_HEADER);
+    put32(p, h->magic);
+    put16(p + 4, h->version);
+    put16(p + 6, h->record_size);
+    put16(p + 8, h->entry_size);
+    put32(p + 12, h->runs);
+}
+
+static void header_decode(const unsigned char *p, BinlogHeader *h) {
+    *h = (BinlogHeader){ .magic = get32(p), .version = get16(p + 4), .record_size = get16(p + 6),
+                         .entry_size = get16(p + 8), .runs = get32(p + 12) };
+}
+
+static void record_encode(unsigned char *p, const BinlogRecord *r) {
+    put32(p, r->turn);
+    p[4] = r->type;
+    p[5] = r->player;
+    put16(p + 6, r->x);
+    put16(p + 8, r->y);
+    p[10] = r->result;
+    p[11] = r->len;
+    memcpy(p + 12, r->text, BINLOG_TEXT);
+}
+
+static void record_decode(const unsigned char *p, BinlogRecord *r) {
+    *r = (BinlogRecord){ .turn = get32(p), .type = p[4], .player = p[5], .x = get16(p + 6),
+                         .y = get16(p + 8), .result = p[10], .len = p[11] };
+    memcpy(r->text, p + 12, BINLOG_TEXT);
+}
+
+static void entry_encode(unsigned char *p, const BinlogEntry *e) {
+    put32(p, e->match_id);
+    put32(p + 4, e->count);
+    put64(p + 8, e->offset);
+    put32(p + 16, e->first_turn);
+    put32(p + 20, e->last_turn);
+    put32(p + 24, e->run);
+    p[28] = e->flags;
+    p[29] = e->winner;
+    p[30] = p[31] = 0;
+}
+
+static void entry_decode(const unsigned char *p, BinlogEntry *e) {
+    *e = (BinlogEntry){ .match_id = get32(p), .count = get32(p + 4), .offset = get64(p + 8),
+                        .first_turn = get32(p + 16), .last_turn = get32(p + 20),
+                        .run = get32(p + 24), .flags = p[28], .winner = p[29] };
+}
+
+static void trailer_decode(const unsigned char *p, BinlogTrailer *t) {
+    *t = (BinlogTrailer){ .magic = get32(p), .count = get32(p + 4), .index_offset = get64(p + 8),
+                          .prev = get64(p + 16), .checkpoint = get64(p + 24),
+                          .since = get32(p + 32), .checksum = get32(p + 36) };
+}
+
+// Soma do índice (já codificado) e dos campos do rodapé antes da soma
+static uint32_t trailer_checksum(const unsigned char *trailer, const unsigned char *index, uint32_t count) {
+    uint32_t h = fnv1a(2166136261u, index, (size_t)count * BLOG_ENTRY);
+    return fnv1a(h, trailer, 36);
+}
+
+// Codifica t em p, logo depois do índice dele, e preenche a soma
+static void trailer_seal(unsigned char *p, BinlogTrailer *t, const unsigned char *index) {
+    put32(p, t->magic);
+    put32(p + 4, t->count);
+    put64(p + 8, t->index_offset);
+    put64(p + 16, t->prev);
+    put64(p + 24, t->checkpoint);
+    put32(p + 32, t->since);
+    t->checksum = trailer_checksum(p, index, t->count);
+    put32(p + 36, t->checksum);
+}
+
+static const char *player_name(const BinlogNames *names, int player) {
+    return player >= 1 && player <= MAX_CLIENTS ? names->names[player - 1] : "?";
+}
+
+// Tipo do registro de cada evento compacto
+static const uint8_t record_types[] = {
+    [LOG_CMD] = BLOG_CMD, [LOG_POS] = BLOG_POS, [LOG_FIRE] = BLOG_FIRE, [LOG_TURN] = BLOG_TURN,
+    [LOG_READY] = BLOG_READY, [LOG_SHOT] = BLOG_SHOT, [LOG_RESULT] = BLOG_RESULT,
+    [LOG_FIXED] = BLOG_FIXED,
+};
+
+// Evento de um registro compacto (text, arg e os nomes apontam para payload e names)
+static void record_event(const BinlogRecord *r, const char *payload, size_t plen,
+                         const BinlogNames *names, LogEvent *ev)
+{
+    *ev = (LogEvent){ .type = LOG_TEXT, .player = r->player, .x = r->x, .y = r->y,
+                      .result = r->result, .name = player_name(names, r->player) };
+    for (int t = 0; t < (int)sizeof(record_types); t++) {
+        if (record_types[t] == r->type && t != LOG_TEXT) ev->type = t;
+    }
+    if (ev->type == LOG_RESULT) ev->other = player_name(names, r->player == 1 ? 2 : 1);
+    if (ev->type == LOG_POS) {
+        ev->arg     = payload;
+        ev->arg_len = plen;
+    } else if (ev->type == LOG_CMD || ev->type == LOG_TEXT) {
+        ev->text = payload;
+        ev->len  = plen;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Segmentos no disco
+// ---------------------------------------------------------------------------
+
+static bool read_at(int fd, void *buf, size_t len, uint64_t off) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, (off_t)off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p   += n;
+        len -= (size_t)n;
+        off += (uint64_t)n;
+    }
+    return true;
+}
+
+static bool write_at(int fd, const void *buf, size_t len, uint64_t off) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, (off_t)off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return false;
+        p   += n;
+        len -= (size_t)n;
+        off += (uint64_t)n;
+    }
+    return true;
+}
+
+static bool header_read(int fd, BinlogHeader *h) {
+    unsigned char raw[BLOG_HEADER];
+    if (!read_at(fd, raw, sizeof(raw), 0)) return false;
+    header_decode(raw, h);
+    return true;
+}
+
+static bool header_valid(int fd) {
+    BinlogHeader h;
+    return header_read(fd, &h) && h.magic == BLOG_MAGIC && h.version == BLOG_VERSION &&
+           h.record_size == BLOG_RECORD && h.entry_size == BLOG_ENTRY;
+}
+
+// Confere o rodapé em off e o índice dele; index (se não NULL) recebe o índice (malloc)
+static bool trailer_read(int fd, uint64_t off, BinlogTrailer *t, BinlogEntry **index) {
+    unsigned char raw[BLOG_TRAILER_SIZE];
+    if (!read_at(fd, raw, sizeof(raw), off)) return false;
+    trailer_decode(raw, t);
+    if (t->magic != BLOG_TRAILER && t->magic != BLOG_CHECKPOINT) return false;
+    uint64_t bytes = (uint64_t)t->count * BLOG_ENTRY;
+    if (t->index_offset < BLOG_HEADER || t->index_offset + bytes != off ||
+        (t->prev != 0 && (t->prev < BLOG_HEADER || t->prev >= t->index_offset)) ||
+        (t->checkpoint != 0 && (t->checkpoint < BLOG_HEADER || t->checkpoint >= t->index_offset))) {
+        return false;
+    }
+
+    unsigned char *p = malloc(bytes ? bytes : 1);
+    if (!p) return false;
+    bool ok = read_at(fd, p, bytes, t->index_offset) && trailer_checksum(raw, p, t->count) == t->checksum;
+    if (ok && index) {
+        *index = malloc(t->count ? (size_t)t->count * sizeof(**index) : 1);
+        ok = *index != NULL;
+        for (uint32_t i = 0; ok && i < t->count; i++) entry_decode(p + (size_t)i * BLOG_ENTRY, &(*index)[i]);
+    }
+    free(p);
+    return ok;
+}
+
+// Último rodapé íntegro antes de size (0 se nenhum): o que vem depois é um segmento
+// que não terminou de ser gravado
+static uint64_t find_tail(int fd, uint64_t size) {
+    BinlogTrailer t;
+    if (size < BLOG_HEADER + BLOG_TRAILER_SIZE) return 0;
+    uint64_t off = (size - BLOG_TRAILER_SIZE) / BLOG_ALIGN * BLOG_ALIGN;
+    for (; off >= BLOG_HEADER; off -= BLOG_ALIGN) {
+        if (trailer_read(fd, off, &t, NULL)) return off;
+    }
+    return 0;
+}
+
+long binlog_read_index(int fd, BinlogEntry **entries) {
+    *entries = NULL;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !header_valid(fd)) return -1;
+
+    // do mais novo para o mais antigo: os segmentos depois do último checkpoint pelos
+    // rodapés, e dali em diante só os checkpoints, que já juntam os índices de antes
+    struct { BinlogEntry *index; uint32_t count; } *pieces = NULL;
+    size_t n = 0, cap = 0;
+    long total = 0;
+    bool ok = true;
+    BinlogTrailer t;
+    for (uint64_t off = find_tail(fd, (uint64_t)st.st_size); off != 0;
+         off = t.magic == BLOG_CHECKPOINT ? t.checkpoint : t.prev) {
+        BinlogEntry *index;
+        if (!trailer_read(fd, off, &t, &index)) break;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 64;
+            void *p = realloc(pieces, cap * sizeof(*pieces));
+            if (!p) {
+                free(index);
+                ok = false;
+                break;
+            }
+            pieces = p;
+        }
+        pieces[n].index   = index;
+        pieces[n++].count = t.count;
+        total += t.count;
+    }
+
+    if (ok) *entries = malloc((total > 0 ? (size_t)total : 1) * sizeof(**entries));
+    long at = 0;
+    for (size_t i = n; i-- > 0; ) {
+        if (*entries) memcpy(*entries + at, pieces[i].index, (size_t)pieces[i].count * sizeof(BinlogEntry));
+        at += pieces[i].count;
+        free(pieces[i].index);
+    }
+    free(pieces);
+    return *entries ? total : -1;
+}
+
+long binlog_read_run(int fd, const BinlogEntry *e, BinlogRecord **records) {
+    size_t bytes = (size_t)e->count * BLOG_RECORD;
+    unsigned char *raw = malloc(bytes ? bytes : 1);
+    *records = malloc(e->count ? (size_t)e->count * sizeof(BinlogRecord) : 1);
+    if (!raw || !*records || !read_at(fd, raw, bytes, e->offset)) {
+        free(raw);
+        free(*records);
+        *records = NULL;
+        return -1;
+    }
+    for (uint32_t i = 0; i < e->count; i++) record_decode(raw + (size_t)i * BLOG_RECORD, &(*records)[i]);
+    free(raw);
+    return e->count;
+}
+
+int binlog_format(const BinlogRecord *r, int avail, BinlogNames *names,
+                  char *out, size_t size)
+{
+    char payload[MAX_MSG];
+    size_t plen = 0;
+    int used = 0;
+    do {
+        size_t n = r[used].len <= BINLOG_TEXT ? r[used].len : BINLOG_TEXT;
+        if (plen + n > sizeof(payload)) n = sizeof(payload) - plen;
+        memcpy(payload + plen, r[used].text, n);
+        plen += n;
+        used++;
+    } while (used < avail && r[used].type == BLOG_MORE);
+
+    if (r->type == BLOG_NAME) {
+        if (r->player >= 1 && r->player <= MAX_CLIENTS) {
+            if (plen >= MAX_NAME_LEN) plen = MAX_NAME_LEN - 1;
+            memcpy(names->names[r->player - 1], payload, plen);
+            names->names[r->player - 1][plen] = '\0';
+        }
+        if (size) out[0] = '\0';
+        return used;
+    }
+    if (r->type == BLOG_MORE || r->type > BLOG_FIXED) {
+        if (size) out[0] = '\0';
+        return used;
+    }
+    LogEvent ev;
+    record_event(r, payload, plen, names, &ev);
+    gamelog_format(&ev, out, size);
+    return used;
+}
+
+// ---------------------------------------------------------------------------
+// Escritora
+// ---------------------------------------------------------------------------
+
+static BinMatch **match_slot(uint32_t id) {
+    BinMatch **pp = &buckets[id % MATCH_BUCKETS];
+    while (*pp && (*pp)->id != id) pp = &(*pp)->next;
+    return pp;
+}
+
+static BinMatch *match_get(uint32_t id) {
+    BinMatch **pp = match_slot(id);
+    if (!*pp && (*pp = calloc(1, sizeof(**pp))) != NULL) {
+        (*pp)->id  = id;
+        (*pp)->run = log_run;
+    }
+    return *pp;
+}
+
+static void match_free(BinMatch *m) {
+    BinMatch **pp = match_slot(m->id);
+    *pp = m->next;
+    free(m->recs);
+    free(m);
+}
+
+// Acrescenta o evento ao trecho pendente; o texto que não cabe segue em BLOG_MORE
+static void push(BinMatch *m, const BinlogRecord *ev, const char *payload, size_t plen) {
+    int type = ev->type;
+    do {
+        if (m->count == m->cap) {
+            uint32_t cap = m->cap ? m->cap * 2 : 64;
+            BinlogRecord *recs = realloc(m->recs, cap * sizeof(*recs));
+            if (!recs) return;
+            m->recs = recs;
+            m->cap  = cap;
+        }
+        BinlogRecord *r = &m->recs[m->count++];
+        *r = (BinlogRecord){ .turn = m->turn, .type = (uint8_t)type };
+        if (type != BLOG_MORE) {
+            r->player = ev->player;
+            r->x      = ev->x;
+            r->y      = ev->y;
+            r->result = ev->result;
+        }
+        size_t n = plen > BINLOG_TEXT ? BINLOG_TEXT : plen;
+        memcpy(r->text, payload, n);
+        r->len = (uint8_t)n;
+        payload += n;
+        plen    -= n;
+        type = BLOG_MORE;
+    } while (plen > 0);
+}
+
+static void push_name(BinMatch *m, int player) {
+    BinlogRecord ev = { .type = BLOG_NAME, .player = (uint8_t)player };
+    const char *name = m->names.names[player - 1];
+    push(m, &ev, name, strlen(name));
+}
+
+// Cada trecho começa com os nomes conhecidos: ele se formata sozinho, sem os anteriores
+static void run_begin(BinMatch *m) {
+    m->started    = now_ms();
+    m->first_turn = m->turn;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (m->names.names[i][0]) push_name(m, i + 1);
+    }
+}
+
+// Nome conhecido do player; um nome novo entra no trecho antes do evento que o usa
+static void learn_name(BinMatch *m, int player, const char *name) {
+    char *known = m->names.names[player - 1];
+    if (!name || strncmp(known, name, MAX_NAME_LEN - 1) == 0) return;
+    snprintf(known, MAX_NAME_LEN, "%s", name);
+    push_name(m, player);
+}
+
+// O evento cabe num registro compacto que refaz o texto de sempre?
+static bool compact_event(const LogEvent *ev) {
+    if (ev->type <= LOG_TEXT || ev->type > LOG_FIXED) return false;
+    if (ev->type == LOG_FIXED) return ev->x >= 0 && ev->x < LOG_FIX_COUNT;
+    if (ev->player < 1 || ev->player > MAX_CLIENTS) return false;
+    if (ev->type == LOG_FIRE || ev->type == LOG_POS || ev->type == LOG_SHOT) {
+        if (ev->x < 0 || ev->x > UINT16_MAX || ev->y < 0 || ev->y > UINT16_MAX ||
+            ev->result < 0 || ev->result > UINT8_MAX) return false;
+    }
+    if (ev->type != LOG_FIRE && ev->type != LOG_POS) return true;
+
+    // FIRE e POS guardam a forma canônica: só se o comando chegou exatamente assim
+    char sent[2 * MAX_MSG], canonical[2 * MAX_MSG];
+    LogEvent c = *ev;
+    c.text = NULL;
+    int n = gamelog_format(ev, sent, sizeof(sent));
+    return n >= 0 && (size_t)n < sizeof(sent) &&
+           gamelog_format(&c, canonical, sizeof(canonical)) == n && memcmp(sent, canonical, (size_t)n) == 0;
+}
+
+void binlog_event(uint32_t match_id, const LogEvent *ev) {
+    BinMatch *m = match_get(match_id);
+    if (!m) return;
+    if (m->count == 0) run_begin(m);
+
+    if (!compact_event(ev)) {
+        // o comando como chegou; os demais, pelo texto
+        bool cmd = (ev->type == LOG_POS || ev->type == LOG_FIRE) &&
+                   ev->player >= 1 && ev->player <= MAX_CLIENTS;
+        BinlogRecord rec = { .type = cmd ? BLOG_CMD : BLOG_TEXT, .player = cmd ? (uint8_t)ev->player : 0 };
+        char buf[2 * MAX_MSG];
+        const char *text = ev->text ? ev->text : "";
+        size_t len = ev->text ? ev->len : 0;
+        if (!cmd && ev->type != LOG_TEXT) {
+            int n = gamelog_format(ev, buf, sizeof(buf));
+            if (n < 0) return;
+            text = buf;
+            len  = (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1;
+        }
+        push(m, &rec, text, len);
+        return;
+    }
+
+    BinlogRecord rec = {
+        .type   = record_types[ev->type],
+        .player = (uint8_t)ev->player,
+        .x      = (uint16_t)ev->x,
+        .y      = (uint16_t)ev->y,
+        .result = (uint8_t)ev->result,
+    };
+    const char *payload = NULL;
+    size_t plen = 0;
+    switch (ev->type) {
+    case LOG_CMD:
+        payload = ev->text;
+        plen    = ev->len;
+        break;
+    case LOG_POS:
+        payload = ev->arg;
+        plen    = ev->arg_len;
+        break;
+    case LOG_TURN:
+        m->turn++;
+        learn_name(m, ev->player, ev->name);
+        break;
+    case LOG_READY:
+    case LOG_SHOT:
+        learn_name(m, ev->player, ev->name);
+        break;
+    case LOG_RESULT:
+        learn_name(m, ev->player, ev->name);
+        learn_name(m, ev->player == 1 ? 2 : 1, ev->other);
+        m->flags |= BLOG_RUN_RESULT;
+        m->winner = (uint8_t)ev->player;
+        break;
+    }
+    push(m, &rec, payload, plen);
+}
+
+static bool has_run(const uint32_t *runs, size_t n, uint32_t run) {
+    for (size_t i = 0; i < n; i++) {
+        if (runs[i] == run) return true;
+    }
+    return false;
+}
+
+static void resume_index_free(void) {
+    free(resume_index.entries);
+    free(resume_index.older);
+    free(resume_index.newest);
+    resume_index.entries = NULL;
+    resume_index.older   = resume_index.newest = NULL;
+}
+
+// Lê o índice do arquivo se ele cresceu desde a última leitura; -1 em erro
+static long resume_index_load(void) {
+    struct stat st;
+    if (fstat(log_fd, &st) == -1) return -1;
+    if (resume_index.entries && resume_index.size == (uint64_t)st.st_size) return resume_index.count;
+
+    resume_index_free();
+    long n = binlog_read_index(log_fd, &resume_index.entries);
+    if (n < 0) return -1;
+    size_t slots = 16;
+    while (slots < 2 * (size_t)n) slots *= 2;
+    resume_index.older  = malloc((n > 0 ? (size_t)n : 1) * sizeof(long));
+    resume_index.newest = malloc(slots * sizeof(long));
+    if (!resume_index.older || !resume_index.newest) {
+        resume_index_free();
+        return -1;
+    }
+    resume_index.mask = slots - 1;
+    resume_index.size = (uint64_t)st.st_size;
+    for (size_t i = 0; i < slots; i++) resume_index.newest[i] = -1;
+    for (long i = 0; i < n; i++) {
+        uint32_t id = resume_index.entries[i].match_id;
+        size_t h = (id * 2654435761u) & resume_index.mask;
+        while (resume_index.newest[h] != -1 && resume_index.entries[resume_index.newest[h]].match_id != id) {
+            h = (h + 1) & resume_index.mask;
+        }
+        resume_index.older[i]  = resume_index.newest[h];
+        resume_index.newest[h] = i;
+    }
+    resume_index.count = n;
+    return n;
+}
+
+// Entrada mais nova de match_id no índice das retomadas; -1 se não há
+static long resume_newest(uint32_t id) {
+    size_t h = (id * 2654435761u) & resume_index.mask;
+    for (; resume_index.newest[h] != -1; h = (h + 1) & resume_index.mask) {
+        if (resume_index.entries[resume_index.newest[h]].match_id == id) return resume_index.newest[h];
+    }
+    return -1;
+}
+
+void binlog_resume(uint32_t match_id) {
+    BinMatch *m = match_get(match_id);
+    if (!m || resume_index_load() < 0) return;
+    const BinlogEntry *entries = resume_index.entries;
+    long first = resume_newest(m->id);
+
+    // execuções em que uma partida com esse id já terminou: não é a que volta agora
+    uint32_t *ended = NULL;
+    size_t ended_n = 0, ended_cap = 0;
+    for (long i = first; i != -1; i = resume_index.older[i]) {
+        if (!(entries[i].flags & BLOG_RUN_END)) continue;
+        if (ended_n == ended_cap) {
+            ended_cap = ended_cap ? ended_cap * 2 : 8;
+            uint32_t *p = realloc(ended, ended_cap * sizeof(*p));
+            if (!p) {
+                free(ended);
+                return;
+            }
+            ended = p;
+        }
+        ended[ended_n++] = entries[i].run;
+    }
+
+    // execução, turno e nomes do último trecho da partida gravado antes
+    for (long i = first; i != -1; i = resume_index.older[i]) {
+        if (has_run(ended, ended_n, entries[i].run)) continue;
+        m->run  = entries[i].run;
+        m->turn = entries[i].last_turn;
+        BinlogRecord *recs;
+        long count = binlog_read_run(log_fd, &entries[i], &recs);
+        char out[MAX_MSG];
+        for (long j = 0; j < count; ) {
+            j += binlog_format(&recs[j], (int)(count - j), &m->names, out, sizeof(out));
+        }
+        if (count >= 0) free(recs);
+        break;
+    }
+    free(ended);
+}
+
+void binlog_end(uint32_t match_id) {
+    BinMatch *m = *match_slot(match_id);
+    if (m) m->ended = true;
+}
+
+// Grava em off, logo depois do segmento de rodapé t e índice index, um checkpoint com os
+// índices dos t->since segmentos desde o checkpoint anterior
+static void write_checkpoint(uint64_t off, const BinlogTrailer *t, const BinlogEntry *index) {
+    size_t segs = t->since;
+    BinlogEntry **indexes = calloc(segs, sizeof(*indexes));
+    uint32_t *counts = calloc(segs, sizeof(*counts));
+    size_t total = t->count, got = 1;
+    bool ok = indexes && counts;
+    if (ok) {
+        indexes[segs - 1] = (BinlogEntry *)index;
+        counts[segs - 1]  = t->count;
+    }
+    BinlogTrailer s = *t;
+    for (; ok && got < segs; got++) {
+        size_t i = segs - 1 - got;
+        ok = trailer_read(log_fd, s.prev, &s, &indexes[i]) && s.magic == BLOG_TRAILER;
+        if (ok) {
+            counts[i] = s.count;
+            total    += s.count;
+        } else {
+            indexes[i] = NULL;
+        }
+    }
+
+    size_t size = total * BLOG_ENTRY + BLOG_TRAILER_SIZE;
+    unsigned char *buf = ok ? malloc(size) : NULL;
+    if (buf) {
+        size_t at = 0;
+        for (size_t i = 0; i < segs; i++) {
+            for (uint32_t j = 0; j < counts[i]; j++, at += BLOG_ENTRY) entry_encode(buf + at, &indexes[i][j]);
+        }
+        BinlogTrailer cp = {
+            .magic        = BLOG_CHECKPOINT,
+            .count        = (uint32_t)total,
+            .index_offset = off,
+            .prev         = off - BLOG_TRAILER_SIZE,
+            .checkpoint   = t->checkpoint,
+        };
+        trailer_seal(buf + at, &cp, buf);
+        // sem o checkpoint o arquivo continua válido: o próximo segmento tenta de novo
+        if (!write_at(log_fd, buf, size, off)) {
+            perror("log binário");
+            if (ftruncate(log_fd, (off_t)off) == -1) perror("ftruncate");
+        }
+    }
+    for (size_t i = 0; indexes && i + 1 < segs; i++) free(indexes[i]);
+    free(indexes);
+    free(counts);
+    free(buf);
+}
+
+void binlog_flush(bool all) {
+    if (log_fd == -1) return;
+
+    uint64_t now = now_ms();
+    BinMatch **ready = NULL;
+    size_t n = 0, cap = 0, records = 0;
+    for (int b = 0; b < MATCH_BUCKETS; b++) {
+        for (BinMatch *m = buckets[b]; m; m = m->next) {
+            if (m->count == 0 && !m->ended) continue;
+            if (!all && !m->ended && m->count < BLOG_RUN_RECORDS && now - m->started < BLOG_RUN_MS) {
+                continue;
+            }
+            if (n == cap) {
+                cap = cap ? cap * 2 : 64;
+                BinMatch **p = realloc(ready, cap * sizeof(*p));
+                if (!p) break;
+                ready = p;
+            }
+            ready[n++] = m;
+            records += m->count;
+        }
+    }
+    if (n == 0) {
+        free(ready);
+        return;
+    }
+
+    // registros, índice e rodapé numa gravação só
+    size_t rec_bytes = records * BLOG_RECORD;
+    size_t size = rec_bytes + n * BLOG_ENTRY + BLOG_TRAILER_SIZE;
+    unsigned char *buf = malloc(size);
+    BinlogEntry *index = malloc(n * sizeof(*index));
+    if (!buf || !index) {
+        free(buf);
+        free(index);
+        free(ready);
+        return;  // tenta de novo na próxima gravação
+    }
+
+    // o lock separa os segmentos deste processo dos do outro durante um HANDOFF
+    flock(log_fd, LOCK_EX);
+    struct stat st;
+    uint64_t end = fstat(log_fd, &st) == 0 ? (uint64_t)st.st_size : 0;
+    size_t off = 0;
+    for (size_t i = 0; i < n; i++) {
+        BinMatch *m = ready[i];
+        if (m->count == 0) m->first_turn = m->turn;
+        index[i] = (BinlogEntry){
+            .match_id   = m->id,
+            .count      = m->count,
+            .offset     = end + off,
+            .first_turn = m->first_turn,
+            .last_turn  = m->turn,
+            .run        = m->run,
+            .flags      = (uint8_t)(m->flags | (m->ended ? BLOG_RUN_END : 0)),
+            .winner     = m->winner,
+        };
+        entry_encode(buf + rec_bytes + i * BLOG_ENTRY, &index[i]);
+        for (uint32_t j = 0; j < m->count; j++, off += BLOG_RECORD) record_encode(buf + off, &m->recs[j]);
+    }
+    BinlogTrailer t = {
+        .magic        = BLOG_TRAILER,
+        .count        = (uint32_t)n,
+        .index_offset = end + rec_bytes,
+        .prev         = end > BLOG_HEADER ? end - BLOG_TRAILER_SIZE : 0,
+        .since        = 1,
+    };
+    // o rodapé que fecha o arquivo (deste processo ou do outro) diz onde está o último
+    // checkpoint e quantos segmentos vieram depois dele
+    unsigned char raw[BLOG_TRAILER_SIZE];
+    if (t.prev != 0 && read_at(log_fd, raw, sizeof(raw), t.prev)) {
+        BinlogTrailer last;
+        trailer_decode(raw, &last);
+        if (last.magic == BLOG_CHECKPOINT) {
+            t.checkpoint = t.prev;
+        } else if (last.magic == BLOG_TRAILER) {
+            t.checkpoint = last.checkpoint;
+            t.since      = last.since + 1;
+        }
+    }
+    trailer_seal(buf + size - BLOG_TRAILER_SIZE, &t, buf + rec_bytes);
+
+    if (!write_at(log_fd, buf, size, end)) {
+        perror("log binário");
+        if (ftruncate(log_fd, (off_t)end) == -1) perror("ftruncate");
+    } else if (t.since >= BLOG_CHECKPOINT_SEGS) {
+        write_checkpoint(end + size, &t, index);
+    }
+    flock(log_fd, LOCK_UN);
+    free(buf);
+    free(index);
+
+    for (size_t i = 0; i < n; i++) {
+        BinMatch *m = ready[i];
+        if (m->ended) {
+            match_free(m);
+        } else {
+            m->count = 0;
+            m->flags = 0;
+        }
+    }
+    free(ready);
+}
+
+bool binlog_open(const char *path) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        perror(path);
+        return false;
+    }
+    flock(fd, LOCK_EX);
+    struct stat st;
+    BinlogHeader h = { .magic = BLOG_MAGIC, .version = BLOG_VERSION,
+                       .record_size = BLOG_RECORD, .entry_size = BLOG_ENTRY };
+    bool ok = fstat(fd, &st) == 0;
+    if (ok && st.st_size != 0 && !header_valid(fd)) {
+        fprintf(stderr, "[LOG] %s não é um log binário deste formato\n", path);
+        ok = false;
+    } else if (ok && st.st_size != 0) {
+        uint64_t tail = find_tail(fd, (uint64_t)st.st_size);
+        uint64_t keep = tail ? tail + BLOG_TRAILER_SIZE : BLOG_HEADER;
+        if (keep < (uint64_t)st.st_size) {
+            fprintf(stderr, "[LOG] %s: descartando %llu bytes de um segmento incompleto\n",
+                    path, (unsigned long long)((uint64_t)st.st_size - keep));
+            if (ftruncate(fd, (off_t)keep) == -1) perror(path);
+        }
+        ok = header_read(fd, &h);
+    }
+    // cada execução ganha um número novo, gravado antes de qualquer segmento dela
+    if (ok) {
+        unsigned char raw[BLOG_HEADER];
+        h.runs++;
+        header_encode(raw, &h);
+        ok = write_at(fd, raw, sizeof(raw), 0);
+        if (!ok) perror(path);
+    }
+    flock(fd, LOCK_UN);
+    if (!ok) {
+        close(fd);
+        return false;
+    }
+    log_fd  = fd;
+    log_run = h.runs;
+    return true;
+}
+
+void binlog_close(void) {
+    if (log_fd == -1) return;
+    binlog_flush(true);
+    for (int b = 0; b < MATCH_BUCKETS; b++) {
+        while (buckets[b]) match_free(buckets[b]);
+    }
+    resume_index_free();
+    close(log_fd);
+    log_fd = -1;
+}
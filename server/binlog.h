@@ -0,0 +1,103 @@
+#ifndef BINLOG_H
+#define BINLOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "battleship.h"
+#include "gamelog.h"
+
+// Log binário das partidas (-G): em vez do texto livre do game_log.txt, registros de
+// tamanho fixo, agrupados por partida, num arquivo que só cresce.
+//
+// O arquivo tem um cabeçalho e depois segmentos. Cada segmento traz trechos de partidas
+// (registros consecutivos de uma só partida), o índice desses trechos e um rodapé que
+// aponta para o índice e para o rodapé do segmento anterior. A cada 64 segmentos vem um
+// checkpoint, que junta os índices deles e aponta para o checkpoint anterior. O leitor
+// parte do fim do arquivo, segue os rodapés até o último checkpoint e dali salta de
+// checkpoint em checkpoint: acha os trechos de uma partida, e dentro deles os de um
+// turno, sem ler o resto. Um segmento cortado por uma queda é descartado na abertura.
+//
+// Cada evento do log (gamelog.h) vira um registro de 24 bytes. Os frequentes (comandos,
+// turno, pronto, tiro, resultado) ficam só com os campos que o jogo emitiu; o resto
+// guarda o texto, continuado em registros seguintes quando não cabe. binlog_format
+// refaz o texto byte a byte com gamelog_format, e o battlelog converte de volta para o
+// formato do game_log.txt. No arquivo os campos ficam em posições fixas e os inteiros em
+// little-endian, seja qual for a máquina; as structs abaixo são a forma lida em memória.
+
+#define BINLOG_TEXT 12   // bytes de texto num registro
+
+enum {
+    BLOG_TEXT,    // mensagem literal (continua nos BLOG_MORE seguintes)
+    BLOG_MORE,    // continuação do texto do registro anterior
+    BLOG_NAME,    // nome do jogador player (não gera texto)
+    BLOG_CMD,     // "PLAYER n -> <comando>"
+    BLOG_POS,     // "PLAYER n -> POS <tipo> x y <H/V>" (orientação em result)
+    BLOG_FIRE,    // "PLAYER n -> FIRE x y"
+    BLOG_TURN,    // "--- TURNO DO PLAYER n (nome) ---"
+    BLOG_READY,   // "*** PLAYER n (nome) ESTÁ PRONTO! ***"
+    BLOG_SHOT,    // "=== PLAYER n (nome) ATACOU x y: HIT ==="
+    BLOG_RESULT,  // "RESULTADO: ... WINS; ... LOSES" (player é o vencedor)
+    BLOG_FIXED,   // aviso fixo do jogo (x indexa gamelog_fixed)
+};
+
+// A partida de cada registro vem do índice (o trecho é de uma partida só)
+typedef struct {
+    uint32_t turn;           // turnos de tiro já anunciados na partida (0 no posicionamento)
+    uint8_t  type;           // BLOG_*
+    uint8_t  player;         // 1..MAX_CLIENTS, 0 se não se aplica
+    uint16_t x, y;
+    uint8_t  result;         // RESULT_* no BLOG_SHOT, 'H'/'V' no BLOG_POS
+    uint8_t  len;            // bytes usados de text
+    char     text[BINLOG_TEXT];
+} BinlogRecord;
+
+// Entrada do índice: um trecho de registros consecutivos de uma partida. Os ids de
+// partida recomeçam a cada execução do servidor, então uma partida é o par (run, match_id)
+enum { BLOG_RUN_END = 1, BLOG_RUN_RESULT = 2 };
+
+typedef struct {
+    uint32_t match_id;
+    uint32_t count;          // registros
+    uint64_t offset;         // posição do primeiro registro no arquivo
+    uint32_t first_turn, last_turn;
+    uint32_t run;            // execução do servidor que começou a partida (1, 2, ...)
+    uint8_t  flags;          // BLOG_RUN_*
+    uint8_t  winner;         // player_id do vencedor se BLOG_RUN_RESULT
+    uint8_t  pad[2];
+} BinlogEntry;
+
+// Nomes conhecidos de uma partida, para formatar os registros
+typedef struct {
+    char names[MAX_CLIENTS][MAX_NAME_LEN];
+} BinlogNames;
+
+// Escrita (só a thread escritora do gamelog chama)
+
+// Abre path para acréscimos (só um arquivo vazio ganha o cabeçalho; o que já foi gravado
+// nunca é apagado); descarta um segmento incompleto no fim. false em erro de E/S ou se o
+// arquivo for de outro formato.
+bool binlog_open(const char *path);
+void binlog_close(void);
+// Um evento da partida
+void binlog_event(uint32_t match_id, const LogEvent *ev);
+// Partida retomada de um snapshot: continua a execução, a contagem de turnos e os nomes
+// da última partida com esse id ainda não encerrada no arquivo
+void binlog_resume(uint32_t match_id);
+void binlog_end(uint32_t match_id);
+// Grava um segmento com os trechos prontos (partida encerrada, trecho cheio ou antigo);
+// all grava também os demais
+void binlog_flush(bool all);
+
+// Leitura
+
+// Índice de todos os segmentos do arquivo, do mais antigo ao mais novo; -1 em erro
+long binlog_read_index(int fd, BinlogEntry **entries);
+// Registros do trecho e (malloc); -1 em erro
+long binlog_read_run(int fd, const BinlogEntry *e, BinlogRecord **records);
+// Texto do registro (com os BLOG_MORE seguintes, que consome) em out; atualiza os nomes.
+// Retorna quantos registros usou.
+int  binlog_format(const BinlogRecord *r, int avail, BinlogNames *names,
+                   char *out, size_t size);
+
+#endif // BINLOG_H
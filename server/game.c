@@ -0,0 +1,1006 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "battleship.h"
+#include "gamelog.h"
+#include "metrics.h"
+#include "outbuf.h"
+#include "spectator.h"
+#include "../common/protocol.h"
+
+static const GameMode classic_mode = {
+    .name        = "CLASSICO",
+    .width       = BOARD_SIZE,
+    .height      = BOARD_SIZE,
+    .kind_count  = 3,
+    .kinds       = { { "SUBMARINO", 1, 1 },
+                     { "FRAGATA",   2, 2 },
+                     { "DESTROYER", 3, 1 } },
+    .total_ships = 4,
+    .total_cells = 8,
+};
+
+const GameMode *classic_game_mode(void) {
+    return &classic_mode;
+}
+
+bool parse_game_mode(const char *spec, GameMode *out) {
+    char buf[512];
+    if (strlen(spec) >= sizeof(buf)) return false;
+    strcpy(buf, spec);
+    memset(out, 0, sizeof(*out));
+
+    char *save = NULL;
+    char *name  = strtok_r(buf,  ":", &save);
+    char *dims  = strtok_r(NULL, ":", &save);
+    char *fleet = strtok_r(NULL, ":", &save);
+    if (!name || !dims || !fleet || strlen(name) >= MAX_MODE_NAME) return false;
+    strcpy(out->name, name);
+
+    if (sscanf(dims, "%dx%d", &out->width, &out->height) != 2 ||
+        out->width  < 1 || out->width  > MAX_BOARD_DIM ||
+        out->height < 1 || out->height > MAX_BOARD_DIM) return false;
+
+    char *save_kind = NULL;
+    for (char *k = strtok_r(fleet, ",", &save_kind); k; k = strtok_r(NULL, ",", &save_kind)) {
+        if (out->kind_count == MAX_SHIP_KINDS) return false;
+        ShipKind *kind = &out->kinds[out->kind_count];
+        char *eq = strchr(k, '=');
+        if (!eq || eq == k || eq - k >= MAX_KIND_NAME) return false;
+        memcpy(kind->name, k, eq - k);
+        if (sscanf(eq + 1, "%dx%d", &kind->size, &kind->count) != 2 ||
+            kind->size  < 1 || kind->size > MAX_SHIP_LEN ||
+            kind->size  > (out->width > out->height ? out->width : out->height) ||
+            kind->count < 1) return false;
+        out->total_ships += kind->count;
+        out->total_cells += kind->size * kind->count;
+        out->kind_count++;
+    }
+    return out->kind_count > 0 &&
+           out->total_ships <= MAX_FLEET_SHIPS &&
+           out->total_cells <= out->width * out->height;
+}
+
+// Tipo cujo nome é exatamente os len bytes de s; -1 se não existir
+static ShipType find_ship_type(const GameMode *mode, const char *s, int len) {
+    for (int i = 0; i < mode->kind_count; i++) {
+        const char *name = mode->kinds[i].name;
+        if (len < MAX_KIND_NAME && strncmp(s, name, (size_t)len) == 0 && name[len] == '\0') return i;
+    }
+    return -1;
+}
+
+ShipType parse_ship_type(const GameMode *mode, const char *s) {
+    return find_ship_type(mode, s, (int)strnlen(s, MAX_KIND_NAME));
+}
+
+bool valid_player_name(const char *name, size_t len) {
+    if (len == 0) return false;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char ch = (unsigned char)name[i];
+        if (ch <= ' ' || ch == 0x7f) return false;
+    }
+    return true;
+}
+
+// Tabuleiros que cabem em 64 células usam bitboards; os demais, o índice espacial
+static bool mode_uses_bitboard(const GameMode *mode) {
+    return mode->width * mode->height <= BITBOARD_CELLS;
+}
+
+// Expoente da capacidade do índice: potência de 2 com folga de pelo menos 2x
+static int index_bits_for(const GameMode *mode) {
+    int bits = 1;
+    while ((1 << bits) < 2 * mode->total_cells) bits++;
+    return bits;
+}
+
+size_t game_storage_size(const GameMode *mode) {
+    bool   small      = mode_uses_bitboard(mode);
+    size_t ships_size = (size_t)mode->total_ships * sizeof(Ship);
+    size_t index_size = small ? 0 : ((size_t)1 << index_bits_for(mode)) * sizeof(uint32_t);
+    return MAX_CLIENTS * (ships_size + index_size);
+}
+
+bool init_game(Game *g, const GameMode *mode) {
+    void *block = calloc(1, game_storage_size(mode));
+    if (!block) return false;
+    init_game_in(g, mode, block);
+    g->owns_storage = true;
+    return true;
+}
+
+void init_game_in(Game *g, const GameMode *mode, void *storage) {
+    // um único bloco com os navios e os índices dos dois jogadores
+    bool   small      = mode_uses_bitboard(mode);
+    int    bits       = small ? 0 : index_bits_for(mode);
+    size_t ships_size = (size_t)mode->total_ships * sizeof(Ship);
+    size_t index_size = small ? 0 : ((size_t)1 << bits) * sizeof(uint32_t);
+    char  *block      = storage;
+
+    g->id      = 0;
+    g->mode    = mode;
+    g->storage = block;
+    g->owns_storage = false;
+    g->count        = 0;
+    g->game_over    = false;
+    g->game_started = false;
+    g->turns        = 0;
+    g->forfeit      = 0;
+    g->audience     = NULL;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Player *p = &g->players[i];
+        p->sockfd       = -1;
+        memset(p->name, 0, MAX_NAME_LEN);
+        p->joined       = false;
+        p->binary       = false;
+        p->ready        = false;
+        p->active_turn  = false;
+        p->out          = NULL;
+        p->board.mode       = mode;
+        p->board.occupied   = 0;
+        p->board.hit        = 0;
+        p->board.live_cells = 0;
+        p->board.index_bits = bits;
+
+        // inicializa lista de ships
+        p->ship_count = 0;
+        p->ships = (Ship *)block;
+        block += ships_size;
+        p->board.index = small ? NULL : (uint32_t *)block;
+        block += index_size;
+    }
+}
+
+void destroy_game(Game *g) {
+    if (g->owns_storage) free(g->storage);
+    g->storage = NULL;
+    audience_free(g->audience);
+    g->audience = NULL;
+}
+
+// Com buffer de saída a mensagem só é acumulada; quem o criou envia tudo de uma vez
+void send_to_player(Player *p, const char *msg) {
+    if (p->binary) return;
+    if (p->out)                outbuf_append(p->out, msg, strlen(msg));
+    else if (p->sockfd != -1)  send_counted(p->sockfd, msg, strlen(msg));
+}
+
+void send_frame(Player *p, const uint8_t *frame, size_t len) {
+    if (!p->binary) return;
+    if (p->out)                outbuf_append(p->out, frame, len);
+    else if (p->sockfd != -1)  send_counted(p->sockfd, frame, len);
+}
+
+void broadcast(const Game *g, const char *msg) {
+    for (int i = 0; i < g->count; i++) {
+        send_to_player((Player *)&g->players[i], msg);
+    }
+    gamelog_write(g->id, msg);
+    audience_publish(g->audience, msg, NULL, 0);
+}
+
+// Envia o texto aos jogadores de texto e o quadro aos binários (frame pode ser NULL)
+static void notify(Player *p, const char *msg, const uint8_t *frame, size_t len) {
+    if (p->binary) {
+        if (frame) send_frame(p, frame, len);
+    } else if (msg) {
+        send_to_player(p, msg);
+    }
+}
+
+// Como broadcast(), mas os jogadores e espectadores binários recebem o quadro equivalente.
+// Com ev o log recebe os campos do evento (msg é o texto dele) em vez do texto.
+static void notify_all(Game *g, const char *msg, const uint8_t *frame, size_t len,
+                       const LogEvent *ev)
+{
+    for (int i = 0; i < g->count; i++) {
+        notify(&g->players[i], msg, frame, len);
+    }
+    if (ev) gamelog_event(g->id, ev);
+    else    gamelog_write(g->id, msg);
+    audience_publish(g->audience, msg, frame, len);
+}
+
+// Aviso fixo do jogo para todos; o log guarda só qual foi
+static void broadcast_fixed(Game *g, int fixed) {
+    const char *msg = gamelog_fixed[fixed];
+    for (int i = 0; i < g->count; i++) {
+        send_to_player(&g->players[i], msg);
+    }
+    gamelog_event(g->id, &(LogEvent){ .type = LOG_FIXED, .x = fixed });
+    audience_publish(g->audience, msg, NULL, 0);
+}
+
+static void send_error(Player *p, int code, const char *msg) {
+    metrics_error(code);
+    p->errors++;
+    uint8_t frame[] = { OP_ERROR, (uint8_t)code };
+    notify(p, msg, frame, sizeof(frame));
+}
+
+// Anuncia de quem é a vez: texto com banner e prompts, quadro OP_TURN para os binários
+static void announce_turn(Game *g, Player *turn, Player *waiting, const char *prompt) {
+    char msg[MAX_MSG];
+    LogEvent ev = { .type = LOG_TURN, .player = turn->player_id, .name = turn->name };
+    gamelog_format(&ev, msg, sizeof(msg));
+    uint8_t frame[] = { OP_TURN, (uint8_t)turn->player_id };
+    g->turns++;
+    notify_all(g, msg, frame, sizeof(frame), &ev);
+    send_to_player(turn, prompt);
+    if (waiting) send_to_player(waiting, "*** AGUARDE O TURNO DO ADVERSÁRIO ***\n");
+}
+
+Player* find_player_by_socket(Game *g, int sockfd) {
+    for (int i = 0; i < g->count; i++) {
+        if (g->players[i].sockfd == sockfd) {
+            return &g->players[i];
+        }
+    }
+    return NULL;
+}
+
+bool add_player(Game *g, int sockfd) {
+    if (g->count >= MAX_CLIENTS) return false;
+    g->players[g->count].sockfd = sockfd;
+    g->players[g->count].player_id = g->count + 1; // Player 1 ou 2
+    g->count++;
+    return true;
+}
+
+static inline uint32_t cell_of(const GameMode *mode, int x, int y) {
+    return (uint32_t)x * mode->height + y;
+}
+
+static inline Coord ship_cell(const Ship *s, int i) {
+    return (Coord){ s->origin.x + (s->orientation == VERTICAL   ? i : 0),
+                    s->origin.y + (s->orientation == HORIZONTAL ? i : 0) };
+}
+
+static inline uint32_t index_slot(const Board *b, uint32_t cell) {
+    return (cell * 0x9E3779B1u) >> (32 - b->index_bits);
+}
+
+// Índice do navio na célula, ou -1 se for água (tabuleiros grandes)
+static int index_lookup(const Board *b, uint32_t cell) {
+    uint32_t mask = (1u << b->index_bits) - 1;
+    for (uint32_t i = index_slot(b, cell); b->index[i]; i = (i + 1) & mask) {
+        if ((b->index[i] >> 8) == cell + 1) return (int)(b->index[i] & 0xFF);
+    }
+    return -1;
+}
+
+static void index_insert(Board *b, uint32_t cell, int ship) {
+    uint32_t mask = (1u << b->index_bits) - 1;
+    uint32_t i = index_slot(b, cell);
+    while (b->index[i]) i = (i + 1) & mask;
+    b->index[i] = ((cell + 1) << 8) | (uint32_t)ship;
+}
+
+// Índice do navio que ocupa c, ou -1 se for água
+int ship_at(const Player *p, Coord c) {
+    const GameMode *mode = p->board.mode;
+    if (c.x < 0 || c.x >= mode->width || c.y < 0 || c.y >= mode->height) return -1;
+
+    uint32_t cell = cell_of(mode, c.x, c.y);
+    if (!p->board.index) {
+        Bitboard bit = (Bitboard)1 << cell;
+        if (!(p->board.occupied & bit)) return -1;
+        for (int i = 0; i < p->ship_count; i++) {
+            if (p->ships[i].cells & bit) return i;
+        }
+        return -1;
+    }
+    return index_lookup(&p->board, cell);
+}
+
+bool can_place(Player *p, ShipType type, Coord c, Orientation o) {
+    const GameMode *mode = p->board.mode;
+    if (type < 0 || type >= mode->kind_count) return false;
+    if (p->ship_count >= mode->total_ships)   return false;
+
+    int size  = mode->kinds[type].size;
+    int end_x = c.x + (o == VERTICAL   ? size - 1 : 0);
+    int end_y = c.y + (o == HORIZONTAL ? size - 1 : 0);
+    if (c.x < 0 || end_x >= mode->width ||
+        c.y < 0 || end_y >= mode->height) return false;
+
+    for (int i = 0; i < size; i++) {
+        Coord cell = { c.x + (o == VERTICAL   ? i : 0),
+                       c.y + (o == HORIZONTAL ? i : 0) };
+        if (ship_at(p, cell) != -1) return false;
+    }
+    return true;
+}
+
+bool place_ship(Player *p, ShipType type, Coord c, Orientation o) {
+    if (!can_place(p, type, c, o)) return false;
+    const GameMode *mode = p->board.mode;
+
+    // registra no array de ships
+    int idx = p->ship_count;
+    Ship *ship = &p->ships[idx];
+    ship->type        = type;
+    ship->size        = mode->kinds[type].size;
+    ship->origin.x    = (int16_t)c.x;
+    ship->origin.y    = (int16_t)c.y;
+    ship->orientation = o;
+    ship->hits        = 0;
+    ship->cells       = 0;
+
+    for (int i = 0; i < ship->size; i++) {
+        Coord cc = ship_cell(ship, i);
+        uint32_t cell = cell_of(mode, cc.x, cc.y);
+        if (p->board.index) index_insert(&p->board, cell, idx);
+        else                ship->cells |= (Bitboard)1 << cell;
+    }
+    p->board.occupied   |= ship->cells;
+    p->board.live_cells += ship->size;
+
+    ship->placed = true;
+    p->ship_count++;
+    return true;
+}
+
+// Os navios gravados no bloco são a fonte da verdade: contadores, bitboards e índice são
+// refeitos a partir deles. Um navio que não chegou a ser marcado como posicionado (queda
+// no meio do place_ship) é descartado junto com o que já tinha entrado no índice.
+void game_restore_boards(Game *g) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Player *p = &g->players[i];
+        Board  *b = &p->board;
+        b->occupied = b->hit = 0;
+        b->live_cells = 0;
+        if (b->index) memset(b->index, 0, ((size_t)1 << b->index_bits) * sizeof(uint32_t));
+
+        p->ship_count = 0;
+        while (p->ship_count < g->mode->total_ships && p->ships[p->ship_count].placed) {
+            int   idx  = p->ship_count++;
+            Ship *ship = &p->ships[idx];
+            ship->cells = 0;
+            for (int k = 0; k < ship->size; k++) {
+                Coord    cc   = ship_cell(ship, k);
+                uint32_t cell = cell_of(g->mode, cc.x, cc.y);
+                bool     hit  = ship->hits & ((uint64_t)1 << k);
+                if (b->index) {
+                    index_insert(b, cell, idx);
+                } else {
+                    ship->cells |= (Bitboard)1 << cell;
+                    if (hit) b->hit |= (Bitboard)1 << cell;
+                }
+                if (!hit) b->live_cells++;
+            }
+            b->occupied |= ship->cells;
+        }
+        memset(p->ships + p->ship_count, 0,
+               (size_t)(g->mode->total_ships - p->ship_count) * sizeof(Ship));
+    }
+}
+
+// Bitset com todos os segmentos de um navio de tamanho size
+static inline uint64_t ship_full_mask(int size) {
+    return size >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << size) - 1;
+}
+
+static int count_ships_of_type(Player *p, ShipType type) {
+    int cnt = 0;
+    for (int i = 0; i < p->ship_count; i++) {
+        if (p->ships[i].type == type) cnt++;
+    }
+    return cnt;
+}
+
+// Fim da partida para todos (com ou sem vencedor)
+static void end_game(Game *g) {
+    broadcast_fixed(g, LOG_FIX_GAME_OVER);
+    uint8_t end[] = { OP_END };
+    for (int i = 0; i < 2; i++) {
+        notify(&g->players[i], "END\n", end, sizeof(end));
+    }
+    audience_publish(g->audience, "END\n", end, sizeof(end));
+    g->game_over = true;
+}
+
+static void announce_result(Game *g, Player *winner, Player *loser) {
+    char msg[MAX_MSG];
+    uint8_t outcome[2] = { OP_RESULT, OUTCOME_WIN };
+    snprintf(msg, sizeof(msg),
+             "=== PARABÉNS %s (PLAYER %d)! VOCÊ VENCEU! ===\n",
+             winner->name, winner->player_id);
+    notify(winner, msg, outcome, sizeof(outcome));
+
+    outcome[1] = OUTCOME_LOSE;
+    snprintf(msg, sizeof(msg),
+             "=== %s (PLAYER %d) PERDEU! ===\n",
+             loser->name, loser->player_id);
+    notify(loser, msg, outcome, sizeof(outcome));
+    gamelog_event(g->id, &(LogEvent){ .type = LOG_RESULT, .player = winner->player_id,
+                                      .name = winner->name, .other = loser->name });
+    // o resultado de cada jogador é particular; a plateia recebe o vencedor
+    snprintf(msg, sizeof(msg), "=== VENCEDOR: %s (PLAYER %d) ===\n",
+             winner->name, winner->player_id);
+    uint8_t won[] = { OP_WINNER, (uint8_t)winner->player_id };
+    audience_publish(g->audience, msg, won, sizeof(won));
+    end_game(g);
+}
+
+void handle_fire(Game *g, Player *p, Coord c) {
+    Player *opp = (p == &g->players[0])
+                  ? &g->players[1]
+                  : &g->players[0];
+    int result = 0;  // 0 = ÁGUA, 1 = ACERTO, 2 = AFUNDOU
+
+    // Verifica limite e conteúdo: água ou célula já atingida contam como ÁGUA
+    int idx = ship_at(opp, c);
+    Ship *hitShip = (idx == -1) ? NULL : &opp->ships[idx];
+    uint64_t segment = 0;
+    if (hitShip) {
+        int i = (hitShip->orientation == VERTICAL) ? c.x - hitShip->origin.x
+                                                   : c.y - hitShip->origin.y;
+        segment = (uint64_t)1 << i;
+    }
+    if (!hitShip || (hitShip->hits & segment)) {
+        result = 0;  // ÁGUA
+    } else {
+        // Marca o acerto
+        hitShip->hits |= segment;
+        if (hitShip->cells) {
+            opp->board.hit |= (Bitboard)1 << cell_of(g->mode, c.x, c.y);
+        }
+        opp->board.live_cells--;
+        result = 1;  // ACERTO por padrão
+
+        // Afundou se todos os segmentos do navio foram atingidos
+        if (hitShip->hits == ship_full_mask(hitShip->size)) {
+            result = 2;  // AFUNDOU
+        }
+    }
+
+    // Broadcast do ataque, com as coordenadas de exibição (1..N)
+    char msg[MAX_MSG];
+    LogEvent ev = { .type = LOG_SHOT, .player = p->player_id, .name = p->name,
+                    .x = c.x + 1, .y = c.y + 1,
+                    .result = (result == 0) ? RESULT_MISS : (result == 1) ? RESULT_HIT : RESULT_SUNK };
+    gamelog_format(&ev, msg, sizeof(msg));
+    uint8_t shot[7] = { OP_SHOT, (uint8_t)p->player_id };
+    bin_put16(shot + 2, c.x + 1);
+    bin_put16(shot + 4, c.y + 1);
+    shot[6] = (uint8_t)ev.result;
+    notify_all(g, msg, shot, sizeof(shot), &ev);
+
+    // Verifica vencedor
+    Player *winner = NULL, *loser = NULL;
+    if (check_winner(g, &winner, &loser)) {
+        announce_result(g, winner, loser);
+        return;
+    }
+
+    // Alterna turnos
+    p->active_turn   = false;
+    opp->active_turn = true;
+
+    // Próximo turno
+    announce_turn(g, opp, p, "*** SUA VEZ! Digite FIRE <x> <y> para atacar ***\n");
+}
+
+bool check_winner(Game *g, Player **winner, Player **loser) {
+    if (g->forfeit) {
+        *loser  = &g->players[g->forfeit - 1];
+        *winner = &g->players[2 - g->forfeit];
+        return true;
+    }
+    if (!g->game_started) return false;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        // perdeu quem não tem mais nenhuma célula de navio intacta
+        if (g->players[i].board.live_cells == 0) {
+            *loser  = &g->players[i];
+            *winner = &g->players[1 - i];
+            return true;
+        }
+    }
+    return false;
+}
+
+// O aviso vai para o log antes do RESULTADO: o battlereplay o reaplica com forfeit_game()
+void forfeit_game(Game *g, Player *loser) {
+    if (g->game_over) return;
+    if (!loser) {
+        notify_all(g, "=== TEMPO ESGOTADO: NENHUM JOGADOR FICOU PRONTO ===\n", NULL, 0, NULL);
+        end_game(g);
+        return;
+    }
+    char msg[MAX_MSG];
+    snprintf(msg, sizeof(msg), "=== TEMPO ESGOTADO: PLAYER %d (%s) PERDEU POR W.O. ===\n",
+             loser->player_id, loser->name);
+    notify_all(g, msg, NULL, 0, NULL);
+    g->forfeit = loser->player_id;
+    announce_result(g, &g->players[2 - loser->player_id], loser);
+}
+
+void game_timeout(Game *g) {
+    Player *loser = NULL;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Player *p = &g->players[i];
+        bool late = g->game_started ? p->active_turn : !p->ready;
+        if (!late) continue;
+        if (loser && !g->game_started) {  // os dois sem READY
+            forfeit_game(g, NULL);
+            return;
+        }
+        loser = p;
+    }
+    forfeit_game(g, loser);
+}
+
+// Lista a frota do modo, ex.: "SUBMARINO(1)x1, FRAGATA(2)x2, DESTROYER(3)x1"
+static void format_fleet(const GameMode *mode, char *buf, size_t size) {
+    buf[0] = '\0';
+    for (int i = 0; i < mode->kind_count; i++) {
+        size_t len = strlen(buf);
+        snprintf(buf + len, size - len, "%s%s(%d)x%d", i ? ", " : "",
+                 mode->kinds[i].name, mode->kinds[i].size, mode->kinds[i].count);
+    }
+}
+
+void format_mode_banner(const GameMode *mode, char *out, size_t size) {
+    char fleet[MAX_MSG / 2];
+    format_fleet(mode, fleet, sizeof(fleet));
+    snprintf(out, size, "=== MODO %s: TABULEIRO %dx%d | FROTA: %s ===\n",
+             mode->name, mode->width, mode->height, fleet);
+}
+
+size_t build_mode_frame(const GameMode *mode, uint8_t *frame) {
+    size_t len = 6 + 2 * BIN_MAX_KINDS;
+    memset(frame, 0, len);
+    frame[0] = OP_MODE;
+    bin_put16(frame + 1, mode->width);
+    bin_put16(frame + 3, mode->height);
+    frame[5] = (uint8_t)mode->kind_count;
+    for (int i = 0; i < mode->kind_count; i++) {
+        frame[6 + 2*i]     = (uint8_t)mode->kinds[i].size;
+        frame[6 + 2*i + 1] = (uint8_t)mode->kinds[i].count;
+    }
+    return len;
+}
+
+void rejoin_player(Game *g, Player *p) {
+    char msg[MAX_MSG];
+    snprintf(msg, sizeof(msg),
+             "=== SESSÃO RETOMADA: %s, VOCÊ É O PLAYER %d DA PARTIDA %u ===\n",
+             p->name, p->player_id, g->id);
+    uint8_t welcome[6] = { OP_WELCOME, (uint8_t)p->player_id };
+    bin_put32(welcome + 2, (unsigned long)g->id);
+    notify(p, msg, welcome, sizeof(welcome));
+
+    format_mode_banner(g->mode, msg, sizeof(msg));
+    uint8_t mode[6 + 2 * BIN_MAX_KINDS];
+    notify(p, msg, mode, build_mode_frame(g->mode, mode));
+
+    if (!g->game_started) {
+        if (p->ready) {
+            send_to_player(p, "*** AGUARDANDO O ADVERSÁRIO FICAR PRONTO ***\n");
+        } else {
+            snprintf(msg, sizeof(msg), "*** POSICIONE SEUS NAVIOS: %d de %d posicionados ***\n",
+                     p->ship_count, g->mode->total_ships);
+            send_to_player(p, msg);
+        }
+        return;
+    }
+    Player *turn = g->players[0].active_turn ? &g->players[0] : &g->players[1];
+    snprintf(msg, sizeof(msg), "\n--- TURNO DO PLAYER %d (%s) ---\n", turn->player_id, turn->name);
+    uint8_t frame[] = { OP_TURN, (uint8_t)turn->player_id };
+    notify(p, msg, frame, sizeof(frame));
+    send_to_player(p, turn == p ? "*** SUA VEZ! Digite FIRE <x> <y> para atacar ***\n"
+                                : "*** AGUARDE O TURNO DO ADVERSÁRIO ***\n");
+}
+
+// Erro de coordenada fora do tabuleiro, com os limites do modo da partida
+static void send_coord_error(Game *g, Player *p, const char *prefix) {
+    char msg[MAX_MSG];
+    if (g->mode->width == g->mode->height) {
+        snprintf(msg, sizeof(msg), "%s 1 a %d!\n", prefix, g->mode->width);
+    } else {
+        snprintf(msg, sizeof(msg), "%s x de 1 a %d e y de 1 a %d!\n",
+                 prefix, g->mode->width, g->mode->height);
+    }
+    send_error(p, ERR_BAD_COORD, msg);
+}
+
+// JOIN <nome>; nomes maiores que MAX_NAME_LEN - 1 são cortados
+static void cmd_join(Game *g, Player *p, const char *name, int len) {
+    if (p->joined) {
+        send_error(p, ERR_ALREADY_JOINED, "ERRO: Você já está fez JOIN!\n");
+        return;
+    }
+    if (len > MAX_NAME_LEN - 1) len = MAX_NAME_LEN - 1;
+    memcpy(p->name, name, (size_t)len);
+    p->name[len] = '\0';
+    p->joined = true;
+    char msg[MAX_MSG];
+    snprintf(msg, sizeof(msg),
+             "=== BEM-VINDO, %s! VOCÊ É O PLAYER %d ===\n",
+             p->name, p->player_id);
+    uint8_t welcome[6] = { OP_WELCOME, (uint8_t)p->player_id };
+    bin_put32(welcome + 2, (unsigned long)g->id);
+    notify(p, msg, welcome, sizeof(welcome));
+
+    if (g->count == 1) {
+        uint8_t waiting[] = { OP_WAITING };
+        notify(p, "*** AGUARDANDO OUTRO JOGADOR... ***\n", waiting, sizeof(waiting));
+    } else if (g->count == MAX_CLIENTS) {
+        bool both = g->players[0].joined && g->players[1].joined;
+        if (both) {
+            broadcast_fixed(g, LOG_FIX_CONNECTED);
+            format_mode_banner(g->mode, msg, sizeof(msg));
+            uint8_t mode[6 + 2 * BIN_MAX_KINDS];
+            notify_all(g, msg, mode, build_mode_frame(g->mode, mode), NULL);
+            broadcast_fixed(g, LOG_FIX_PLACEMENT);
+            broadcast_fixed(g, LOG_FIX_PLACE_PROMPT);
+        }
+    }
+}
+
+// READY
+static void cmd_ready(Game *g, Player *p) {
+    if (p->ship_count != g->mode->total_ships) {
+        char msg[MAX_MSG];
+        snprintf(msg, sizeof(msg),
+                 "ERRO: Posicione todos os navios primeiro! (%d/%d)\n",
+                 p->ship_count, g->mode->total_ships);
+        send_error(p, ERR_SHIPS_MISSING, msg);
+        return;
+    }
+    if (p->ready) {
+        send_error(p, ERR_ALREADY_READY, "ERRO: Você já está pronto!\n");
+        return;
+    }
+    p->ready = true;
+    char msg[MAX_MSG];
+    LogEvent ev = { .type = LOG_READY, .player = p->player_id, .name = p->name };
+    gamelog_format(&ev, msg, sizeof(msg));
+    uint8_t readied[] = { OP_READIED, (uint8_t)p->player_id };
+    notify_all(g, msg, readied, sizeof(readied), &ev);
+
+    if (g->players[0].ready && g->players[1].ready) {
+        broadcast_fixed(g, LOG_FIX_ALL_READY);
+        broadcast_fixed(g, LOG_FIX_BATTLE);
+        g->game_started = true;
+        g->players[0].active_turn = true;
+        g->players[1].active_turn = false;
+
+        announce_turn(g, &g->players[0], NULL, "*** SUA VEZ! Digite FIRE <x> <y> ***\n");
+    }
+}
+
+// POS <tipo> <x> <y> <H/V>; type == -1 quando o nome do tipo não existe no modo
+static void cmd_pos(Game *g, Player *p, ShipType type, int rx, int ry, char ori) {
+    if (g->game_started) {
+        send_error(p, ERR_GAME_STARTED, "ERRO: Jogo já iniciado!\n");
+        return;
+    }
+    if (p->ready) {
+        send_error(p, ERR_ALREADY_READY, "ERRO: Você já está pronto!\n");
+        return;
+    }
+    if (rx < 1 || rx > g->mode->width ||
+        ry < 1 || ry > g->mode->height)
+    {
+        send_coord_error(g, p, "ERRO: Coordenadas devem ser");
+        return;
+    }
+    if (type < 0 || type >= g->mode->kind_count) {
+        char msg[MAX_MSG];
+        char kinds[MAX_MSG / 2] = "";
+        for (int i = 0; i < g->mode->kind_count; i++) {
+            size_t len = strlen(kinds);
+            snprintf(kinds + len, sizeof(kinds) - len, "%s%s",
+                     i == 0 ? "" : (i == g->mode->kind_count - 1 ? " ou " : ", "),
+                     g->mode->kinds[i].name);
+        }
+        snprintf(msg, sizeof(msg), "ERRO: Tipo inválido! Use %s\n", kinds);
+        send_error(p, ERR_BAD_TYPE, msg);
+        return;
+    }
+    // limite de cada tipo
+    int used = count_ships_of_type(p, type);
+    int limit = g->mode->kinds[type].count;
+    if (used >= limit) {
+        send_error(p, ERR_TYPE_LIMIT, "ERRO: Limite deste tipo atingido!\n");
+        return;
+    }
+    Coord c = { rx-1, ry-1 };
+    Orientation o = (ori=='H'||ori=='h') ? HORIZONTAL : VERTICAL;
+    if (place_ship(p, type, c, o)) {
+        char msg[MAX_MSG];
+        snprintf(msg, sizeof(msg),
+                 "*** %s em %d,%d %c! (%d/%d navios) ***\n",
+                 g->mode->kinds[type].name, rx, ry, ori,
+                 p->ship_count, g->mode->total_ships);
+        uint8_t placed[9] = { OP_PLACED, (uint8_t)type };
+        bin_put16(placed + 2, rx);
+        bin_put16(placed + 4, ry);
+        placed[6] = (o == HORIZONTAL) ? 0 : 1;
+        placed[7] = (uint8_t)p->ship_count;
+        placed[8] = (uint8_t)g->mode->total_ships;
+        notify(p, msg, placed, sizeof(placed));
+        if (p->ship_count == g->mode->total_ships) {
+            send_to_player(p,
+                "*** TODOS POSICIONADOS! Digite READY ***\n");
+        }
+    } else {
+        send_error(p, ERR_BAD_POSITION, "ERRO: Posição inválida ou ocupada!\n");
+    }
+}
+
+// FIRE <x> <y>
+static void cmd_fire(Game *g, Player *p, int rx, int ry) {
+    if (!g->game_started) {
+        send_error(p, ERR_NOT_STARTED, "ERRO: Jogo não iniciado!\n");
+        return;
+    }
+    if (!p->active_turn) {
+        Player *opp = (p == &g->players[0])
+                      ? &g->players[1]
+                      : &g->players[0];
+        char msg[MAX_MSG];
+        snprintf(msg, sizeof(msg),
+                 "ERRO: Aguarde PLAYER %d (%s)\n",
+                 opp->player_id, opp->name);
+        send_error(p, ERR_NOT_YOUR_TURN, msg);
+        return;
+    }
+    if (rx < 1 || rx > g->mode->width ||
+        ry < 1 || ry > g->mode->height)
+    {
+        send_coord_error(g, p, "ERRO: Coordenadas");
+        return;
+    }
+    handle_fire(g, p, (Coord){rx-1, ry-1});
+}
+
+// Separadores entre verbo e argumentos (os mesmos de isspace no locale C)
+static inline bool is_sep(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Próximo token a partir de *p; len 0 no fim da linha
+static inline Token next_token(const char **p, const char *end) {
+    const char *s = *p;
+    while (s < end && is_sep(*s)) s++;
+    const char *t = s;
+    while (t < end && !is_sep(*t)) t++;
+    *p = t;
+    return (Token){ s, (int)(t - s) };
+}
+
+static inline bool at_end(const char *p, const char *end) {
+    return next_token(&p, end).len == 0;
+}
+
+// Inteiro decimal com sinal opcional; valores enormes saturam (caem fora do tabuleiro)
+static bool token_int(Token t, int *out) {
+    int i = 0;
+    bool neg = t.len > 0 && t.s[0] == '-';
+    if (t.len > 0 && (t.s[0] == '-' || t.s[0] == '+')) i++;
+    if (i == t.len) return false;
+    int64_t v = 0;
+    for (; i < t.len; i++) {
+        unsigned d = (unsigned)(unsigned char)t.s[i] - '0';
+        if (d > 9) return false;
+        if (v <= INT32_MAX) v = v * 10 + d;
+    }
+    if (v > INT32_MAX) v = INT32_MAX;
+    *out = neg ? -(int)v : (int)v;
+    return true;
+}
+
+// JOIN <nome> [modo] (o modo só importa para o lobby)
+static bool parse_join(const char *p, const char *end, Command *cmd) {
+    cmd->join.name = next_token(&p, end);
+    cmd->join.mode = next_token(&p, end);
+    return valid_player_name(cmd->join.name.s, (size_t)cmd->join.name.len) && at_end(p, end);
+}
+
+// POS <tipo> <x> <y> <H/V>
+static bool parse_pos(const char *p, const char *end, Command *cmd) {
+    cmd->pos.type = next_token(&p, end);
+    Token x = next_token(&p, end), y = next_token(&p, end), o = next_token(&p, end);
+    if (cmd->pos.type.len == 0 || !token_int(x, &cmd->pos.x) || !token_int(y, &cmd->pos.y) ||
+        o.len != 1 || (o.s[0] != 'H' && o.s[0] != 'h' && o.s[0] != 'V' && o.s[0] != 'v')) {
+        return false;
+    }
+    cmd->pos.ori = o.s[0];
+    return at_end(p, end);
+}
+
+static bool parse_ready(const char *p, const char *end, Command *cmd) {
+    (void)cmd;
+    return at_end(p, end);
+}
+
+// FIRE <x> <y>
+static bool parse_fire(const char *p, const char *end, Command *cmd) {
+    Token x = next_token(&p, end), y = next_token(&p, end);
+    return token_int(x, &cmd->fire.x) && token_int(y, &cmd->fire.y) && at_end(p, end);
+}
+
+// RESUME <sessão> (o formato da sessão é do servidor)
+static bool parse_attach(const char *p, const char *end, Command *cmd) {
+    cmd->attach.arg = next_token(&p, end);
+    return cmd->attach.arg.len > 0 && at_end(p, end);
+}
+
+// WATCH <partida>: só dígitos; um número que não cabe no id (32 bits) vira 0, que não é
+// de nenhuma partida
+static bool parse_watch(const char *p, const char *end, Command *cmd) {
+    if (!parse_attach(p, end, cmd)) return false;
+    uint64_t v = 0;
+    for (int i = 0; i < cmd->attach.arg.len; i++) {
+        unsigned d = (unsigned)(unsigned char)cmd->attach.arg.s[i] - '0';
+        if (d > 9) return false;
+        if (v <= UINT32_MAX) v = v * 10 + d;
+    }
+    cmd->attach.match = v > UINT32_MAX ? 0 : (uint32_t)v;
+    return true;
+}
+
+// Verbos conhecidos; o tamanho vem primeiro na comparação
+static const struct {
+    const char *verb;
+    int         len;
+    CommandKind kind;
+    bool      (*parse)(const char *p, const char *end, Command *cmd);
+} verbs[] = {
+    { CMD_FIRE,   sizeof(CMD_FIRE) - 1,   CK_FIRE,   parse_fire },
+    { CMD_POS,    sizeof(CMD_POS) - 1,    CK_POS,    parse_pos },
+    { CMD_READY,  sizeof(CMD_READY) - 1,  CK_READY,  parse_ready },
+    { CMD_JOIN,   sizeof(CMD_JOIN) - 1,   CK_JOIN,   parse_join },
+    { CMD_WATCH,  sizeof(CMD_WATCH) - 1,  CK_WATCH,  parse_watch },
+    { CMD_RESUME, sizeof(CMD_RESUME) - 1, CK_RESUME, parse_attach },
+};
+
+void parse_command(const char *line, size_t len, Command *cmd) {
+    const char *p = line, *end = line + len;
+    Token verb = next_token(&p, end);
+    cmd->kind  = CK_UNKNOWN;
+    cmd->valid = false;
+    for (size_t i = 0; i < sizeof(verbs) / sizeof(verbs[0]); i++) {
+        if (verb.len == verbs[i].len && memcmp(verb.s, verbs[i].verb, (size_t)verb.len) == 0) {
+            cmd->kind  = verbs[i].kind;
+            cmd->valid = verbs[i].parse(p, end, cmd);
+            return;
+        }
+    }
+}
+
+static void apply_join(Game *g, Player *p, const Command *cmd) {
+    if (!p->joined && !cmd->valid) {
+        send_error(p, ERR_BAD_FORMAT, "ERRO: Formato inválido! Use: JOIN <seu_nome>\n");
+        return;
+    }
+    cmd_join(g, p, cmd->join.name.s, cmd->join.name.len);
+}
+
+static void apply_ready(Game *g, Player *p, const Command *cmd) {
+    if (!cmd->valid) {
+        send_error(p, ERR_BAD_FORMAT, "ERRO: Use: READY\n");
+        return;
+    }
+    cmd_ready(g, p);
+}
+
+// Os erros de fase vêm antes dos de formato, como nos quadros binários
+static void apply_pos(Game *g, Player *p, const Command *cmd) {
+    if (g->game_started || p->ready) {
+        cmd_pos(g, p, -1, 0, 0, 'H');  // apenas reporta o erro de fase
+    } else if (!cmd->valid) {
+        send_error(p, ERR_BAD_FORMAT, "ERRO: Use: POS <tipo> <x> <y> <H/V>\n");
+    } else {
+        ShipType type = find_ship_type(g->mode, cmd->pos.type.s, cmd->pos.type.len);
+        cmd_pos(g, p, type, cmd->pos.x, cmd->pos.y, cmd->pos.ori);
+    }
+}
+
+static void apply_fire(Game *g, Player *p, const Command *cmd) {
+    if (!g->game_started || !p->active_turn) {
+        cmd_fire(g, p, 0, 0);  // apenas reporta o erro de fase/turno
+    } else if (!cmd->valid) {
+        send_error(p, ERR_BAD_FORMAT, "ERRO: Use: FIRE <x> <y>\n");
+    } else {
+        cmd_fire(g, p, cmd->fire.x, cmd->fire.y);
+    }
+}
+
+// Tratamento de cada verbo dentro da partida; WATCH e RESUME só valem no lobby
+static void (*const handlers[])(Game *, Player *, const Command *) = {
+    [CK_JOIN]  = apply_join,
+    [CK_POS]   = apply_pos,
+    [CK_READY] = apply_ready,
+    [CK_FIRE]  = apply_fire,
+};
+
+void apply_command(Game *g, Player *p, const Command *cmd) {
+    if (g->game_over) return;
+    if (!p->joined && cmd->kind != CK_JOIN) {
+        send_error(p, ERR_NOT_JOINED, "ERRO: Faça JOIN <seu_nome> primeiro!\n");
+        return;
+    }
+    if (cmd->kind < sizeof(handlers) / sizeof(handlers[0]) && handlers[cmd->kind]) {
+        handlers[cmd->kind](g, p, cmd);
+        return;
+    }
+    send_error(p, ERR_UNKNOWN_COMMAND,
+        "COMANDO INVÁLIDO! JOIN, POS, READY ou FIRE\n");
+}
+
+void process_command(Game *g, Player *p, const char *cmd) {
+    Command c;
+    parse_command(cmd, strlen(cmd), &c);
+    apply_command(g, p, &c);
+}
+
+// Converte um quadro binário na linha de texto equivalente (para o log do jogo)
+void format_frame(const Game *g, const uint8_t *frame, char *out, size_t size) {
+    const uint8_t *a = frame + 1;
+    switch (frame[0]) {
+    case OP_JOIN: {
+        // nome inválido vira um JOIN sem nome, que o replay recusa do mesmo jeito
+        size_t len = strnlen((const char *)a, BIN_NAME_LEN);
+        if (valid_player_name((const char *)a, len))
+            snprintf(out, size, "%s %.*s", CMD_JOIN, (int)len, (const char *)a);
+        else
+            snprintf(out, size, "%s", CMD_JOIN);
+        break;
+    }
+    case OP_POS:
+        snprintf(out, size, "%s %s %u %u %c", CMD_POS,
+                 a[0] < g->mode->kind_count ? g->mode->kinds[a[0]].name : "?",
+                 bin_get16(a + 1), bin_get16(a + 3), a[5] ? 'V' : 'H');
+        break;
+    case OP_READY:
+        snprintf(out, size, "%s", CMD_READY);
+        break;
+    case OP_FIRE:
+        snprintf(out, size, "%s %u %u", CMD_FIRE, bin_get16(a), bin_get16(a + 2));
+        break;
+    default:
+        snprintf(out, size, "OP 0x%02X", frame[0]);
+        break;
+    }
+}
+
+void process_frame(Game *g, Player *p, const uint8_t *frame) {
+    if (g->game_over) return;
+    const uint8_t *a = frame + 1;
+
+    switch (frame[0]) {
+    case OP_JOIN: {
+        size_t len = strnlen((const char *)a, BIN_NAME_LEN);
+        if (!p->joined && !valid_player_name((const char *)a, len)) {
+            send_error(p, ERR_BAD_FORMAT, NULL);
+            return;
+        }
+        cmd_join(g, p, (const char *)a, (int)len);
+        return;
+    }
+    case OP_READY:
+    case OP_POS:
+    case OP_FIRE:
+        if (!p->joined) {
+            send_error(p, ERR_NOT_JOINED, NULL);
+            return;
+        }
+        if (frame[0] == OP_READY) cmd_ready(g, p);
+        else if (frame[0] == OP_POS) {
+            cmd_pos(g, p, a[0], bin_get16(a + 1), bin_get16(a + 3), a[5] ? 'V' : 'H');
+        } else {
+            cmd_fire(g, p, bin_get16(a), bin_get16(a + 2));
+        }
+        return;
+    default:
+        send_error(p, ERR_UNKNOWN_COMMAND, NULL);
+        return;
+    }
+}
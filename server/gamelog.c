@@ -0,0 +1,576 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+#include "battleship.h"
+#include "gamelog.h"
+#include "binlog.h"
+#include "../common/protocol.h"
+
+#define LOG_FILE_NAME   "game_log.txt"
+#define MAX_RINGS       128          // threads produtoras distintas
+#define MATCH_BUCKETS   1024         // tabela de buffers por partida
+#define IDLE_SLEEP_NS   1000000L     // pausa da escritora quando os anéis estão vazios
+#define MAX_OPEN_LOGS   512          // arquivos de partida mantidos abertos (os menos usados fecham)
+
+enum { REC_EVENT, REC_END, REC_RESUME };
+
+// Evento no anel: este cabeçalho e depois name e other (com o \0), text e arg
+typedef struct {
+    uint8_t  type, player;
+    uint16_t name_len, other_len, arg_len;
+    int32_t  x, y, result;
+    uint32_t text_len;
+} EventHead;
+
+// Registro de tamanho fixo; eventos maiores ocupam registros consecutivos
+typedef struct {
+    uint32_t match;
+    uint16_t len;
+    uint8_t  kind;
+    uint8_t  more;           // o texto continua no próximo registro
+    char     text[LOG_RECORD_SIZE - 8];
+} LogRecord;
+
+_Static_assert(sizeof(LogRecord) == LOG_RECORD_SIZE, "LogRecord fora do tamanho");
+_Static_assert((LOG_RING_RECORDS & (LOG_RING_RECORDS - 1)) == 0, "anel deve ser potência de 2");
+
+// Anel de uma única thread produtora; só a escritora consome.
+// head e tail em linhas de cache separadas para produtora e escritora não disputarem.
+typedef struct {
+    _Alignas(64) atomic_uint  head;     // próximo registro a ler (escritora)
+    _Alignas(64) atomic_uint  tail;     // próximo registro a escrever (produtora)
+    _Alignas(64) atomic_ulong dropped;  // registros perdidos por anel cheio
+    LogRecord recs[LOG_RING_RECORDS];
+} LogRing;
+
+// Texto pendente de uma partida (modo um arquivo por partida)
+typedef struct MatchLog {
+    uint32_t id;
+    char   *buf;
+    size_t  len, cap;
+    bool    created;          // arquivo já criado com o cabeçalho
+    int     fd;               // -1 se fechado
+    struct MatchLog *next;
+    struct MatchLog *lru_prev, *lru_next;   // arquivos abertos, do mais recente ao mais antigo
+} MatchLog;
+
+static GameLogConfig  config;
+static atomic_bool    running;
+static pthread_t      writer_tid;
+
+static _Atomic(LogRing *) rings[MAX_RINGS];
+static atomic_int     ring_count;
+static atomic_ulong   orphan_dropped;    // threads além de MAX_RINGS ou sem memória
+static __thread LogRing *my_ring;
+static __thread bool     my_ring_failed;
+
+// Estado da escritora (só ela mexe)
+static FILE          *log_file;          // modo arquivo único
+static char          *msg_buf;           // evento sendo remontado
+static size_t         msg_len, msg_cap;
+static MatchLog      *buckets[MATCH_BUCKETS];
+static MatchLog      *lru_head, *lru_tail;
+static int            open_logs;
+static unsigned long  reported_drops;
+
+const char *const gamelog_fixed[LOG_FIX_COUNT] = {
+    [LOG_FIX_CONNECTED]    = "\n=== AMBOS JOGADORES CONECTADOS ===\n",
+    [LOG_FIX_PLACEMENT]    = "=== FASE DE POSICIONAMENTO INICIADA ===\n",
+    [LOG_FIX_PLACE_PROMPT] = "*** POSICIONE SEUS NAVIOS: POS <tipo> <x> <y> <H/V> ***\n",
+    [LOG_FIX_ALL_READY]    = "\n=== AMBOS JOGADORES PRONTOS ===\n",
+    [LOG_FIX_BATTLE]       = "=== INICIANDO BATALHA NAVAL ===\n",
+    [LOG_FIX_GAME_OVER]    = "=== JOGO FINALIZADO ===\n",
+};
+
+static const char *result_names[] = {
+    [RESULT_MISS] = CMD_MISS, [RESULT_HIT] = CMD_HIT, [RESULT_SUNK] = CMD_SUNK,
+};
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + ts.tv_nsec / 1000000;
+}
+
+// ---------------------------------------------------------------------------
+// Lado das threads do jogo
+// ---------------------------------------------------------------------------
+
+static LogRing *ring_for_thread(void) {
+    if (my_ring || my_ring_failed) return my_ring;
+
+    int idx = atomic_fetch_add(&ring_count, 1);
+    LogRing *r = NULL;
+    if (idx < MAX_RINGS && (r = aligned_alloc(64, sizeof(LogRing))) != NULL) {
+        memset(r, 0, sizeof(*r));
+        atomic_store_explicit(&rings[idx], r, memory_order_release);
+    } else {
+        if (idx >= MAX_RINGS) atomic_fetch_sub(&ring_count, 1);
+        my_ring_failed = true;
+    }
+    my_ring = r;
+    return r;
+}
+
+// Reserva os registros de uma vez: ou o texto inteiro entra no anel, ou nada entra
+static void ring_push(uint32_t match, int kind, const char *text, size_t len) {
+    LogRing *r = ring_for_thread();
+    size_t chunk = sizeof(((LogRecord *)0)->text);
+    unsigned need = len ? (unsigned)((len + chunk - 1) / chunk) : 1;
+
+    if (!r) {
+        atomic_fetch_add_explicit(&orphan_dropped, need, memory_order_relaxed);
+        return;
+    }
+
+    unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (LOG_RING_RECORDS - (tail - head) < need) {
+        atomic_fetch_add_explicit(&r->dropped, need, memory_order_relaxed);
+        return;
+    }
+
+    for (unsigned i = 0; i < need; i++) {
+        LogRecord *rec = &r->recs[(tail + i) & (LOG_RING_RECORDS - 1)];
+        size_t n = len > chunk ? chunk : len;
+        rec->match = match;
+        rec->kind  = (uint8_t)kind;
+        rec->len   = (uint16_t)n;
+        rec->more  = i + 1 < need;
+        memcpy(rec->text, text, n);
+        text += n;
+        len  -= n;
+    }
+    atomic_store_explicit(&r->tail, tail + need, memory_order_release);
+}
+
+void gamelog_event(uint32_t match_id, const LogEvent *ev) {
+    if (!atomic_load_explicit(&running, memory_order_relaxed)) return;
+    size_t name  = ev->name  ? strnlen(ev->name, MAX_NAME_LEN - 1) + 1 : 0;
+    size_t other = ev->other ? strnlen(ev->other, MAX_NAME_LEN - 1) + 1 : 0;
+    size_t arg   = ev->arg_len < MAX_MSG ? ev->arg_len : MAX_MSG;
+    size_t text  = ev->len < MAX_MSG ? ev->len : MAX_MSG;
+    char buf[sizeof(EventHead) + 2 * MAX_NAME_LEN + 2 * MAX_MSG];
+    EventHead h = {
+        .type = (uint8_t)ev->type, .player = (uint8_t)ev->player,
+        .name_len = (uint16_t)name, .other_len = (uint16_t)other, .arg_len = (uint16_t)arg,
+        .x = ev->x, .y = ev->y, .result = ev->result, .text_len = (uint32_t)text,
+    };
+    char *q = buf;
+    memcpy(q, &h, sizeof(h));
+    q += sizeof(h);
+    if (name) {
+        memcpy(q, ev->name, name - 1);
+        q[name - 1] = '\0';
+        q += name;
+    }
+    if (other) {
+        memcpy(q, ev->other, other - 1);
+        q[other - 1] = '\0';
+        q += other;
+    }
+    if (text) memcpy(q, ev->text, text);
+    q += text;
+    if (arg) memcpy(q, ev->arg, arg);
+    q += arg;
+    ring_push(match_id, REC_EVENT, buf, (size_t)(q - buf));
+}
+
+void gamelog_write(uint32_t match_id, const char *text) {
+    LogEvent ev = { .type = LOG_TEXT, .text = text, .len = strlen(text) };
+    gamelog_event(match_id, &ev);
+}
+
+void gamelog_resume(uint32_t match_id) {
+    if (!atomic_load_explicit(&running, memory_order_relaxed)) return;
+    ring_push(match_id, REC_RESUME, NULL, 0);
+}
+
+void gamelog_end(uint32_t match_id) {
+    if (!atomic_load_explicit(&running, memory_order_relaxed)) return;
+    ring_push(match_id, REC_END, NULL, 0);
+}
+
+unsigned long gamelog_dropped(void) {
+    unsigned long total = atomic_load(&orphan_dropped);
+    int n = atomic_load(&ring_count);
+    for (int i = 0; i < n && i < MAX_RINGS; i++) {
+        LogRing *r = atomic_load_explicit(&rings[i], memory_order_acquire);
+        if (r) total += atomic_load_explicit(&r->dropped, memory_order_relaxed);
+    }
+    return total;
+}
+
+int gamelog_format(const LogEvent *ev, char *out, size_t size) {
+    const char *name = ev->name ? ev->name : "?";
+    switch (ev->type) {
+    case LOG_POS:
+        if (ev->text) break;
+        return snprintf(out, size, "PLAYER %d -> %s %.*s %d %d %c\n", ev->player, CMD_POS,
+                        (int)ev->arg_len, ev->arg, ev->x, ev->y, ev->result);
+    case LOG_FIRE:
+        if (ev->text) break;
+        return snprintf(out, size, "PLAYER %d -> %s %d %d\n", ev->player, CMD_FIRE, ev->x, ev->y);
+    case LOG_CMD:
+        break;
+    case LOG_TURN:
+        return snprintf(out, size, "\n--- TURNO DO PLAYER %d (%s) ---\n", ev->player, name);
+    case LOG_READY:
+        return snprintf(out, size, "*** PLAYER %d (%s) ESTÁ PRONTO! ***\n", ev->player, name);
+    case LOG_SHOT:
+        return snprintf(out, size, "=== PLAYER %d (%s) ATACOU %d %d: %s ===\n",
+                        ev->player, name, ev->x, ev->y,
+                        ev->result >= RESULT_MISS && ev->result <= RESULT_SUNK
+                            ? result_names[ev->result] : "?");
+    case LOG_RESULT: {
+        int loser = ev->player == 1 ? 2 : 1;
+        return snprintf(out, size, "RESULTADO: %s (Player %d) WINS; %s (Player %d) LOSES\n\n",
+                        name, ev->player, ev->other ? ev->other : "?", loser);
+    }
+    case LOG_FIXED:
+        return snprintf(out, size, "%s", ev->x >= 0 && ev->x < LOG_FIX_COUNT ? gamelog_fixed[ev->x] : "");
+    default:
+        return snprintf(out, size, "%.*s", (int)ev->len, ev->text ? ev->text : "");
+    }
+    // comando como chegou
+    return snprintf(out, size, "PLAYER %d -> %.*s\n", ev->player, (int)ev->len, ev->text);
+}
+
+// ---------------------------------------------------------------------------
+// Escritora
+// ---------------------------------------------------------------------------
+
+static MatchLog **match_slot(uint32_t id) {
+    MatchLog **pp = &buckets[id % MATCH_BUCKETS];
+    while (*pp && (*pp)->id != id) pp = &(*pp)->next;
+    return pp;
+}
+
+static MatchLog *match_get(uint32_t id) {
+    MatchLog **pp = match_slot(id);
+    if (!*pp && (*pp = calloc(1, sizeof(**pp))) != NULL) {
+        (*pp)->id = id;
+        (*pp)->fd = -1;
+    }
+    return *pp;
+}
+
+static void lru_unlink(MatchLog *ml) {
+    if (ml->lru_prev) ml->lru_prev->lru_next = ml->lru_next;
+    else              lru_head = ml->lru_next;
+    if (ml->lru_next) ml->lru_next->lru_prev = ml->lru_prev;
+    else              lru_tail = ml->lru_prev;
+    ml->lru_prev = ml->lru_next = NULL;
+}
+
+static void lru_push(MatchLog *ml) {
+    ml->lru_next = lru_head;
+    if (lru_head) lru_head->lru_prev = ml;
+    else          lru_tail = ml;
+    lru_head = ml;
+}
+
+static void match_close(MatchLog *ml) {
+    if (ml->fd == -1) return;
+    lru_unlink(ml);
+    close(ml->fd);
+    ml->fd = -1;
+    open_logs--;
+}
+
+static void match_append(uint32_t id, const char *text, size_t len) {
+    MatchLog *ml = match_get(id);
+    if (!ml) return;
+    if (ml->len + len > ml->cap) {
+        size_t cap = ml->cap ? ml->cap : 4096;
+        while (cap < ml->len + len) cap *= 2;
+        char *buf = realloc(ml->buf, cap);
+        if (!buf) return;
+        ml->buf = buf;
+        ml->cap = cap;
+    }
+    memcpy(ml->buf + ml->len, text, len);
+    ml->len += len;
+}
+
+// Arquivo da partida, aberto uma vez e mantido até ela acabar ou sair do LRU
+static int match_fd(MatchLog *ml, const char *path) {
+    if (ml->fd != -1) {
+        lru_unlink(ml);
+        lru_push(ml);
+        return ml->fd;
+    }
+    if (open_logs >= MAX_OPEN_LOGS) match_close(lru_tail);
+
+    // uma execução sem -S recomeça os ids: a partida nova vem depois da antiga de mesmo id
+    if ((ml->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644)) == -1) return -1;
+    if (!ml->created) {
+        if (write(ml->fd, LOG_HEADER, sizeof(LOG_HEADER) - 1) < 0) perror(path);
+        ml->created = true;
+    }
+    open_logs++;
+    lru_push(ml);
+    return ml->fd;
+}
+
+// Grava o texto pendente da partida no arquivo dela
+static void match_flush(MatchLog *ml) {
+    if (ml->len == 0 && ml->created) return;
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/partida_%u.txt", config.dir, ml->id);
+    int fd = match_fd(ml, path);
+    if (fd == -1) {
+        perror(path);
+        ml->len = 0;
+        return;
+    }
+    size_t off = 0;
+    while (off < ml->len) {
+        ssize_t n = write(fd, ml->buf + off, ml->len - off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror(path);
+            break;
+        }
+        off += (size_t)n;
+    }
+    ml->len = 0;
+}
+
+static void match_finish(uint32_t id) {
+    MatchLog **pp = match_slot(id);
+    MatchLog *ml = *pp;
+    if (!ml) return;
+    match_flush(ml);
+    match_close(ml);
+    *pp = ml->next;
+    free(ml->buf);
+    free(ml);
+}
+
+// Evento remontado do anel; os textos apontam para buf
+static bool event_decode(const char *buf, size_t len, LogEvent *ev) {
+    EventHead h;
+    if (len < sizeof(h)) return false;
+    memcpy(&h, buf, sizeof(h));
+    if (sizeof(h) + h.name_len + h.other_len + (size_t)h.text_len + h.arg_len != len) return false;
+    const char *q = buf + sizeof(h);
+    *ev = (LogEvent){ .type = h.type, .player = h.player, .x = h.x, .y = h.y, .result = h.result };
+    if (h.name_len)  ev->name  = q;
+    q += h.name_len;
+    if (h.other_len) ev->other = q;
+    q += h.other_len;
+    if (h.text_len) {
+        ev->text = q;
+        ev->len  = h.text_len;
+    }
+    q += h.text_len;
+    ev->arg     = q;
+    ev->arg_len = h.arg_len;
+    return true;
+}
+
+// Modo arquivo único: marca cada linha não vazia com a partida. O evento chega inteiro,
+// então uma linha nunca se mistura com outra partida; sem \n no fim ela é fechada aqui.
+static void shared_text(uint32_t match, const char *p, size_t len) {
+    const char *end = p + len;
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        size_t n = nl ? (size_t)(nl - p) + 1 : (size_t)(end - p);
+        if (*p != '\n') fprintf(log_file, LOG_MATCH_TAG, match);
+        fwrite(p, 1, n, log_file);
+        if (!nl) fputc('\n', log_file);
+        p += n;
+    }
+}
+
+static void apply_event(uint32_t match, const LogEvent *ev) {
+    if (config.binary) {
+        binlog_event(match, ev);
+        return;
+    }
+    char buf[2 * MAX_MSG];
+    const char *text = ev->text;
+    size_t len = ev->len;
+    if (ev->type != LOG_TEXT) {
+        int n = gamelog_format(ev, buf, sizeof(buf));
+        if (n < 0) return;
+        text = buf;
+        len  = (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1;
+    }
+    if (!text) return;
+    if (config.dir) match_append(match, text, len);
+    else            shared_text(match, text, len);
+}
+
+// Junta os registros de um evento (consecutivos no mesmo anel)
+static void apply_record(const LogRecord *rec) {
+    if (rec->kind == REC_END) {
+        if (config.binary)   binlog_end(rec->match);
+        else if (config.dir) match_finish(rec->match);
+        return;
+    }
+    if (rec->kind == REC_RESUME) {
+        MatchLog *ml;
+        if (config.binary) binlog_resume(rec->match);
+        else if (config.dir && (ml = match_get(rec->match)) != NULL) {
+            ml->created = true;  // o arquivo já tem o começo da partida
+        }
+        return;
+    }
+    if (msg_len + rec->len > msg_cap) {
+        size_t cap = msg_cap ? msg_cap * 2 : 1024;
+        while (cap < msg_len + rec->len) cap *= 2;
+        char *buf = realloc(msg_buf, cap);
+        if (!buf) {
+            msg_len = 0;
+            return;
+        }
+        msg_buf = buf;
+        msg_cap = cap;
+    }
+    memcpy(msg_buf + msg_len, rec->text, rec->len);
+    msg_len += rec->len;
+    if (!rec->more) {
+        LogEvent ev;
+        if (event_decode(msg_buf, msg_len, &ev)) apply_event(rec->match, &ev);
+        msg_len = 0;
+    }
+}
+
+// Consome tudo o que há nos anéis; true se havia algo
+static bool drain_rings(void) {
+    bool got = false;
+    int n = atomic_load(&ring_count);
+    for (int i = 0; i < n && i < MAX_RINGS; i++) {
+        LogRing *r = atomic_load_explicit(&rings[i], memory_order_acquire);
+        if (!r) continue;
+        unsigned head = atomic_load_explicit(&r->head, memory_order_relaxed);
+        unsigned tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+        if (head == tail) continue;
+        for (; head != tail; head++) {
+            apply_record(&r->recs[head & (LOG_RING_RECORDS - 1)]);
+        }
+        atomic_store_explicit(&r->head, head, memory_order_release);
+        got = true;
+    }
+    return got;
+}
+
+static void flush_all(void) {
+    if (config.binary) {
+        binlog_flush(false);
+        return;
+    }
+    if (!config.dir) {
+        fflush(log_file);
+        return;
+    }
+    for (int b = 0; b < MATCH_BUCKETS; b++) {
+        for (MatchLog *ml = buckets[b]; ml; ml = ml->next) match_flush(ml);
+    }
+}
+
+static void report_drops(void) {
+    unsigned long dropped = gamelog_dropped();
+    if (dropped > reported_drops) {
+        printf("[LOG] %lu registros descartados (anel cheio), %lu no total\n",
+               dropped - reported_drops, dropped);
+        reported_drops = dropped;
+    }
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    uint64_t next_flush = now_ms() + (uint64_t)config.flush_ms;
+
+    while (atomic_load(&running)) {
+        bool got = drain_rings();
+        if (now_ms() >= next_flush) {
+            flush_all();
+            report_drops();
+            next_flush = now_ms() + (uint64_t)config.flush_ms;
+        }
+        if (!got) {
+            struct timespec ts = { 0, IDLE_SLEEP_NS };
+            nanosleep(&ts, NULL);
+        }
+    }
+
+    drain_rings();
+    flush_all();
+    report_drops();
+    return NULL;
+}
+
+bool gamelog_start(const GameLogConfig *cfg) {
+    config = *cfg;
+    if (config.flush_ms <= 0) config.flush_ms = LOG_FLUSH_MS;
+
+    if (config.binary) {
+        if (!binlog_open(config.binary)) return false;
+    } else if (config.dir) {
+        if (mkdir(config.dir, 0755) == -1 && errno != EEXIST) {
+            perror(config.dir);
+            return false;
+        }
+    } else {
+        log_file = fopen(LOG_FILE_NAME, "a");
+        if (!log_file) {
+            perror("fopen");
+            return false;
+        }
+        fseek(log_file, 0, SEEK_END);
+        if (ftell(log_file) == 0 || !config.same_ids) fprintf(log_file, LOG_HEADER);
+        fflush(log_file);
+    }
+
+    atomic_store(&running, true);
+    if (pthread_create(&writer_tid, NULL, writer_main, NULL) != 0) {
+        perror("pthread_create");
+        atomic_store(&running, false);
+        if (log_file) fclose(log_file);
+        log_file = NULL;
+        binlog_close();
+        return false;
+    }
+    return true;
+}
+
+void gamelog_stop(void) {
+    if (!atomic_load(&running)) return;
+    atomic_store(&running, false);
+    pthread_join(writer_tid, NULL);
+
+    // partidas ainda abertas (servidor parado no meio do jogo)
+    for (int b = 0; b < MATCH_BUCKETS; b++) {
+        while (buckets[b]) match_finish(buckets[b]->id);
+    }
+    if (log_file) {
+        fprintf(log_file, "\n=== SERVIDOR FINALIZADO ===\n");
+        fclose(log_file);
+        log_file = NULL;
+    }
+    binlog_close();
+    free(msg_buf);
+    msg_buf = NULL;
+    msg_len = msg_cap = 0;
+
+    int n = atomic_load(&ring_count);
+    for (int i = 0; i < n && i < MAX_RINGS; i++) {
+        free(atomic_exchange(&rings[i], NULL));
+    }
+    atomic_store(&ring_count, 0);
+}
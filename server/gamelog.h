@@ -0,0 +1,84 @@
+#ifndef GAMELOG_H
+#define GAMELOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Log das partidas fora do caminho das requisições.
+// Cada thread que registra algo ganha um anel SPSC próprio de registros de tamanho fixo;
+// uma thread escritora esvazia os anéis e grava em lote no disco a cada flush_ms.
+// Se o anel enche, o registro é descartado e contado (nunca bloqueia a thread do jogo).
+
+#define LOG_RECORD_SIZE   256    // bytes por registro (cabeçalho + texto)
+#define LOG_RING_RECORDS  4096   // registros por anel (potência de 2)
+#define LOG_FLUSH_MS      200    // intervalo padrão de gravação
+// Os arquivos de texto nunca são truncados: este cabeçalho abre cada arquivo e cada
+// partida do -L, e no game_log.txt marca a execução que recomeçou os ids (o replay
+// separa as partidas de mesmo id por ele)
+#define LOG_HEADER        "=== NOVO JOGO INICIADO ===\n\n"
+// No game_log.txt as partidas se intercalam: cada linha começa com a partida dela
+#define LOG_MATCH_TAG     "[partida %u] "
+
+// Eventos do log. Quem joga emite os campos; o texto de sempre sai de gamelog_format
+// (na escritora, para os logs de texto, e no battlelog), e o log binário grava só os
+// campos. A mensagem dos eventos do jogo aos jogadores também vem de gamelog_format.
+enum {
+    LOG_TEXT,     // mensagem literal (text)
+    LOG_CMD,      // "PLAYER n -> <text>"
+    LOG_POS,      // "PLAYER n -> POS <arg> x y <result>"
+    LOG_FIRE,     // "PLAYER n -> FIRE x y"
+    LOG_TURN,     // "--- TURNO DO PLAYER n (name) ---"
+    LOG_READY,    // "*** PLAYER n (name) ESTÁ PRONTO! ***"
+    LOG_SHOT,     // "=== PLAYER n (name) ATACOU x y: <result> ==="
+    LOG_RESULT,   // "RESULTADO: name (Player n) WINS; other (Player m) LOSES"
+    LOG_FIXED,    // gamelog_fixed[x]
+};
+
+// Avisos fixos do jogo; só acrescente no fim (o log binário grava o índice)
+enum {
+    LOG_FIX_CONNECTED, LOG_FIX_PLACEMENT, LOG_FIX_PLACE_PROMPT,
+    LOG_FIX_ALL_READY, LOG_FIX_BATTLE, LOG_FIX_GAME_OVER, LOG_FIX_COUNT
+};
+extern const char *const gamelog_fixed[LOG_FIX_COUNT];
+
+typedef struct {
+    int         type;      // LOG_*
+    int         player;    // 1..MAX_CLIENTS (vencedor no RESULT); 0 se não se aplica
+    int         x, y;      // coordenadas como digitadas (1..N); índice do aviso no FIXED
+    int         result;    // RESULT_* no SHOT; orientação ('H', 'v', ...) no POS
+    const char *name;      // nome do player (TURN, READY, SHOT, RESULT)
+    const char *other;     // nome do perdedor (RESULT)
+    const char *text;      // TEXT; no CMD, POS e FIRE o comando como chegou (sem o \n).
+    size_t      len;       //   POS e FIRE sem text saem na forma canônica dos campos
+    const char *arg;       // POS: tipo do navio
+    size_t      arg_len;
+} LogEvent;
+
+typedef struct {
+    const char *dir;       // NULL: tudo em game_log.txt (linhas com LOG_MATCH_TAG); senão
+                           // um arquivo por partida em dir
+    const char *binary;    // se não NULL, log binário indexado neste arquivo (binlog.h) em vez do texto
+    int         flush_ms;  // intervalo entre gravações em disco
+    bool        same_ids;  // ids continuam os da execução anterior (-S, -H): o game_log.txt
+                           // segue sem um LOG_HEADER novo
+} GameLogConfig;
+
+// Abre o destino e inicia a thread escritora; false se não conseguir
+bool gamelog_start(const GameLogConfig *cfg);
+// Esvazia os anéis, grava o que falta e encerra a escritora
+void gamelog_stop(void);
+// Enfileira um evento da partida (sem efeito se o log não foi iniciado)
+void gamelog_event(uint32_t match_id, const LogEvent *ev);
+// Enfileira um texto já formatado da partida (LOG_TEXT)
+void gamelog_write(uint32_t match_id, const char *text);
+// Texto do evento em out, como snprintf
+int  gamelog_format(const LogEvent *ev, char *out, size_t size);
+// Partida retomada de um snapshot: o arquivo dela é continuado em vez de recriado
+void gamelog_resume(uint32_t match_id);
+// Marca o fim da partida: a escritora grava e libera o buffer dela
+void gamelog_end(uint32_t match_id);
+// Total de registros descartados por anel cheio
+unsigned long gamelog_dropped(void);
+
+#endif // GAMELOG_H
@@ -0,0 +1,342 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+
+#include "metrics.h"
+
+#define MAX_BLOCKS 128   // threads que registram métricas
+
+bool metrics_on = false;
+
+static _Atomic(Metrics *) blocks[MAX_BLOCKS];
+static atomic_int        block_count;
+static __thread Metrics *my_block;
+static __thread bool     my_block_failed;
+
+static const char *command_names[MC_COUNT] = { "join", "pos", "ready", "fire", "outro" };
+
+static const char *limit_names[ML_COUNT] = { "pausadas", "saida_cheia", "desconectadas", "recusadas_ip" };
+
+static const char *timeout_names[MT_COUNT] = { "jogada", "posicionamento", "ocioso", "fila", "retomada" };
+
+static const char *error_names[METRIC_ERRORS] = {
+    [ERR_UNKNOWN_COMMAND] = "comando_desconhecido",
+    [ERR_BAD_FORMAT]      = "formato_invalido",
+    [ERR_NOT_JOINED]      = "sem_join",
+    [ERR_ALREADY_JOINED]  = "join_repetido",
+    [ERR_UNKNOWN_MODE]    = "modo_desconhecido",
+    [ERR_GAME_STARTED]    = "jogo_iniciado",
+    [ERR_NOT_STARTED]     = "jogo_nao_iniciado",
+    [ERR_ALREADY_READY]   = "ja_pronto",
+    [ERR_SHIPS_MISSING]   = "navios_faltando",
+    [ERR_BAD_COORD]       = "coordenada_invalida",
+    [ERR_BAD_TYPE]        = "tipo_invalido",
+    [ERR_TYPE_LIMIT]      = "limite_do_tipo",
+    [ERR_BAD_POSITION]    = "posicao_invalida",
+    [ERR_NOT_YOUR_TURN]   = "fora_do_turno",
+    [ERR_UNKNOWN_MATCH]   = "partida_desconhecida",
+    [ERR_BAD_SESSION]     = "sessao_invalida",
+    [ERR_DRAINING]        = "servidor_em_troca",
+    [ERR_FLOOD]           = "comandos_demais",
+    [ERR_TIMEOUT]         = "tempo_esgotado",
+};
+
+void metrics_enable(void) {
+    metrics_on = true;
+}
+
+uint64_t metrics_clock(void) {
+    if (!metrics_on) return 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// ---------------------------------------------------------------------------
+// Lado das threads que registram
+// ---------------------------------------------------------------------------
+
+static Metrics *block_for_thread(void) {
+    if (my_block || my_block_failed || !metrics_on) return my_block;
+
+    int idx = atomic_fetch_add(&block_count, 1);
+    Metrics *m = NULL;
+    if (idx < MAX_BLOCKS && (m = aligned_alloc(64, (sizeof(Metrics) + 63) & ~(size_t)63)) != NULL) {
+        memset(m, 0, sizeof(*m));
+        hist_init(&m->cmd_ns);
+        hist_init(&m->send_ns);
+        atomic_store_explicit(&blocks[idx], m, memory_order_release);
+    } else {
+        if (idx >= MAX_BLOCKS) atomic_fetch_sub(&block_count, 1);
+        my_block_failed = true;
+    }
+    my_block = m;
+    return m;
+}
+
+// Só a dona escreve no bloco: carga e escrita relaxadas bastam e não travam o barramento,
+// e o leitor nunca vê um valor rasgado
+static inline void bump(uint64_t *v, uint64_t n) {
+    __atomic_store_n(v, __atomic_load_n(v, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+static void hist_bump(Histogram *h, uint64_t v) {
+    bump(&h->counts[hist_index(v)], 1);
+    bump(&h->total, 1);
+    bump(&h->sum, v);
+    if (v < __atomic_load_n(&h->min, __ATOMIC_RELAXED)) __atomic_store_n(&h->min, v, __ATOMIC_RELAXED);
+    if (v > __atomic_load_n(&h->max, __ATOMIC_RELAXED)) __atomic_store_n(&h->max, v, __ATOMIC_RELAXED);
+}
+
+void metrics_conn_opened(void) {
+    Metrics *m = block_for_thread();
+    if (m) bump(&m->conns_opened, 1);
+}
+
+void metrics_conn_closed(void) {
+    Metrics *m = block_for_thread();
+    if (m) bump(&m->conns_closed, 1);
+}
+
+void metrics_game_started(void) {
+    Metrics *m = block_for_thread();
+    if (m) bump(&m->games_started, 1);
+}
+
+void metrics_game_ended(bool finished) {
+    Metrics *m = block_for_thread();
+    if (m) bump(finished ? &m->games_finished : &m->games_abandoned, 1);
+}
+
+void metrics_snapshot_full(void) {
+    Metrics *m = block_for_thread();
+    if (m) bump(&m->games_unsnapshotted, 1);
+}
+
+void metrics_error(int code) {
+    Metrics *m = block_for_thread();
+    if (m && code > 0 && code < METRIC_ERRORS) bump(&m->errors[code], 1);
+}
+
+void metrics_limit(int action) {
+    Metrics *m = block_for_thread();
+    if (m) bump(&m->limits[action], 1);
+}
+
+void metrics_timeout(int kind) {
+    Metrics *m = block_for_thread();
+    if (m) bump(&m->timeouts[kind], 1);
+}
+
+void metrics_command(int kind, uint64_t start) {
+    Metrics *m = block_for_thread();
+    if (!m) return;
+    bump(&m->commands[kind], 1);
+    hist_bump(&m->cmd_ns, metrics_clock() - start);
+}
+
+ssize_t send_counted(int fd, const void *buf, size_t len) {
+    uint64_t start = metrics_clock();
+    ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+    if (metrics_on) metrics_send(len, start, n < 0);
+    return n;
+}
+
+void metrics_send(size_t bytes, uint64_t start, bool failed) {
+    Metrics *m = block_for_thread();
+    if (!m) return;
+    bump(&m->sends, 1);
+    if (failed) bump(&m->send_failures, 1);
+    else        bump(&m->send_bytes, bytes);
+    hist_bump(&m->send_ns, metrics_clock() - start);
+}
+
+int metrics_command_kind(CommandKind kind) {
+    switch (kind) {
+    case CK_JOIN:  return MC_JOIN;
+    case CK_POS:   return MC_POS;
+    case CK_READY: return MC_READY;
+    case CK_FIRE:  return MC_FIRE;
+    default:       return MC_OTHER;
+    }
+}
+
+int metrics_frame_kind(uint8_t op) {
+    switch (op) {
+    case OP_JOIN:  return MC_JOIN;
+    case OP_POS:   return MC_POS;
+    case OP_READY: return MC_READY;
+    case OP_FIRE:  return MC_FIRE;
+    default:       return MC_OTHER;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Leitura
+// ---------------------------------------------------------------------------
+
+static void hist_load(Histogram *dst, const Histogram *src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->counts[i] = __atomic_load_n(&src->counts[i], __ATOMIC_RELAXED);
+    }
+    dst->total = __atomic_load_n(&src->total, __ATOMIC_RELAXED);
+    dst->sum   = __atomic_load_n(&src->sum, __ATOMIC_RELAXED);
+    dst->min   = __atomic_load_n(&src->min, __ATOMIC_RELAXED);
+    dst->max   = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+}
+
+void metrics_snapshot(Metrics *out) {
+    Histogram tmp;
+    memset(out, 0, sizeof(*out));
+    hist_init(&out->cmd_ns);
+    hist_init(&out->send_ns);
+
+    // contadores simples: todos os uint64_t antes dos histogramas
+    size_t counters = offsetof(Metrics, cmd_ns) / sizeof(uint64_t);
+    int n = atomic_load(&block_count);
+    if (n > MAX_BLOCKS) n = MAX_BLOCKS;
+    for (int b = 0; b < n; b++) {
+        Metrics *m = atomic_load_explicit(&blocks[b], memory_order_acquire);
+        if (!m) continue;
+        uint64_t *dst = (uint64_t *)out;
+        uint64_t *src = (uint64_t *)m;
+        for (size_t i = 0; i < counters; i++) {
+            dst[i] += __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+        }
+        hist_load(&tmp, &m->cmd_ns);
+        hist_merge(&out->cmd_ns, &tmp);
+        hist_load(&tmp, &m->send_ns);
+        hist_merge(&out->send_ns, &tmp);
+    }
+}
+
+typedef struct {
+    char  *buf;
+    size_t size, len;
+} Out;
+
+static void out_printf(Out *o, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void out_printf(Out *o, const char *fmt, ...) {
+    if (o->len >= o->size) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(o->buf + o->len, o->size - o->len, fmt, ap);
+    va_end(ap);
+    if (n > 0) o->len += (size_t)n;
+    if (o->len >= o->size) o->len = o->size - 1;   // truncado
+}
+
+static void format_hist_text(Out *o, const char *name, const Histogram *h) {
+    out_printf(o, "%s: n=%llu media=%.2f p50=%.2f p90=%.2f p99=%.2f p999=%.2f max=%.2f\n", name,
+               (unsigned long long)h->total, h->total ? h->sum / 1000.0 / h->total : 0.0,
+               hist_percentile(h, 50) / 1000.0, hist_percentile(h, 90) / 1000.0,
+               hist_percentile(h, 99) / 1000.0, hist_percentile(h, 99.9) / 1000.0,
+               h->total ? h->max / 1000.0 : 0.0);
+}
+
+static void format_hist_json(Out *o, const char *name, const Histogram *h) {
+    out_printf(o, "\"%s\":{\"n\":%llu,\"media\":%llu,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,"
+               "\"p999\":%llu,\"max\":%llu}", name,
+               (unsigned long long)h->total,
+               (unsigned long long)(h->total ? h->sum / h->total : 0),
+               (unsigned long long)hist_percentile(h, 50),
+               (unsigned long long)hist_percentile(h, 90),
+               (unsigned long long)hist_percentile(h, 99),
+               (unsigned long long)hist_percentile(h, 99.9),
+               (unsigned long long)(h->total ? h->max : 0));
+}
+
+size_t metrics_format(const Metrics *m, const MetricsGauges *g, bool json, char *buf, size_t size) {
+    Out o = { buf, size, 0 };
+    uint64_t errors = 0;
+    for (int i = 1; i < METRIC_ERRORS; i++) errors += m->errors[i];
+    unsigned long long active = m->conns_opened - m->conns_closed;
+
+    if (!json) {
+        out_printf(&o, "conexoes: abertas=%llu fechadas=%llu ativas=%llu\n",
+                   (unsigned long long)m->conns_opened, (unsigned long long)m->conns_closed, active);
+        out_printf(&o, "lobby: na_fila=%d partidas_ativas=%d espectadores=%d\n",
+                   g->lobby_waiting, g->matches_active, g->spectators);
+        out_printf(&o, "partidas: iniciadas=%llu terminadas=%llu abandonadas=%llu sem_snapshot=%llu\n",
+                   (unsigned long long)m->games_started, (unsigned long long)m->games_finished,
+                   (unsigned long long)m->games_abandoned, (unsigned long long)m->games_unsnapshotted);
+        out_printf(&o, "comandos:");
+        for (int i = 0; i < MC_COUNT; i++) {
+            out_printf(&o, " %s=%llu", command_names[i], (unsigned long long)m->commands[i]);
+        }
+        out_printf(&o, "\nerros: total=%llu", (unsigned long long)errors);
+        for (int i = 1; i < METRIC_ERRORS; i++) {
+            if (m->errors[i]) out_printf(&o, " %s=%llu", error_names[i], (unsigned long long)m->errors[i]);
+        }
+        out_printf(&o, "\nenvios: chamadas=%llu bytes=%llu falhas=%llu\n",
+                   (unsigned long long)m->sends, (unsigned long long)m->send_bytes,
+                   (unsigned long long)m->send_failures);
+        out_printf(&o, "limites:");
+        for (int i = 0; i < ML_COUNT; i++) {
+            out_printf(&o, " %s=%llu", limit_names[i], (unsigned long long)m->limits[i]);
+        }
+        out_printf(&o, "\nprazos:");
+        for (int i = 0; i < MT_COUNT; i++) {
+            out_printf(&o, " %s=%llu", timeout_names[i], (unsigned long long)m->timeouts[i]);
+        }
+        out_printf(&o, "\n");
+        format_hist_text(&o, "latencia_comando_us", &m->cmd_ns);
+        format_hist_text(&o, "latencia_envio_us", &m->send_ns);
+        for (int i = 0; i < g->pool_count; i++) {
+            const MetricsPool *p = &g->pools[i];
+            out_printf(&o, "memoria %s: bytes_por_partida=%zu em_uso=%zu capacidade=%zu bytes=%zu\n",
+                       p->mode, p->match_bytes, p->in_use, p->capacity, p->bytes);
+        }
+        out_printf(&o, "log: descartados=%lu\n", g->log_dropped);
+        return o.len;
+    }
+
+    out_printf(&o, "{\"conexoes\":{\"abertas\":%llu,\"fechadas\":%llu,\"ativas\":%llu},",
+               (unsigned long long)m->conns_opened, (unsigned long long)m->conns_closed, active);
+    out_printf(&o, "\"lobby\":{\"na_fila\":%d,\"partidas_ativas\":%d,\"espectadores\":%d},",
+               g->lobby_waiting, g->matches_active, g->spectators);
+    out_printf(&o, "\"partidas\":{\"iniciadas\":%llu,\"terminadas\":%llu,\"abandonadas\":%llu,"
+               "\"sem_snapshot\":%llu},",
+               (unsigned long long)m->games_started, (unsigned long long)m->games_finished,
+               (unsigned long long)m->games_abandoned, (unsigned long long)m->games_unsnapshotted);
+    out_printf(&o, "\"comandos\":{");
+    for (int i = 0; i < MC_COUNT; i++) {
+        out_printf(&o, "%s\"%s\":%llu", i ? "," : "", command_names[i],
+                   (unsigned long long)m->commands[i]);
+    }
+    out_printf(&o, "},\"erros\":{\"total\":%llu", (unsigned long long)errors);
+    for (int i = 1; i < METRIC_ERRORS; i++) {
+        out_printf(&o, ",\"%s\":%llu", error_names[i], (unsigned long long)m->errors[i]);
+    }
+    out_printf(&o, "},\"envios\":{\"chamadas\":%llu,\"bytes\":%llu,\"falhas\":%llu},",
+               (unsigned long long)m->sends, (unsigned long long)m->send_bytes,
+               (unsigned long long)m->send_failures);
+    out_printf(&o, "\"limites\":{");
+    for (int i = 0; i < ML_COUNT; i++) {
+        out_printf(&o, "%s\"%s\":%llu", i ? "," : "", limit_names[i],
+                   (unsigned long long)m->limits[i]);
+    }
+    out_printf(&o, "},\"prazos\":{");
+    for (int i = 0; i < MT_COUNT; i++) {
+        out_printf(&o, "%s\"%s\":%llu", i ? "," : "", timeout_names[i],
+                   (unsigned long long)m->timeouts[i]);
+    }
+    out_printf(&o, "},");
+    format_hist_json(&o, "latencia_comando_ns", &m->cmd_ns);
+    out_printf(&o, ",");
+    format_hist_json(&o, "latencia_envio_ns", &m->send_ns);
+    out_printf(&o, ",\"memoria\":{");
+    for (int i = 0; i < g->pool_count; i++) {
+        const MetricsPool *p = &g->pools[i];
+        out_printf(&o, "%s\"%s\":{\"bytes_por_partida\":%zu,\"em_uso\":%zu,\"capacidade\":%zu,"
+                   "\"bytes\":%zu}", i ? "," : "", p->mode, p->match_bytes, p->in_use,
+                   p->capacity, p->bytes);
+    }
+    out_printf(&o, "},\"log\":{\"descartados\":%lu}}\n", g->log_dropped);
+    return o.len;
+}
@@ -0,0 +1,111 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "battleship.h"
+#include "../common/histogram.h"
+#include "../common/protocol.h"
+
+// Métricas do servidor com custo baixo no caminho das requisições.
+// Cada thread escreve só no seu bloco de contadores e histogramas (sem lock nem
+// instrução atômica com trava); o leitor soma os blocos de todas as threads.
+// Enquanto metrics_enable() não é chamado tudo é no-op, então as ferramentas que
+// usam as regras do jogo não pagam nada.
+
+// Tipos de comando contados
+enum { MC_JOIN, MC_POS, MC_READY, MC_FIRE, MC_OTHER, MC_COUNT };
+
+// Ações dos limites de taxa
+enum {
+    ML_THROTTLED,    // conexão passou do limite de comandos e foi pausada
+    ML_OUTPUT,       // conexão pausada até enviar a saída acumulada
+    ML_FLOOD,        // conexão desconectada por erros demais
+    ML_IP_REFUSED,   // conexão recusada pelo limite do endereço de origem
+    ML_COUNT
+};
+
+// Prazos esgotados
+enum {
+    MT_TURN,         // jogador da vez não atirou (perdeu por W.O.)
+    MT_PLACEMENT,    // posicionamento sem READY
+    MT_IDLE,         // conexão não fez JOIN, WATCH nem RESUME a tempo
+    MT_LOBBY,        // ninguém apareceu para jogar na fila do lobby
+    MT_RESUME,       // partida retomada do snapshot sem ninguém de volta
+    MT_COUNT
+};
+
+#define METRIC_ERRORS (ERR_TIMEOUT + 1)   // indexado pelo código ERR_*
+
+typedef struct {
+    uint64_t conns_opened;
+    uint64_t conns_closed;
+    uint64_t commands[MC_COUNT];
+    uint64_t errors[METRIC_ERRORS];
+    uint64_t games_started;
+    uint64_t games_finished;     // terminaram com vencedor
+    uint64_t games_abandoned;    // jogadores saíram antes do fim
+    uint64_t games_unsnapshotted; // com -S, criadas sem fatia livre no snapshot
+    uint64_t sends;
+    uint64_t send_bytes;
+    uint64_t send_failures;
+    uint64_t limits[ML_COUNT];
+    uint64_t timeouts[MT_COUNT];
+    Histogram cmd_ns;            // tempo de tratamento de um comando
+    Histogram send_ns;           // tempo de uma chamada send()
+} Metrics;
+
+// Pool de partidas de um modo
+typedef struct {
+    const char *mode;
+    size_t match_bytes;          // bytes de cada partida (estado e bloco do jogo)
+    size_t in_use;               // partidas vivas
+    size_t capacity;             // partidas que cabem na memória já reservada
+    size_t bytes;                // memória reservada
+} MetricsPool;
+
+// Estado instantâneo preenchido por quem exporta (não vem das threads)
+typedef struct {
+    int  lobby_waiting;
+    int  matches_active;
+    int  spectators;
+    unsigned long log_dropped;
+    int  pool_count;
+    MetricsPool pools[MAX_MODES];
+} MetricsGauges;
+
+extern bool metrics_on;
+
+void metrics_enable(void);
+
+// Relógio para medir intervalos; 0 se as métricas estão desligadas
+uint64_t metrics_clock(void);
+
+void metrics_conn_opened(void);
+void metrics_conn_closed(void);
+void metrics_game_started(void);
+void metrics_game_ended(bool finished);
+void metrics_snapshot_full(void);
+void metrics_error(int code);
+void metrics_limit(int action);
+void metrics_timeout(int kind);
+// Comando de tipo kind (MC_*) que começou em start (metrics_clock)
+void metrics_command(int kind, uint64_t start);
+// send() de bytes que começou em start; failed se retornou erro
+void metrics_send(size_t bytes, uint64_t start, bool failed);
+
+// send() com MSG_NOSIGNAL que conta a chamada, os bytes e o tempo
+ssize_t send_counted(int fd, const void *buf, size_t len);
+
+// Tipo de um comando de texto já separado ou de um opcode binário
+int metrics_command_kind(CommandKind kind);
+int metrics_frame_kind(uint8_t op);
+
+// Soma os blocos de todas as threads
+void metrics_snapshot(Metrics *out);
+// Formata o snapshot em texto legível ou em JSON de uma linha; retorna o tamanho escrito
+size_t metrics_format(const Metrics *m, const MetricsGauges *g, bool json, char *buf, size_t size);
+
+#endif // METRICS_H
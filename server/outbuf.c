@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+#include "outbuf.h"
+#include "metrics.h"
+
+// Troca o anel por um com capacidade para need bytes, já linearizado a partir de 0
+static bool outbuf_grow(OutBuf *o, size_t need) {
+    size_t cap = o->cap ? o->cap : OUTBUF_INITIAL;
+    while (cap < need) cap <<= 1;
+    char *data = malloc(cap);
+    if (!data) return false;
+
+    size_t pending = outbuf_pending(o);
+    if (pending) {
+        size_t at    = o->head & (o->cap - 1);
+        size_t first = pending < o->cap - at ? pending : o->cap - at;
+        memcpy(data, o->data + at, first);
+        memcpy(data + first, o->data, pending - first);
+    }
+    free(o->data);
+    o->data = data;
+    o->cap  = cap;
+    o->head = 0;
+    o->tail = pending;
+    return true;
+}
+
+void outbuf_append(OutBuf *o, const void *buf, size_t len) {
+    if (o->overflow || len == 0) return;
+    size_t need = outbuf_pending(o) + len;
+    if (need > OUTBUF_MAX || (need > o->cap && !outbuf_grow(o, need))) {
+        o->overflow = true;
+        return;
+    }
+    size_t at    = o->tail & (o->cap - 1);
+    size_t first = len < o->cap - at ? len : o->cap - at;
+    memcpy(o->data + at, buf, first);
+    memcpy(o->data, (const char *)buf + first, len - first);
+    o->tail += len;
+}
+
+int outbuf_flush(OutBuf *o, int fd) {
+    size_t pending = outbuf_pending(o);
+    if (pending == 0) return 1;
+
+    // o pendente ocupa no máximo dois trechos do anel
+    size_t at    = o->head & (o->cap - 1);
+    size_t first = pending < o->cap - at ? pending : o->cap - at;
+    struct iovec iov[2] = {
+        { .iov_base = o->data + at, .iov_len = first },
+        { .iov_base = o->data,      .iov_len = pending - first },
+    };
+
+    // o socket é não bloqueante e o servidor ignora SIGPIPE
+    uint64_t start = metrics_clock();
+    ssize_t n = writev(fd, iov, pending > first ? 2 : 1);
+    bool failed = n < 0 && errno != EAGAIN && errno != EINTR;
+    if (metrics_on) metrics_send(n > 0 ? (size_t)n : 0, start, failed);
+    if (failed) return -1;
+    if (n > 0) o->head += (size_t)n;
+
+    if (outbuf_pending(o) > 0) return 0;
+    o->head = o->tail = 0;
+    if (o->cap > OUTBUF_KEEP) {
+        free(o->data);
+        o->data = NULL;
+        o->cap  = 0;
+    }
+    return 1;
+}
+
+void outbuf_free(OutBuf *o) {
+    free(o->data);
+    memset(o, 0, sizeof(*o));
+}
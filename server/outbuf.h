@@ -0,0 +1,37 @@
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Buffer de saída de uma conexão: as mensagens geradas por um comando são acumuladas
+// e enviadas juntas com um único writev no socket não bloqueante. O que o kernel não
+// aceitar fica para quando o socket voltar a ter espaço (EPOLLOUT).
+//
+// Anel com capacidade potência de 2, alocado só quando há algo a enviar e limitado a
+// OUTBUF_MAX: um leitor que deixa acumular mais que isso é desconectado em vez de
+// segurar a partida.
+
+#define OUTBUF_INITIAL  2048
+#define OUTBUF_KEEP     16384          // acima disso o anel é liberado quando esvazia
+#define OUTBUF_MAX      (256 * 1024)
+#define OUTBUF_PAUSE    (64 * 1024)    // acima disso a conexão só volta a mandar comandos quando a saída esvazia
+
+typedef struct OutBuf {
+    char   *data;
+    size_t  cap;
+    size_t  head, tail;     // posições lógicas; pendente = tail - head
+    bool    overflow;       // passou de OUTBUF_MAX: a conexão deve ser fechada
+} OutBuf;
+
+static inline size_t outbuf_pending(const OutBuf *o) {
+    return o->tail - o->head;
+}
+
+// Acrescenta len bytes; se estourar OUTBUF_MAX descarta e marca overflow
+void outbuf_append(OutBuf *o, const void *buf, size_t len);
+// Envia o pendente com um writev; 1 se esvaziou, 0 se sobrou (EAGAIN), -1 em erro
+int outbuf_flush(OutBuf *o, int fd);
+void outbuf_free(OutBuf *o);
+
+#endif // OUTBUF_H
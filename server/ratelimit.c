@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "ratelimit.h"
+
+#define IPLIMIT_BITS 14   // entradas da tabela de endereços
+
+typedef struct {
+    uint32_t    conns;    // conexões abertas
+    TokenBucket opens;    // conexões novas
+} IpSlot;
+
+static IpSlot         *ip_table = NULL;   // NULL: limite desligado
+static unsigned        ip_max;
+static RateLimit       ip_rate;
+// aceitadores pegam, lobby e shards devolvem; só uma operação curta por conexão
+static pthread_mutex_t ip_lock = PTHREAD_MUTEX_INITIALIZER;
+
+bool iplimit_init(unsigned max) {
+    if (max == 0) return true;
+    ip_table = calloc(1u << IPLIMIT_BITS, sizeof(*ip_table));
+    if (!ip_table) {
+        perror("calloc");
+        return false;
+    }
+    ip_max = max;
+    rate_limit_init(&ip_rate, max, max);
+    return true;
+}
+
+static IpSlot *ip_slot(uint32_t addr) {
+    return &ip_table[(addr * 0x9E3779B1u) >> (32 - IPLIMIT_BITS)];
+}
+
+bool iplimit_acquire(uint32_t addr, uint64_t now) {
+    if (!ip_table) return true;
+    pthread_mutex_lock(&ip_lock);
+    IpSlot *s = ip_slot(addr);
+    bool ok = s->conns < ip_max && bucket_wait_us(&s->opens, &ip_rate, now) == 0;
+    if (ok) {
+        bucket_charge(&s->opens, &ip_rate, now, 1);
+        s->conns++;
+    }
+    pthread_mutex_unlock(&ip_lock);
+    return ok;
+}
+
+void iplimit_release(uint32_t addr) {
+    if (!ip_table) return;
+    pthread_mutex_lock(&ip_lock);
+    IpSlot *s = ip_slot(addr);
+    if (s->conns > 0) s->conns--;
+    pthread_mutex_unlock(&ip_lock);
+}
@@ -0,0 +1,59 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Limites de taxa do servidor: baldes de fichas por conexão (comandos e respostas de
+// erro) e por endereço de origem (conexões novas e abertas ao mesmo tempo).
+//
+// O balde não guarda as fichas, e sim o instante em que volta a ficar cheio: cada ficha
+// gasta empurra esse instante interval_us para a frente, e o saldo é o quanto ele está
+// no futuro. Assim não há reabastecimento periódico, só uma comparação por comando.
+
+typedef struct {
+    uint64_t interval_us;   // uma ficha nova a cada interval_us; 0 desliga o limite
+    uint64_t burst_us;      // capacidade do balde (fichas * interval_us)
+} RateLimit;
+
+typedef struct {
+    uint64_t full_at;       // instante (us) em que o balde volta a estar cheio
+} TokenBucket;
+
+static inline void rate_limit_init(RateLimit *r, unsigned per_sec, unsigned burst) {
+    r->interval_us = per_sec ? (1000000u + per_sec - 1) / per_sec : 0;
+    r->burst_us    = r->interval_us * (burst ? burst : 1);
+}
+
+static inline bool rate_limit_on(const RateLimit *r) {
+    return r->interval_us != 0;
+}
+
+// Fichas que faltam no balde, em tempo até ele encher de novo
+static inline uint64_t bucket_debt(const TokenBucket *b, uint64_t now) {
+    return b->full_at > now ? b->full_at - now : 0;
+}
+
+// Tempo até haver uma ficha; 0 se já há
+static inline uint64_t bucket_wait_us(const TokenBucket *b, const RateLimit *r, uint64_t now) {
+    uint64_t need = bucket_debt(b, now) + r->interval_us;
+    return need > r->burst_us ? need - r->burst_us : 0;
+}
+
+// Gasta n fichas mesmo sem saldo; false se o balde ficou devendo
+static inline bool bucket_charge(TokenBucket *b, const RateLimit *r, uint64_t now, unsigned n) {
+    uint64_t debt = bucket_debt(b, now) + (uint64_t)n * r->interval_us;
+    b->full_at = now + debt;
+    return debt <= r->burst_us;
+}
+
+// Limite por endereço IPv4 de origem, compartilhado pelas threads: até max conexões
+// abertas e max novas por segundo. max 0 desliga. Endereços que caem na mesma entrada
+// da tabela dividem os limites.
+bool iplimit_init(unsigned max);
+// Conexão nova de addr (ordem da rede); false se passou de um dos limites
+bool iplimit_acquire(uint32_t addr, uint64_t now);
+// Conexão de addr aceita por iplimit_acquire foi fechada
+void iplimit_release(uint32_t addr);
+
+#endif // RATELIMIT_H
@@ -0,0 +1,70 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "slab.h"
+
+void slab_init(Slab *s, size_t obj_size) {
+    memset(s, 0, sizeof(*s));
+    s->obj_size = slab_align(obj_size ? obj_size : 1);
+    s->per_slab = s->obj_size < SLAB_BYTES ? (unsigned)(SLAB_BYTES / s->obj_size) : 1;
+    pthread_mutex_init(&s->lock, NULL);
+}
+
+void slab_destroy(Slab *s) {
+    for (unsigned i = 0; i < s->slab_count; i++) free(s->slabs[i]);
+    free(s->slabs);
+    pthread_mutex_destroy(&s->lock);
+    memset(s, 0, sizeof(*s));
+}
+
+// Laje nova com todos os objetos na lista de livres; chamada com o lock tomado
+static bool slab_grow(Slab *s) {
+    if (s->slab_count == s->slab_cap) {
+        unsigned cap = s->slab_cap ? s->slab_cap * 2 : 16;
+        void **slabs = realloc(s->slabs, cap * sizeof(*slabs));
+        if (!slabs) return false;
+        s->slabs    = slabs;
+        s->slab_cap = cap;
+    }
+    char *mem = aligned_alloc(SLAB_ALIGN, s->obj_size * s->per_slab);
+    if (!mem) return false;
+    s->slabs[s->slab_count++] = mem;
+    // em ordem de endereço: partidas criadas em sequência ficam vizinhas
+    for (unsigned i = s->per_slab; i-- > 0; ) {
+        SlabFree *f = (SlabFree *)(mem + i * s->obj_size);
+        f->next = s->free;
+        s->free = f;
+    }
+    return true;
+}
+
+void *slab_alloc(Slab *s) {
+    pthread_mutex_lock(&s->lock);
+    SlabFree *f = s->free;
+    if (!f && slab_grow(s)) f = s->free;
+    if (f) {
+        s->free = f->next;
+        s->in_use++;
+    }
+    pthread_mutex_unlock(&s->lock);
+    if (f) memset(f, 0, s->obj_size);
+    return f;
+}
+
+void slab_free(Slab *s, void *obj) {
+    SlabFree *f = obj;
+    pthread_mutex_lock(&s->lock);
+    f->next = s->free;
+    s->free = f;
+    s->in_use--;
+    pthread_mutex_unlock(&s->lock);
+}
+
+void slab_stats(Slab *s, SlabStats *out) {
+    pthread_mutex_lock(&s->lock);
+    out->obj_size = s->obj_size;
+    out->in_use   = s->in_use;
+    out->capacity = (size_t)s->slab_count * s->per_slab;
+    out->bytes    = out->capacity * s->obj_size;
+    pthread_mutex_unlock(&s->lock);
+}
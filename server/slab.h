@@ -0,0 +1,54 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// Pool de objetos de tamanho fixo para as partidas. A memória vem em lajes de
+// SLAB_BYTES com os objetos alinhados em linha de cache; um objeto liberado volta para a
+// lista de livres e é o próximo a ser entregue, então uma partida nova reaproveita a
+// memória (ainda quente) de uma encerrada em vez de passar pelo malloc. As lajes só são
+// devolvidas ao sistema no slab_destroy.
+//
+// Reserva no lobby e devolução nos shards: como nas fatias do snapshot, a lista de
+// livres tem um mutex, tomado por uma operação curta por partida.
+
+#define SLAB_ALIGN  64            // linha de cache
+#define SLAB_BYTES  (256u << 10)  // laje típica; objetos maiores ganham uma laje cada
+
+typedef struct SlabFree {
+    struct SlabFree *next;
+} SlabFree;
+
+typedef struct {
+    size_t          obj_size;     // múltiplo de SLAB_ALIGN
+    unsigned        per_slab;     // objetos por laje
+    pthread_mutex_t lock;
+    SlabFree       *free;         // objetos livres
+    void          **slabs;        // lajes alocadas
+    unsigned        slab_count, slab_cap;
+    size_t          in_use;       // objetos entregues e ainda não devolvidos
+} Slab;
+
+// Ocupação de um pool no momento da leitura
+typedef struct {
+    size_t obj_size;              // bytes por objeto
+    size_t in_use;
+    size_t capacity;              // objetos que as lajes já alocadas comportam
+    size_t bytes;                 // memória das lajes
+} SlabStats;
+
+static inline size_t slab_align(size_t n) {
+    return (n + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1);
+}
+
+void  slab_init(Slab *s, size_t obj_size);
+void  slab_destroy(Slab *s);
+// Objeto zerado (qualquer thread); NULL sem memória
+void *slab_alloc(Slab *s);
+// Devolve um objeto de slab_alloc ao pool (qualquer thread)
+void  slab_free(Slab *s, void *obj);
+void  slab_stats(Slab *s, SlabStats *out);
+
+#endif // SLAB_H
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "snapshot.h"
+
+#define SNAP_MAGIC    0x504E5342u   // "BSNP"
+#define SNAP_VERSION  5             // 2: Ship compacto (24 bytes); 3: turnos e W.O.;
+                                    // 4: próximo id de partida no cabeçalho;
+                                    // 5: contagem de partidas em 64 bits, id sem sinal
+#define SNAP_HEADER   4096          // o cabeçalho ocupa a primeira página
+#define SNAP_ALIGN    64
+
+// Cabeçalho do arquivo; os tamanhos conferem se o layout gravado é o deste binário
+typedef struct {
+    uint32_t magic, version;
+    uint32_t slot_size, slot_count;
+    uint32_t ship_size, mode_size, slot_head;
+    uint32_t pad;
+    uint64_t match_seq;      // partidas já numeradas, por esta execução e pelas anteriores
+} SnapHeader;
+
+static char    *map;
+static size_t   map_size;
+static uint32_t slot_size;
+static int      slot_count;
+
+// Fatias livres: reservadas pelo lobby, devolvidas pelos shards
+static pthread_mutex_t free_lock = PTHREAD_MUTEX_INITIALIZER;
+static int            *free_stack;
+static int             free_top;
+
+static size_t align_up(size_t n, size_t a) {
+    return (n + a - 1) & ~(a - 1);
+}
+
+static size_t slot_head(void) {
+    return align_up(sizeof(SnapSlot), SNAP_ALIGN);
+}
+
+// Confere o que veio do disco antes de usar como modo de uma partida
+static bool slot_valid(SnapSlot *s) {
+    GameMode *m = &s->mode;
+    if (s->match_id == 0 || s->bot_seat < -1 || s->bot_seat >= MAX_CLIENTS) return false;
+    if (m->width < 1 || m->width > MAX_BOARD_DIM || m->height < 1 || m->height > MAX_BOARD_DIM ||
+        m->kind_count < 1 || m->kind_count > MAX_SHIP_KINDS ||
+        m->total_ships < 1 || m->total_ships > MAX_FLEET_SHIPS) return false;
+
+    int ships = 0, cells = 0;
+    for (int i = 0; i < m->kind_count; i++) {
+        if (m->kinds[i].size < 1 || m->kinds[i].size > MAX_SHIP_LEN || m->kinds[i].count < 0) {
+            return false;
+        }
+        m->kinds[i].name[MAX_KIND_NAME - 1] = '\0';
+        ships += m->kinds[i].count;
+        cells += m->kinds[i].size * m->kinds[i].count;
+    }
+    if (ships != m->total_ships || cells != m->total_cells) return false;
+    m->name[MAX_MODE_NAME - 1] = '\0';
+    for (int i = 0; i < MAX_CLIENTS; i++) s->players[i].name[MAX_NAME_LEN - 1] = '\0';
+    return slot_head() + game_storage_size(m) <= slot_size;
+}
+
+bool snapshot_open(const char *path, const GameMode *modes, int mode_count, int slots) {
+    size_t need = 0;
+    for (int i = 0; i < mode_count; i++) {
+        size_t size = game_storage_size(&modes[i]);
+        if (size > need) need = size;
+    }
+    uint32_t size = (uint32_t)align_up(slot_head() + need, SNAP_ALIGN);
+
+    // os segredos das sessões ficam no arquivo: também um arquivo antigo passa a 0600
+    int fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (fd == -1 || fchmod(fd, 0600) == -1) {
+        perror(path);
+        if (fd != -1) close(fd);
+        return false;
+    }
+    struct stat st;
+    SnapHeader h;
+    bool reuse = fstat(fd, &st) == 0 && pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) &&
+                 h.magic == SNAP_MAGIC && h.version == SNAP_VERSION &&
+                 h.slot_count >= 1 && h.slot_count <= SNAP_MAX_SLOTS && h.slot_size >= size &&
+                 h.ship_size == sizeof(Ship) && h.mode_size == sizeof(GameMode) &&
+                 h.slot_head == slot_head();
+    if (reuse) {
+        size = h.slot_size;  // modos menores que os da execução anterior cabem nas fatias
+        if ((int)h.slot_count > slots) slots = (int)h.slot_count;  // nenhuma fatia viva some
+    } else if (st.st_size > 0) {
+        fprintf(stderr, "[SNAPSHOT] %s é de outro formato ou modos maiores; recriando\n", path);
+        // arquivo novo em vez de truncar: um processo que ainda mapeia o antigo (o que
+        // entregou os sockets no HANDOFF) não perde as páginas
+        close(fd);
+        unlink(path);
+        if ((fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600)) == -1) {
+            perror(path);
+            return false;
+        }
+        st.st_size = 0;
+    }
+
+    free(free_stack);
+    if (!(free_stack = malloc((size_t)slots * sizeof(*free_stack)))) {
+        perror("malloc");
+        close(fd);
+        return false;
+    }
+    map_size = SNAP_HEADER + (size_t)size * (size_t)slots;
+    if ((off_t)map_size > st.st_size && ftruncate(fd, (off_t)map_size) == -1) {
+        perror(path);
+        close(fd);
+        return false;
+    }
+    map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        map = NULL;
+        return false;
+    }
+    slot_size  = size;
+    slot_count = slots;
+    if (!reuse) {
+        h = (SnapHeader){ SNAP_MAGIC, SNAP_VERSION, size, (uint32_t)slots,
+                          sizeof(Ship), sizeof(GameMode), (uint32_t)slot_head(), 0, 0 };
+        memcpy(map, &h, sizeof(h));
+    } else {
+        ((SnapHeader *)map)->slot_count = (uint32_t)slots;  // fatias novas já estão zeradas (SNAP_FREE)
+    }
+
+    // de trás para frente: as primeiras fatias saem primeiro
+    free_top = 0;
+    for (int i = slots - 1; i >= 0; i--) {
+        SnapSlot *s = snapshot_slot(i);
+        if (s->state == SNAP_LIVE && !slot_valid(s)) s->state = SNAP_FREE;
+        if (s->state != SNAP_LIVE) free_stack[free_top++] = i;
+    }
+    return true;
+}
+
+void snapshot_close(void) {
+    if (!map) return;
+    munmap(map, map_size);
+    map = NULL;
+    free(free_stack);
+    free_stack = NULL;
+}
+
+int snapshot_slot_count(void) {
+    return map ? slot_count : 0;
+}
+
+uint64_t snapshot_match_seq(void) {
+    if (!map) return 0;
+    return __atomic_load_n(&((SnapHeader *)map)->match_seq, __ATOMIC_ACQUIRE);
+}
+
+void snapshot_set_match_seq(uint64_t seq) {
+    if (!map) return;
+    // no HANDOFF o processo antigo ainda mapeia o arquivo: o valor só sobe
+    uint64_t *p = &((SnapHeader *)map)->match_seq;
+    uint64_t cur = __atomic_load_n(p, __ATOMIC_RELAXED);
+    while (cur < seq &&
+           !__atomic_compare_exchange_n(p, &cur, seq, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {}
+}
+
+SnapSlot *snapshot_slot(int i) {
+    return (SnapSlot *)(map + SNAP_HEADER + (size_t)i * slot_size);
+}
+
+void *snapshot_storage(SnapSlot *s) {
+    return (char *)s + slot_head();
+}
+
+SnapSlot *snapshot_alloc(uint32_t match_id, const GameMode *mode, int bot_seat) {
+    if (!map) return NULL;
+    pthread_mutex_lock(&free_lock);
+    int i = free_top > 0 ? free_stack[--free_top] : -1;
+    pthread_mutex_unlock(&free_lock);
+    if (i == -1) return NULL;
+
+    SnapSlot *s = snapshot_slot(i);
+    memset(s, 0, slot_head() + game_storage_size(mode));
+    s->match_id = match_id;
+    s->bot_seat = bot_seat;
+    s->mode     = *mode;
+    return s;
+}
+
+void snapshot_release(SnapSlot *s) {
+    __atomic_store_n(&s->state, SNAP_FREE, __ATOMIC_RELEASE);
+    int i = (int)(((char *)s - map - SNAP_HEADER) / slot_size);
+    pthread_mutex_lock(&free_lock);
+    free_stack[free_top++] = i;
+    pthread_mutex_unlock(&free_lock);
+}
+
+void snapshot_sync(SnapSlot *s, const Game *g, const uint64_t *tokens) {
+    s->started = g->game_started;
+    s->turns   = g->turns;
+    s->forfeit = g->forfeit;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        const Player *p  = &g->players[i];
+        SnapPlayer   *sp = &s->players[i];
+        memcpy(sp->name, p->name, MAX_NAME_LEN);
+        sp->token       = tokens[i];
+        sp->joined      = p->joined;
+        sp->ready       = p->ready;
+        sp->active_turn = p->active_turn;
+    }
+    // o estado por último: uma fatia LIVE tem o resumo completo
+    __atomic_store_n(&s->state, g->game_over ? SNAP_FREE : SNAP_LIVE, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,70 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "battleship.h"
+
+// Snapshot das partidas em andamento num arquivo mapeado em memória (-S), para que um
+// servidor reiniciado retome as partidas em vez de perdê-las.
+//
+// O arquivo tem um cabeçalho e fatias de tamanho fixo (SNAP_SLOTS, ou as pedidas em -s),
+// uma por partida. Cada
+// fatia guarda um resumo (modo, nomes, sessões, fase, vez e turnos) e, logo depois, o
+// bloco de navios e índices que o Game usa diretamente (init_game_in): place_ship e
+// handle_fire escrevem no próprio mapeamento, sem cópia. Como os acertos entram no
+// arquivo na hora, o resumo é atualizado por snapshot_sync() depois de cada comando
+// aplicado, e não só no fim do lote: uma queda no meio do lote não deixa os acertos de
+// um tiro com a vez de antes dele. O que um cliente já viu está no arquivo.
+//
+// Protege contra a queda do processo (as páginas ficam no cache do kernel), não contra
+// a queda da máquina: não há msync no caminho das jogadas. O arquivo guarda os segredos
+// das sessões, então só o dono do processo o lê (0600).
+
+#define SNAP_SLOTS     4096      // fatias padrão
+#define SNAP_MAX_SLOTS (1 << 20)
+
+enum { SNAP_FREE, SNAP_LIVE };
+
+typedef struct {
+    char     name[MAX_NAME_LEN];
+    uint64_t token;          // segredo da sessão do RESUME; 0 no assento sem sessão
+    uint8_t  joined, ready, active_turn;
+} SnapPlayer;
+
+typedef struct {
+    uint32_t   state;        // SNAP_*; gravado por último
+    uint32_t   match_id;
+    int32_t    bot_seat;     // -1 em partida só de humanos
+    uint8_t    started;
+    uint32_t   turns;        // Game.turns
+    int32_t    forfeit;      // Game.forfeit
+    GameMode   mode;
+    SnapPlayer players[MAX_CLIENTS];
+} SnapSlot;
+
+// Mapeia path (criando ou recriando se for de outro formato) com pelo menos slots fatias
+// que comportam todos os modos; um arquivo com mais fatias continua com todas. false em
+// erro de E/S
+bool snapshot_open(const char *path, const GameMode *modes, int mode_count, int slots);
+void snapshot_close(void);
+
+// Partidas já numeradas por esta execução e pelas anteriores, inclusive as encerradas
+// (0 se desligado ou arquivo novo); o lobby continua a numeração daí
+uint64_t  snapshot_match_seq(void);
+// Registra que seq partidas já foram numeradas (qualquer thread)
+void      snapshot_set_match_seq(uint64_t seq);
+
+// Fatias gravadas; as SNAP_LIVE deixadas pela execução anterior devem ser retomadas
+int       snapshot_slot_count(void);
+SnapSlot *snapshot_slot(int i);
+// Bloco do Game dentro da fatia (game_storage_size do modo, já zerado na reserva)
+void     *snapshot_storage(SnapSlot *s);
+
+// Reserva uma fatia para a partida (qualquer thread); NULL se desligado ou sem fatia livre
+SnapSlot *snapshot_alloc(uint32_t match_id, const GameMode *mode, int bot_seat);
+void      snapshot_release(SnapSlot *s);
+// Copia o resumo da partida para a fatia; partida encerrada libera a fatia para retomada
+void      snapshot_sync(SnapSlot *s, const Game *g, const uint64_t *tokens);
+
+#endif // SNAPSHOT_H
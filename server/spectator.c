@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+#include "spectator.h"
+#include "metrics.h"
+
+static SharedBuf *shared_new(const void *buf, size_t len) {
+    SharedBuf *b = malloc(sizeof(*b) + len);
+    if (!b) return NULL;
+    b->refs = 0;
+    b->len  = len;
+    memcpy(b->data, buf, len);
+    return b;
+}
+
+static void shared_release(SharedBuf *b) {
+    if (--b->refs == 0) free(b);
+}
+
+static void spectator_enqueue(Spectator *s, SharedBuf *b) {
+    if (s->overflow) return;
+    if (s->tail - s->head == SPECTATOR_QUEUE) {
+        s->overflow = true;
+        return;
+    }
+    b->refs++;
+    s->queue[s->tail++ & (SPECTATOR_QUEUE - 1)] = b;
+}
+
+bool audience_add(Audience **a, Spectator *s) {
+    if (!*a && !(*a = calloc(1, sizeof(**a)))) return false;
+    Audience *au = *a;
+    if (au->count == au->cap) {
+        int cap = au->cap ? au->cap * 2 : 8;
+        Spectator **list = realloc(au->list, cap * sizeof(*list));
+        if (!list) return false;
+        au->list = list;
+        au->cap  = cap;
+    }
+    au->list[au->count++] = s;
+    if (s->binary) au->binary++;
+    return true;
+}
+
+void audience_remove(Audience *a, Spectator *s) {
+    if (!a) return;
+    for (int i = 0; i < a->count; i++) {
+        if (a->list[i] == s) {
+            a->list[i] = a->list[--a->count];
+            if (s->binary) a->binary--;
+            return;
+        }
+    }
+}
+
+void audience_free(Audience *a) {
+    if (!a) return;
+    free(a->list);
+    free(a);
+}
+
+void audience_publish(Audience *a, const char *msg, const uint8_t *frame, size_t len) {
+    if (!a || a->count == 0) return;
+    // uma cópia por formato, não por espectador
+    SharedBuf *text = (msg && a->count > a->binary) ? shared_new(msg, strlen(msg)) : NULL;
+    SharedBuf *bin  = (frame && a->binary > 0)      ? shared_new(frame, len)       : NULL;
+
+    for (int i = 0; i < a->count; i++) {
+        Spectator *s = a->list[i];
+        SharedBuf *b = s->binary ? bin : text;
+        if (b) spectator_enqueue(s, b);
+    }
+    // ninguém ficou com o buffer (todas as filas cheias)
+    if (text && text->refs == 0) free(text);
+    if (bin && bin->refs == 0)   free(bin);
+}
+
+void spectator_push(Spectator *s, const void *buf, size_t len) {
+    SharedBuf *b = shared_new(buf, len);
+    if (!b) {
+        s->overflow = true;
+        return;
+    }
+    spectator_enqueue(s, b);
+    if (b->refs == 0) free(b);
+}
+
+int spectator_flush(Spectator *s) {
+    while (spectator_pending(s)) {
+        struct iovec iov[SPECTATOR_IOV];
+        int n = 0;
+        size_t want = 0;
+        for (unsigned i = s->head; i != s->tail && n < SPECTATOR_IOV; i++, n++) {
+            SharedBuf *b  = s->queue[i & (SPECTATOR_QUEUE - 1)];
+            size_t    off = (n == 0) ? s->offset : 0;
+            iov[n].iov_base = b->data + off;
+            iov[n].iov_len  = b->len - off;
+            want += iov[n].iov_len;
+        }
+
+        uint64_t start = metrics_clock();
+        ssize_t sent = writev(s->fd, iov, n);
+        bool failed = sent < 0 && errno != EAGAIN && errno != EINTR;
+        if (metrics_on) metrics_send(sent > 0 ? (size_t)sent : 0, start, failed);
+        if (failed) return -1;
+        if (sent <= 0) return 0;
+
+        // solta os buffers enviados por inteiro; o último pode ter ficado pela metade
+        size_t left = (size_t)sent;
+        while (left > 0) {
+            SharedBuf *b    = s->queue[s->head & (SPECTATOR_QUEUE - 1)];
+            size_t     rest = b->len - s->offset;
+            if (left < rest) {
+                s->offset += left;
+                break;
+            }
+            left     -= rest;
+            s->offset = 0;
+            s->head++;
+            shared_release(b);
+        }
+        if ((size_t)sent < want) return 0;  // o kernel não aceitou tudo
+    }
+    return 1;
+}
+
+void spectator_clear(Spectator *s) {
+    while (spectator_pending(s)) {
+        shared_release(s->queue[s->head++ & (SPECTATOR_QUEUE - 1)]);
+    }
+    s->offset = 0;
+}
@@ -0,0 +1,61 @@
+#ifndef SPECTATOR_H
+#define SPECTATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Espectadores de uma partida: recebem só os eventos públicos (modo, READY, turnos,
+// tiros e resultado), nunca as posições dos navios.
+//
+// Cada evento é formatado uma única vez num SharedBuf com contagem de referências (um
+// para o texto e outro para o quadro binário) e a fila de cada espectador guarda apenas
+// ponteiros para esses buffers; o envio é um writev direto deles. Com N espectadores um
+// evento custa N ponteiros enfileirados, sem cópia nem formatação por espectador.
+//
+// Só o shard dono da partida toca nestas estruturas, então as contagens são simples.
+
+#define SPECTATOR_QUEUE 1024   // eventos pendentes por espectador (potência de 2)
+#define SPECTATOR_IOV   64     // buffers por writev
+
+typedef struct SharedBuf {
+    unsigned refs;
+    size_t   len;
+    char     data[];
+} SharedBuf;
+
+typedef struct Spectator {
+    int        fd;
+    bool       binary;      // recebe os quadros binários em vez do texto
+    bool       overflow;    // fila cheia: o espectador não lê e deve ser desconectado
+    void      *owner;       // conexão do servidor dona deste espectador
+    unsigned   head, tail;  // posições lógicas em queue
+    size_t     offset;      // bytes do buffer da cabeça já enviados
+    SharedBuf *queue[SPECTATOR_QUEUE];
+} Spectator;
+
+// Plateia de uma partida (Game.audience); criada no primeiro espectador
+typedef struct Audience {
+    Spectator **list;
+    int         count, cap;
+    int         binary;     // quantos da lista são binários
+} Audience;
+
+static inline bool spectator_pending(const Spectator *s) {
+    return s->head != s->tail;
+}
+
+bool audience_add(Audience **a, Spectator *s);
+void audience_remove(Audience *a, Spectator *s);
+void audience_free(Audience *a);
+// Enfileira o evento para todos: msg para os de texto, frame (pode ser NULL) para os binários
+void audience_publish(Audience *a, const char *msg, const uint8_t *frame, size_t len);
+
+// Enfileira uma mensagem só para este espectador (ex.: o resumo ao entrar)
+void spectator_push(Spectator *s, const void *buf, size_t len);
+// Envia o pendente com um writev; 1 se esvaziou, 0 se sobrou (EAGAIN), -1 em erro
+int  spectator_flush(Spectator *s);
+// Solta as referências ainda na fila
+void spectator_clear(Spectator *s);
+
+#endif // SPECTATOR_H
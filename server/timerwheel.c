@@ -0,0 +1,109 @@
+#include <stddef.h>
+
+#include "timerwheel.h"
+
+#define TW_MASK     (TW_SLOTS - 1)
+#define TW_SPAN     ((uint64_t)1 << (TW_BITS * TW_LEVELS))   // ticks alcançados pela roda
+
+static inline void list_init(TimerLink *head) {
+    head->prev = head->next = head;
+}
+
+static inline bool list_empty(const TimerLink *head) {
+    return head->next == head;
+}
+
+static inline void list_add_tail(TimerLink *head, TimerLink *l) {
+    l->prev = head->prev;
+    l->next = head;
+    head->prev->next = l;
+    head->prev = l;
+}
+
+static inline void list_del(TimerLink *l) {
+    l->prev->next = l->next;
+    l->next->prev = l->prev;
+    l->prev = l->next = NULL;
+}
+
+void timer_wheel_init(TimerWheel *w, uint64_t now_us) {
+    w->tick    = now_us / TW_TICK_US;
+    w->pending = 0;
+    for (int l = 0; l < TW_LEVELS; l++) {
+        for (unsigned i = 0; i < TW_SLOTS; i++) list_init(&w->slots[l][i]);
+    }
+    list_init(&w->expired);
+}
+
+// Posição de t pela distância entre o vencimento e o tick atual
+static void wheel_insert(TimerWheel *w, Timer *t) {
+    uint64_t delta = t->expires - w->tick;
+    int level = 0;
+    while (level < TW_LEVELS - 1 && delta >= ((uint64_t)1 << (TW_BITS * (level + 1)))) level++;
+    list_add_tail(&w->slots[level][(t->expires >> (TW_BITS * level)) & TW_MASK], &t->link);
+}
+
+void timer_arm(TimerWheel *w, Timer *t, int kind, uint64_t when_us) {
+    if (timer_armed(t)) list_del(&t->link);
+    else                w->pending++;
+    uint64_t expires = (when_us + TW_TICK_US - 1) / TW_TICK_US;
+    if (expires <= w->tick)          expires = w->tick + 1;
+    if (expires - w->tick >= TW_SPAN) expires = w->tick + TW_SPAN - 1;
+    t->expires = expires;
+    t->kind    = kind;
+    wheel_insert(w, t);
+}
+
+void timer_cancel(TimerWheel *w, Timer *t) {
+    if (!timer_armed(t)) return;
+    list_del(&t->link);
+    w->pending--;
+}
+
+// Redistribui a posição do nível pelos níveis de baixo
+static void cascade(TimerWheel *w, int level) {
+    TimerLink *head = &w->slots[level][(w->tick >> (TW_BITS * level)) & TW_MASK];
+    while (!list_empty(head)) {
+        Timer *t = (Timer *)head->next;
+        list_del(&t->link);
+        wheel_insert(w, t);
+    }
+}
+
+// Avança tick a tick até now_us, passando o que vence para a lista de vencidos
+static void wheel_advance(TimerWheel *w, uint64_t now_us) {
+    uint64_t target = now_us / TW_TICK_US;
+    while (w->tick < target && w->pending > 0) {
+        w->tick++;
+        for (int l = 1; l < TW_LEVELS && (w->tick & (((uint64_t)1 << (TW_BITS * l)) - 1)) == 0; l++) {
+            cascade(w, l);
+        }
+        TimerLink *head = &w->slots[0][w->tick & TW_MASK];
+        while (!list_empty(head)) {
+            TimerLink *l = head->next;
+            list_del(l);
+            list_add_tail(&w->expired, l);
+        }
+    }
+    if (w->tick < target) w->tick = target;  // roda vazia: só acompanha o relógio
+}
+
+Timer *timer_expire(TimerWheel *w, uint64_t now_us) {
+    if (list_empty(&w->expired)) wheel_advance(w, now_us);
+    if (list_empty(&w->expired)) return NULL;
+    Timer *t = (Timer *)w->expired.next;
+    list_del(&t->link);
+    w->pending--;
+    return t;
+}
+
+uint64_t timer_wheel_next(const TimerWheel *w) {
+    if (w->pending == 0) return UINT64_MAX;
+    if (!list_empty(&w->expired)) return w->tick * TW_TICK_US;
+    // no nível 0 só há vencimentos da próxima volta; uma cascata no caminho pode trazer
+    // algo dos níveis de cima, então ela também acorda a thread
+    for (uint64_t t = w->tick + 1; t <= w->tick + TW_SLOTS; t++) {
+        if (!list_empty(&w->slots[0][t & TW_MASK]) || (t & TW_MASK) == 0) return t * TW_TICK_US;
+    }
+    return (w->tick + TW_SLOTS) * TW_TICK_US;
+}
@@ -0,0 +1,57 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Roda de temporizadores hierárquica: cada thread (lobby e shards) tem a sua, sem lock.
+// Os temporizadores ficam embutidos no que eles vigiam (partida, conexão), então armar e
+// cancelar é só ligar e desligar de uma lista: O(1) e sem alocação, com qualquer número
+// de partidas.
+//
+// A roda tem TW_LEVELS níveis de TW_SLOTS posições. O nível 0 tem uma posição por tick;
+// cada nível acima cobre a volta inteira do anterior por posição. Um prazo entra no nível
+// que alcança a distância até ele e desce de nível (cascata) quando a volta de baixo chega
+// à posição dele. Prazos além da última volta (~46 h) ficam no fim dela.
+
+#define TW_TICK_US  10000u   // resolução: 10 ms
+#define TW_BITS     6
+#define TW_SLOTS    (1u << TW_BITS)
+#define TW_LEVELS   4
+
+typedef struct TimerLink {
+    struct TimerLink *prev, *next;
+} TimerLink;
+
+// Temporizador embutido; quem vence volta pelo timer_expire() e o dono o acha pelo kind
+// e por container_of
+typedef struct {
+    TimerLink link;         // NULL em link.next: desarmado
+    uint64_t  expires;      // tick do vencimento
+    int       kind;         // definido pelo dono
+} Timer;
+
+typedef struct {
+    uint64_t  tick;                        // último tick já processado
+    unsigned  pending;                     // temporizadores armados (inclui os vencidos)
+    TimerLink slots[TW_LEVELS][TW_SLOTS];
+    TimerLink expired;                     // vencidos ainda não entregues
+} TimerWheel;
+
+void timer_wheel_init(TimerWheel *w, uint64_t now_us);
+
+static inline bool timer_armed(const Timer *t) {
+    return t->link.next != NULL;
+}
+
+// Arma (ou rearma) t para vencer em when_us, arredondado para o tick seguinte
+void timer_arm(TimerWheel *w, Timer *t, int kind, uint64_t when_us);
+// Desarma t; não faz nada se ele não está armado
+void timer_cancel(TimerWheel *w, Timer *t);
+// Próximo temporizador vencido até now_us, já desarmado; NULL quando não há mais.
+// Os handlers podem armar e cancelar outros, inclusive os que venceram junto.
+Timer *timer_expire(TimerWheel *w, uint64_t now_us);
+// Instante (us) até o qual nada vence; UINT64_MAX se a roda está vazia
+uint64_t timer_wheel_next(const TimerWheel *w);
+
+#endif // TIMERWHEEL_H
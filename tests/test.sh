@@ -18,15 +18,23 @@ cleanup_port
 
 #compila tudo
 echo "[test] compilando servidor e cliente"
-make -s server
-make -s client
+make -s battleserver
+make -s battleclient
+make -s battlereplay
+make -s battleload
+make -s battlelog
 
 #inicia o servidor em backgound
 echo "[test] iniciando servidor..."
-rm -f tests/server.log
+rm -f tests/server.log game_log.txt
 ./server/battleserver > tests/server.log 2>&1 &
 SERVER_PID=$!
-sleep 1
+
+#espera a porta aceitar conexões em vez de um tempo fixo
+for _ in $(seq 50); do
+    (exec 3<>/dev/tcp/127.0.0.1/8080) 2>/dev/null && break
+    sleep 0.1
+done
 
 #prepara os comandos se não existirem
 cat > tests/client1_commands.txt << 'EOF'
@@ -63,42 +71,35 @@ FIRE 3 2
 FIRE 4 1
 EOF
 
-# inicia os dois clientes, fazendo o passeio por 1 segundo entre as linhas
-echo "[test] iniciando cliente 1..."
-> tests/client1.log
-(
-  while IFS= read -r cmd; do
-    echo "$cmd"
-    sleep 1
-  done < tests/client1_commands.txt
-) | timeout 60 ./client/battleclient > tests/client1.log 2>&1 &
+# inicia os dois clientes no modo script: cada comando só espera a resposta de que
+# precisa (FIRE espera a vez), e o código de saída diz quem venceu (0) e quem perdeu (1)
+echo "[test] iniciando clientes..."
+set +e
+./client/battleclient --script tests/client1_commands.txt > tests/client1.log 2>&1 &
 CLIENT1_PID=$!
-
-echo "[test] iniciando cliente 2..."
-> tests/client2.log
-(
-  while IFS= read -r cmd; do
-    echo "$cmd"
-    sleep 1
-  done < tests/client2_commands.txt
-) | timeout 60 ./client/battleclient > tests/client2.log 2>&1 &
+./client/battleclient --script tests/client2_commands.txt > tests/client2.log 2>&1 &
 CLIENT2_PID=$!
 
 #espera ambos os clientes terminarem
 echo "[test] aguardando clientes terminarem..."
-wait $CLIENT1_PID
-wait $CLIENT2_PID
-echo "[test] clientes finalizaram"
+wait $CLIENT1_PID; CLIENT1_STATUS=$?
+wait $CLIENT2_PID; CLIENT2_STATUS=$?
+set -e
+echo "[test] clientes finalizaram (saída $CLIENT1_STATUS e $CLIENT2_STATUS)"
+grep -h "^\[SCRIPT\] ida e volta" tests/client1.log tests/client2.log || true
 
 # para o servidor silenciando erro se já saiu
 kill $SERVER_PID 2>/dev/null || true
+wait $SERVER_PID 2>/dev/null || true
 
 #verifica a vitoria/derrota nos logs
 echo "[test] analisando resultados..."
-if grep -E "WINS|GANHOU|VENCEU" tests/client1.log \
+if [ "$CLIENT1_STATUS" -eq 0 ] && [ "$CLIENT2_STATUS" -eq 1 ] \
+   && grep -E "WINS|GANHOU|VENCEU" tests/client1.log \
    && grep -E "LOSES|PERDEU" tests/client2.log; then
     echo "[test] ✓ Player 1 venceu como esperado"
-elif grep -E "WINS|GANHOU|VENCEU" tests/client2.log \
+elif [ "$CLIENT2_STATUS" -eq 0 ] && [ "$CLIENT1_STATUS" -eq 1 ] \
+   && grep -E "WINS|GANHOU|VENCEU" tests/client2.log \
    && grep -E "LOSES|PERDEU" tests/client1.log; then
     echo "[test] ✓ Player 2 venceu como esperado"
 else
@@ -113,4 +114,431 @@ else
     exit 1
 fi
 
+#reproduz o log gravado pelo servidor e confere o vencedor com a linha RESULTADO
+echo "[test] reproduzindo os logs das partidas..."
+if ! ./tools/battlereplay game_log.txt game_log_example.txt; then
+    echo "[test] ✗ Replay divergiu do log gravado"
+    exit 1
+fi
+
+# ---------------------------------------------------------------------------
+# Cenários com o servidor reiniciado para cada um
+# ---------------------------------------------------------------------------
+
+fail() {
+    echo "[test] ✗ $1"
+    stop_server
+    echo "---- servidor ----"
+    cat tests/server.log
+    exit 1
+}
+
+# start_server [opções...]: sobe o servidor e espera a porta aceitar conexões
+start_server() {
+    (without_conns ./server/battleserver "$@") > tests/server.log 2>&1 &
+    SERVER_PID=$!
+    for _ in $(seq 50); do
+        (exec 3<>/dev/tcp/127.0.0.1/8080) 2>/dev/null && return 0
+        sleep 0.1
+    done
+    fail "servidor não abriu a porta"
+}
+
+stop_server() {
+    kill $SERVER_PID 2>/dev/null || true
+    wait $SERVER_PID 2>/dev/null || true
+}
+
+# Conexões cruas pelo /dev/tcp do bash: open_conn NOME abre uma conexão e copia tudo
+# que chega nela para tests/NOME.log; send NOME linha... envia linhas de texto
+declare -A CONN_FD CONN_CAT
+# without_conns CMD...: troca o subshell por CMD sem as conexões cruas abertas, para que
+# fechar uma conexão no teste a feche de verdade
+without_conns() {
+    local fd
+    for fd in "${CONN_FD[@]}"; do exec {fd}>&-; done
+    exec "$@"
+}
+open_conn() {
+    local fd
+    exec {fd}<>/dev/tcp/127.0.0.1/8080
+    CONN_FD[$1]=$fd
+    (exec <&$fd; without_conns cat) > tests/$1.log &
+    CONN_CAT[$1]=$!
+}
+send() {
+    local name=$1
+    shift
+    printf '%s\n' "$@" >&${CONN_FD[$name]}
+}
+close_conn() {
+    local fd=${CONN_FD[$1]}
+    kill ${CONN_CAT[$1]} 2>/dev/null || true
+    wait ${CONN_CAT[$1]} 2>/dev/null || true
+    exec {fd}>&-
+    unset "CONN_FD[$1]"
+}
+# wait_closed NOME: espera o servidor fechar a conexão (o cat dela termina no EOF)
+wait_closed() {
+    for _ in $(seq 50); do
+        kill -0 ${CONN_CAT[$1]} 2>/dev/null || return 0
+        sleep 0.1
+    done
+    fail "servidor não fechou a conexão $1"
+}
+# wait_for ARQUIVO PADRÃO [segundos]: espera o padrão aparecer no arquivo
+wait_for() {
+    for _ in $(seq $(( ${3:-5} * 10 ))); do
+        grep -q -- "$2" "$1" 2>/dev/null && return 0
+        sleep 0.1
+    done
+    fail "esperava '$2' em $1"
+}
+
+# duas partidas ao mesmo tempo: as linhas se intercalam no game_log.txt e o replay
+# separa cada uma pela marca [partida N]
+echo "[test] duas partidas simultâneas e replay do log compartilhado..."
+rm -f game_log.txt
+start_server
+set +e
+pids=()
+for i in 1 2 3 4; do
+    ./client/battleclient --script tests/client$(( (i - 1) % 2 + 1 ))_commands.txt \
+        > tests/concurrent$i.log 2>&1 &
+    pids+=($!)
+done
+wins=0
+for pid in "${pids[@]}"; do
+    wait $pid
+    [ $? -eq 0 ] && wins=$((wins + 1))
+done
+set -e
+stop_server
+[ $wins -eq 2 ] || fail "esperava 2 vitórias em 2 partidas, houve $wins"
+grep -q "^\[partida 2\] PLAYER" game_log.txt || fail "linhas da partida 2 sem marca no log"
+./tools/battlereplay game_log.txt | tee tests/replay.log
+grep -q "2 partida(s): 2 conferem" tests/replay.log || fail "replay não separou as duas partidas"
+
+# nomes com espaço ou bytes de controle são recusados; o protocolo binário joga uma
+# partida inteira e o replay confere o log gravado a partir dos quadros. O servidor
+# reiniciado continua o game_log.txt: a partida 1 dele vem depois das duas anteriores
+echo "[test] nomes inválidos, partida no protocolo binário e log continuado..."
+start_server
+open_conn bad
+send bad $'JOIN a\x01b'
+wait_for tests/bad.log "Formato inválido"
+close_conn bad
+./tools/battleload -n 2 -g 1 > tests/load.log 2>&1 || fail "battleload falhou"
+grep -q "erros do servidor=0 conexões perdidas=0" tests/load.log || fail "erros na partida binária"
+stop_server
+[ "$(grep -c "^=== NOVO JOGO INICIADO ===" game_log.txt)" = 2 ] || fail "execução nova sem cabeçalho no log"
+./tools/battlereplay game_log.txt > tests/replay.log
+grep -q "3 partida(s): 3 conferem" tests/replay.log || fail "replay da partida binária divergiu"
+
+# log binário (-G): o battlelog lista a partida pelo índice, mostra um turno dela e a
+# converte em texto que o battlereplay confere. Um servidor reiniciado com o mesmo
+# arquivo continua o log: o segmento cortado no fim é descartado, a partida antiga
+# segue listada e a nova, com o mesmo id, fica em outra execução
+echo "[test] log binário, battlelog e reinício com o mesmo arquivo..."
+rm -rf tests/partidas.blog tests/blog
+start_server -G tests/partidas.blog
+./tools/battleload -n 2 -g 1 > tests/load.log 2>&1 || fail "battleload falhou"
+stop_server
+./tools/battlelog tests/partidas.blog > tests/blog.log
+grep -q "^EXECUÇÃO 1 PARTIDA 1: .* PLAYER [12] venceu" tests/blog.log || fail "partida fora do índice do log binário"
+./tools/battlelog -m 1 -T 1 tests/partidas.blog > tests/blog.log
+grep -q "^--- TURNO DO PLAYER [12] (carga[0-9]) ---" tests/blog.log || fail "battlelog -T sem o turno"
+grep -q "TURNO DO PLAYER" <(grep -v "^$" tests/blog.log | tail -n +2) && fail "battlelog -T trouxe outro turno"
+./tools/battlelog -o tests/blog tests/partidas.blog > /dev/null || fail "battlelog -o falhou"
+./tools/battlereplay tests/blog > tests/replay.log
+grep -q "1 partida(s): 1 conferem" tests/replay.log || fail "replay do log convertido divergiu"
+printf 'segmento cortado' >> tests/partidas.blog
+start_server -G tests/partidas.blog
+./tools/battleload -n 2 -g 1 > tests/load.log 2>&1 || fail "battleload falhou"
+stop_server
+grep -q "descartando 16 bytes" tests/server.log || fail "segmento incompleto não descartado"
+./tools/battlelog tests/partidas.blog > tests/blog.log
+grep -q "^EXECUÇÃO 1 PARTIDA 1: .* venceu" tests/blog.log || fail "reinício apagou a partida anterior do log binário"
+grep -q "^EXECUÇÃO 2 PARTIDA 1: .* venceu" tests/blog.log || fail "partida da segunda execução fora do log binário"
+grep -q "2 partida(s)" tests/blog.log || fail "partidas de execuções diferentes misturadas"
+rm -rf tests/partidas.blog tests/blog
+
+# com um segmento por partida, 150 partidas passam de dois checkpoints: o índice sai
+# deles mesmo com o rodapé do primeiro segmento estragado, que o leitor não lê mais
+echo "[test] checkpoints do índice do log binário..."
+start_server -G tests/partidas.blog -F 1
+./tools/battleload -n 2 -g 150 > tests/load.log 2>&1 || fail "battleload falhou"
+stop_server
+[ "$(grep -c "BLCP" -a tests/partidas.blog)" -ge 1 ] || fail "log binário sem checkpoint"
+first=$(grep -obUa "BLTR" tests/partidas.blog | head -1 | cut -d: -f1)
+printf 'XXXX' | dd of=tests/partidas.blog bs=1 seek="$first" conv=notrunc 2> /dev/null
+./tools/battlelog tests/partidas.blog > tests/blog.log
+grep -q "^\[LOG\] 150 partida(s)" tests/blog.log || fail "índice não veio dos checkpoints"
+rm -rf tests/partidas.blog
+
+# session NOME: sessão do RESUME anunciada na conexão
+session() {
+    wait_for tests/$1.log "=== SESSÃO [0-9a-f]"
+    grep -o "SESSÃO [0-9a-f]\{24\}" tests/$1.log | head -1 | cut -d' ' -f2
+}
+
+# os dois jogadores caem e voltam com RESUME; numa partida com bot, o humano cai e volta
+echo "[test] RESUME depois da desconexão..."
+start_server -b 1
+open_conn p1
+open_conn p2
+send p1 "JOIN A"
+send p2 "JOIN B"
+tok1=$(session p1)
+tok2=$(session p2)
+close_conn p1
+close_conn p2
+sleep 0.2
+# o id da partida certo não basta: o segredo tem de ser o do assento
+open_conn bad
+send bad "RESUME ${tok1:0:8}0000000000000001"
+wait_for tests/bad.log "Sessão inválida"
+close_conn bad
+open_conn r1
+open_conn r2
+send r1 "RESUME $tok1"
+send r2 "RESUME $tok2"
+wait_for tests/r1.log "SESSÃO RETOMADA: A"
+wait_for tests/r2.log "SESSÃO RETOMADA: B"
+close_conn r1
+close_conn r2
+open_conn solo
+send solo "JOIN S"
+tok=$(session solo)
+close_conn solo
+sleep 0.2
+open_conn back
+send back "RESUME $tok"
+wait_for tests/back.log "SESSÃO RETOMADA: S"
+close_conn back
+stop_server
+
+# com -S a partida sobrevive a um kill -9 do servidor e os jogadores voltam com RESUME.
+# A partida 2 termina antes da queda: a primeira partida nova depois dela é a 3, e o
+# log da 2 continua inteiro
+echo "[test] partida retomada do snapshot depois de derrubar o servidor..."
+rm -rf tests/partidas.snap tests/snaplogs
+start_server -S tests/partidas.snap -L tests/snaplogs
+open_conn p1
+open_conn p2
+send p1 "JOIN A"
+send p2 "JOIN B"
+tok1=$(session p1)
+tok2=$(session p2)
+mapfile -t fleet < <(sed -n 2,6p tests/client1_commands.txt)
+send p1 "${fleet[@]}"
+send p2 "${fleet[@]}"
+wait_for tests/p1.log "TURNO DO PLAYER"
+set +e
+./client/battleclient --script tests/client1_commands.txt > tests/concurrent1.log 2>&1 &
+c1=$!
+./client/battleclient --script tests/client2_commands.txt > tests/concurrent2.log 2>&1 &
+c2=$!
+wait $c1; s1=$?
+wait $c2; s2=$?
+set -e
+[ $((s1 + s2)) -eq 1 ] || fail "partida 2 terminou com saídas $s1 e $s2"
+wait_for tests/snaplogs/partida_2.txt "RESULTADO"
+kill -9 $SERVER_PID
+wait $SERVER_PID 2>/dev/null || true
+close_conn p1
+close_conn p2
+start_server -S tests/partidas.snap -L tests/snaplogs
+open_conn r1
+open_conn r2
+send r1 "RESUME $tok1"
+send r2 "RESUME $tok2"
+wait_for tests/r1.log "SESSÃO RETOMADA: A"
+wait_for tests/r2.log "TURNO DO PLAYER"
+open_conn p3
+open_conn p4
+send p3 "JOIN C"
+send p4 "JOIN D"
+session p3 > /dev/null
+close_conn r1
+close_conn r2
+close_conn p3
+close_conn p4
+stop_server
+grep -q "Partida 3 criada" tests/server.log || fail "id de partida encerrada reaproveitado"
+grep -q "RESULTADO" tests/snaplogs/partida_2.txt || fail "log da partida 2 encerrada sobrescrito"
+[ "$(stat -c %a tests/partidas.snap)" = 600 ] || fail "snapshot com as sessões legível por outros"
+rm -rf tests/partidas.snap tests/snaplogs
+
+# com -s 1 a segunda partida simultânea fica fora do snapshot: aviso e métrica
+start_server -S tests/partidas.snap -s 1
+./tools/battleload -n 4 -g 2 > tests/load.log 2>&1 || fail "battleload falhou"
+stop_server
+grep -q "fatias estão ocupadas" tests/server.log || fail "sem aviso de snapshot cheio"
+grep -q "sem_snapshot=[1-9]" tests/server.log || fail "partida fora do snapshot não contada"
+rm -f tests/partidas.snap
+
+# o espectador recebe só os eventos públicos: nada de sessões, posições, prompts ou
+# erros dos jogadores (os FIRE fora da vez abaixo geram erros)
+echo "[test] espectador recebe só os eventos públicos..."
+start_server
+open_conn p1
+open_conn p2
+send p1 "JOIN A"
+send p2 "JOIN B"
+session p1 > /dev/null
+session p2 > /dev/null
+# id com lixo depois ou argumento a mais: erro de formato, não a partida 1
+open_conn bad
+send bad "WATCH 1abc"
+wait_for tests/bad.log "Use: WATCH"
+send bad "WATCH 1 x"
+for _ in $(seq 50); do
+    [ "$(grep -c "Use: WATCH" tests/bad.log)" -ge 2 ] && break
+    sleep 0.1
+done
+[ "$(grep -c "Use: WATCH" tests/bad.log)" -eq 2 ] || fail "WATCH mal formado aceito"
+close_conn bad
+open_conn w
+send w "WATCH 1"
+wait_for tests/w.log "ASSISTINDO"
+mapfile -t fleet < <(sed -n 2,6p tests/client1_commands.txt)
+mapfile -t shots < <(sed -n 7,14p tests/client1_commands.txt)
+send p1 "${fleet[@]}"
+send p2 "${fleet[@]}"
+wait_for tests/p1.log "TURNO DO PLAYER"
+send p1 "${shots[@]}"
+send p2 "${shots[@]}"
+wait_for tests/w.log "ATACOU"
+wait_for tests/p2.log "ERRO"
+close_conn p1
+close_conn p2
+close_conn w
+stop_server
+if grep -E "SESSÃO|VOCÊ|ERRO|navios\)|SUA VEZ" tests/w.log; then
+    fail "evento privado chegou ao espectador"
+fi
+
+# HANDOFF: um servidor novo assume a porta pelo socket de administração do antigo. O
+# antigo recusa quem esperava na fila, termina a partida dele e sai; a partida seguinte
+# já é jogada no novo
+echo "[test] atualização sem queda (HANDOFF)..."
+rm -f tests/admin.sock tests/admin2.sock
+start_server -A tests/admin.sock
+OLD_PID=$SERVER_PID
+open_conn p1
+open_conn p2
+send p1 "JOIN A"
+send p2 "JOIN B"
+session p1 > /dev/null
+session p2 > /dev/null
+open_conn q
+send q "JOIN Q"
+wait_for tests/q.log "AGUARDANDO"
+(without_conns ./server/battleserver -A tests/admin2.sock -H tests/admin.sock) \
+    > tests/server2.log 2>&1 &
+SERVER_PID=$!
+wait_for tests/q.log "Servidor em atualização"
+close_conn q
+send p1 "${fleet[@]}"
+send p2 "${fleet[@]}"
+wait_for tests/p1.log "TURNO DO PLAYER"
+close_conn p1
+close_conn p2
+set +e
+./client/battleclient --script tests/client1_commands.txt > tests/handoff1.log 2>&1 &
+h1=$!
+./client/battleclient --script tests/client2_commands.txt > tests/handoff2.log 2>&1 &
+h2=$!
+wait $h1; s1=$?
+wait $h2; s2=$?
+set -e
+[ $((s1 + s2)) -eq 1 ] || fail "partida no servidor novo terminou com saídas $s1 e $s2"
+for _ in $(seq 50); do
+    kill -0 $OLD_PID 2>/dev/null || break
+    sleep 0.1
+done
+kill -0 $OLD_PID 2>/dev/null && fail "servidor antigo não saiu depois de terminar as partidas"
+stop_server
+rm -f tests/admin.sock tests/admin2.sock
+
+# limites: com -I 3 a quarta conexão do mesmo endereço é fechada ao ser aceita (depois
+# de 1s, para a conexão de teste do start_server não contar) e erros demais derrubam a
+# conexão; com -R 2:1 a frota e o READY (6 comandos) levam mais de 2s
+echo "[test] limites de conexões, de erros e de comandos..."
+start_server -I 3
+sleep 1
+open_conn c1
+open_conn c2
+open_conn c3
+open_conn c4
+wait_closed c4
+close_conn c4
+send c3 "JOIN C"
+wait_for tests/c3.log "AGUARDANDO"
+# numa escrita só: o servidor fecha a conexão no meio e uma escrita depois daria SIGPIPE
+send c1 "$(printf 'FIRE 1 1\n%.0s' $(seq 40))"
+wait_for tests/c1.log "inválidos demais"
+wait_closed c1
+close_conn c1
+close_conn c2
+close_conn c3
+stop_server
+start_server -R 2:1
+open_conn p1
+open_conn p2
+send p1 "JOIN A"
+send p2 "JOIN B"
+session p1 > /dev/null
+session p2 > /dev/null
+start=$(date +%s%N)
+send p1 "${fleet[@]}"
+wait_for tests/p1.log "(A) ESTÁ PRONTO"
+elapsed=$(( ($(date +%s%N) - start) / 1000000 ))
+[ $elapsed -ge 2000 ] || fail "6 comandos com -R 2:1 levaram só ${elapsed}ms"
+close_conn p1
+close_conn p2
+stop_server
+
+# prazos (-T 1:2): na partida 1 ninguém atira e quem abre o fogo perde por W.O.; na 2
+# ninguém posiciona e ela termina sem vencedor. O replay confere as duas pelo log
+echo "[test] prazos da jogada e do posicionamento..."
+rm -f game_log.txt
+start_server -T 1:2
+open_conn p1
+open_conn p2
+send p1 "JOIN A"
+send p2 "JOIN B"
+session p1 > /dev/null
+session p2 > /dev/null
+send p1 "${fleet[@]}"
+send p2 "${fleet[@]}"
+open_conn p3
+open_conn p4
+send p3 "JOIN C"
+send p4 "JOIN D"
+wait_for tests/p1.log "TEMPO ESGOTADO: PLAYER 1 (.) PERDEU POR W.O."
+cat tests/p1.log tests/p2.log | grep -q "VOCÊ VENCEU" || fail "W.O. sem vencedor"
+wait_for tests/p3.log "TEMPO ESGOTADO"
+close_conn p1
+close_conn p2
+close_conn p3
+close_conn p4
+stop_server
+grep -q "^\[partida 1\] === TEMPO ESGOTADO" game_log.txt || fail "prazo da jogada fora do log"
+./tools/battlereplay game_log.txt > tests/replay.log
+grep -q "2 partida(s): 2 conferem" tests/replay.log || fail "replay dos prazos divergiu"
+
+# pool de partidas: 500 partidas seguidas reaproveitam os objetos devolvidos, então a
+# capacidade fica abaixo do total jogado, e nenhuma fica em uso depois do fim
+echo "[test] reaproveitamento do pool de partidas..."
+start_server
+./tools/battleload -n 2 -g 500 > tests/load.log 2>&1 || fail "battleload falhou"
+stop_server
+line=$(grep "^\[STATS\] memoria CLASSICO:" tests/server.log | tail -1)
+echo "$line"
+case "$line" in *" em_uso=0 "*) ;; *) fail "partidas ainda em uso no pool" ;; esac
+capacity=$(echo "$line" | sed 's/.*capacidade=\([0-9]*\).*/\1/')
+[ "$capacity" -gt 0 ] && [ "$capacity" -lt 500 ] || fail "pool não reaproveitou: capacidade=$capacity"
+
 echo "[test] todos os testes passaram!"
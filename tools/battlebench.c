@@ -0,0 +1,476 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "battleship.h"
+#include "../common/protocol.h"
+
+// Microbenchmarks das regras do jogo: cada caso roda isolado, sem sockets, com
+// aquecimento, várias repetições e contagem de alocações (malloc/calloc/realloc
+// embrulhados pelo linker, ver o alvo bench do Makefile).
+
+#define DEFAULT_RUNS      5
+#define DEFAULT_RUN_MS    50
+#define DEFAULT_THRESHOLD 10.0   // % acima do baseline que conta como regressão
+#define MAX_RESULTS       64
+#define MAX_SHOTS         (2 * MAX_FLEET_SHIPS * MAX_SHIP_LEN)
+
+// ---------------------------------------------------------------------------
+// Contagem de alocações (-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc)
+// ---------------------------------------------------------------------------
+
+static unsigned long alloc_count;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    alloc_count++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    alloc_count++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+    alloc_count++;
+    return __real_realloc(p, size);
+}
+
+// ---------------------------------------------------------------------------
+// Partida de referência
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    ShipType    type;
+    Coord       c;
+} Placement;
+
+// Estado compartilhado pelos casos: uma partida com as duas frotas posicionadas
+typedef struct {
+    const GameMode *mode;
+    Game        g;
+    Placement   fleet[MAX_FLEET_SHIPS];
+    int         fleet_len;
+    Coord       shots[MAX_SHOTS];      // células de navio intercaladas com água
+    int         shot_count;
+    Coord       water;                 // célula sem navio
+    char        pos_cmds[MAX_FLEET_SHIPS][64];
+    volatile long sink;                // impede o compilador de descartar resultados
+} Fixture;
+
+// Frota em fileiras a partir da linha 0, todos os navios na horizontal
+static void plan_fleet(Fixture *f) {
+    const GameMode *m = f->mode;
+    int x = 0, y = 0;
+    f->fleet_len = 0;
+    for (int k = 0; k < m->kind_count; k++) {
+        for (int n = 0; n < m->kinds[k].count; n++) {
+            if (y + m->kinds[k].size > m->height) { x++; y = 0; }
+            Placement *pl = &f->fleet[f->fleet_len];
+            pl->type = k;
+            pl->c    = (Coord){ x, y };
+            snprintf(f->pos_cmds[f->fleet_len], sizeof(f->pos_cmds[0]), "%s %s %d %d H",
+                     CMD_POS, m->kinds[k].name, x + 1, y + 1);
+            f->fleet_len++;
+            y += m->kinds[k].size;
+        }
+    }
+    f->water = (Coord){ m->width - 1, m->height - 1 };
+
+    // cada célula de navio seguida de uma célula de água da última linha
+    f->shot_count = 0;
+    for (int i = 0; i < f->fleet_len; i++) {
+        int size = m->kinds[f->fleet[i].type].size;
+        for (int s = 0; s < size; s++) {
+            int n = f->shot_count;
+            f->shots[n]     = (Coord){ f->fleet[i].c.x, f->fleet[i].c.y + s };
+            f->shots[n + 1] = (Coord){ m->width - 1, (n / 2) % m->height };
+            f->shot_count  += 2;
+        }
+    }
+}
+
+// Devolve o tabuleiro do jogador ao estado anterior ao primeiro POS
+static void reset_fleet(Player *p) {
+    p->ship_count       = 0;
+    p->ready            = false;
+    p->board.occupied   = 0;
+    p->board.hit        = 0;
+    p->board.live_cells = 0;
+    memset(p->ships, 0, (size_t)p->board.mode->total_ships * sizeof(Ship));
+    if (p->board.index) {
+        memset(p->board.index, 0, ((size_t)1 << p->board.index_bits) * sizeof(uint32_t));
+    }
+}
+
+// Desfaz os tiros: frotas intactas, jogo em andamento e vez do jogador 1
+static void reset_hits(Game *g) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Player *p = &g->players[i];
+        for (int s = 0; s < p->ship_count; s++) p->ships[s].hits = 0;
+        p->board.hit        = 0;
+        p->board.live_cells = g->mode->total_cells;
+    }
+    g->game_over = false;
+    g->players[0].active_turn = true;
+    g->players[1].active_turn = false;
+}
+
+static void place_fleet(Fixture *f, Player *p) {
+    for (int i = 0; i < f->fleet_len; i++) {
+        place_ship(p, f->fleet[i].type, f->fleet[i].c, HORIZONTAL);
+    }
+}
+
+static bool fixture_init(Fixture *f, const GameMode *mode) {
+    memset(f, 0, sizeof(*f));
+    f->mode = mode;
+    if (!init_game(&f->g, mode)) return false;
+    add_player(&f->g, -1);
+    add_player(&f->g, -1);
+    process_command(&f->g, &f->g.players[0], "JOIN bench1");
+    process_command(&f->g, &f->g.players[1], "JOIN bench2");
+    plan_fleet(f);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        place_fleet(f, &f->g.players[i]);
+        process_command(&f->g, &f->g.players[i], CMD_READY);
+    }
+    return f->g.game_started;
+}
+
+// ---------------------------------------------------------------------------
+// Casos
+// ---------------------------------------------------------------------------
+
+static void bench_can_place(Fixture *f, long iters) {
+    Player *p = &f->g.players[0];
+    int kinds = f->mode->kind_count;
+    long ok = 0;
+    // todos os navios menos o último: o caso típico de validar o próximo POS
+    reset_fleet(p);
+    for (int i = 0; i < f->fleet_len - 1; i++) {
+        place_ship(p, f->fleet[i].type, f->fleet[i].c, HORIZONTAL);
+    }
+    for (long i = 0; i < iters; i++) {
+        Coord c = { (int)(i % f->mode->width), (int)((i / 3) % f->mode->height) };
+        ok += can_place(p, (ShipType)(i % kinds), c, (i & 1) ? VERTICAL : HORIZONTAL);
+    }
+    reset_fleet(p);
+    place_fleet(f, p);
+    p->ready = true;
+    f->sink = ok;
+}
+
+static void bench_place_ship(Fixture *f, long iters) {
+    Player *p = &f->g.players[0];
+    int n = f->fleet_len;
+    long ok = 0;
+    reset_fleet(p);
+    for (long i = 0; i < iters; i++) {
+        int k = (int)(i % n);
+        if (k == 0) reset_fleet(p);
+        ok += place_ship(p, f->fleet[k].type, f->fleet[k].c, HORIZONTAL);
+    }
+    reset_fleet(p);
+    place_fleet(f, p);
+    p->ready = true;
+    f->sink = ok;
+}
+
+static void bench_handle_fire(Fixture *f, long iters) {
+    Player *p = &f->g.players[0];
+    reset_hits(&f->g);
+    for (long i = 0, s = 0; i < iters; i++) {
+        handle_fire(&f->g, p, f->shots[s]);
+        if (++s == f->shot_count || f->g.game_over) {
+            reset_hits(&f->g);
+            s = 0;
+        }
+    }
+    reset_hits(&f->g);
+}
+
+static void bench_check_winner(Fixture *f, long iters) {
+    Player *w, *l;
+    long wins = 0;
+    reset_hits(&f->g);
+    for (long i = 0; i < iters; i++) {
+        wins += check_winner(&f->g, &w, &l);
+    }
+    f->sink = wins;
+}
+
+static void bench_parse_ship_type(Fixture *f, long iters) {
+    const char *names[MAX_SHIP_KINDS + 1];
+    int n = 0;
+    for (int k = 0; k < f->mode->kind_count; k++) names[n++] = f->mode->kinds[k].name;
+    names[n++] = "INEXISTENTE";
+    long sum = 0;
+    for (long i = 0; i < iters; i++) {
+        sum += parse_ship_type(f->mode, names[i % n]);
+    }
+    f->sink = sum;
+}
+
+// Só o tokenizer: POS da frota e um FIRE, sem aplicar à partida
+static void bench_parse_command(Fixture *f, long iters) {
+    size_t lens[MAX_FLEET_SHIPS];
+    for (int k = 0; k < f->fleet_len; k++) lens[k] = strlen(f->pos_cmds[k]);
+    static const char fire[] = "FIRE 7 3";
+    long sum = 0;
+    for (long i = 0; i < iters; i++) {
+        Command cmd;
+        int k = (int)(i % (f->fleet_len + 1));
+        if (k == f->fleet_len) parse_command(fire, sizeof(fire) - 1, &cmd);
+        else                   parse_command(f->pos_cmds[k], lens[k], &cmd);
+        sum += cmd.kind + cmd.valid;
+    }
+    f->sink = sum;
+}
+
+// FIRE na água alternando os jogadores: parse + turno + handle_fire, sem fim de jogo
+static void bench_command_fire(Fixture *f, long iters) {
+    char cmd[32];
+    snprintf(cmd, sizeof(cmd), "%s %d %d", CMD_FIRE, f->water.x + 1, f->water.y + 1);
+    reset_hits(&f->g);
+    for (long i = 0; i < iters; i++) {
+        process_command(&f->g, &f->g.players[i & 1], cmd);
+    }
+    reset_hits(&f->g);
+}
+
+// POS da frota inteira em texto, recomeçando o posicionamento a cada volta
+static void bench_command_pos(Fixture *f, long iters) {
+    Player *p = &f->g.players[0];
+    bool started = f->g.game_started;
+    int n = f->fleet_len;
+    f->g.game_started = false;
+    reset_fleet(p);
+    for (long i = 0; i < iters; i++) {
+        int k = (int)(i % n);
+        if (k == 0) reset_fleet(p);
+        process_command(&f->g, p, f->pos_cmds[k]);
+    }
+    reset_fleet(p);
+    place_fleet(f, p);
+    p->ready = true;
+    f->g.game_started = started;
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(Fixture *f, long iters);
+} Bench;
+
+static const Bench benches[] = {
+    { "can_place",        bench_can_place },
+    { "place_ship",       bench_place_ship },
+    { "handle_fire",      bench_handle_fire },
+    { "check_winner",     bench_check_winner },
+    { "parse_ship_type",  bench_parse_ship_type },
+    { "parse_command",    bench_parse_command },
+    { "process_cmd_fire", bench_command_fire },
+    { "process_cmd_pos",  bench_command_pos },
+};
+#define BENCH_COUNT (int)(sizeof(benches) / sizeof(benches[0]))
+
+// ---------------------------------------------------------------------------
+// Execução, baseline e relatório
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    char   name[48];
+    char   mode[MAX_MODE_NAME];
+    double ns_op;          // mediana das repetições
+    double min_ns_op;
+    double allocs_op;
+} Result;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Aquece e calibra as iterações para cada repetição durar ~run_ms
+static void run_bench(const Bench *b, Fixture *f, int runs, int run_ms, Result *r) {
+    long iters = 1000;
+    for (;;) {
+        uint64_t t0 = now_ns();
+        b->run(f, iters);
+        uint64_t dt = now_ns() - t0;
+        if (dt >= (uint64_t)run_ms * 1000000u / 4 || iters > (1L << 34)) {
+            double per = (double)dt / (double)iters;
+            iters = per > 0 ? (long)((double)run_ms * 1e6 / per) : iters;
+            if (iters < 1) iters = 1;
+            break;
+        }
+        iters *= 4;
+    }
+
+    double samples[64];
+    if (runs > 64) runs = 64;
+    unsigned long allocs = 0;
+    for (int i = 0; i < runs; i++) {
+        unsigned long a0 = alloc_count;
+        uint64_t t0 = now_ns();
+        b->run(f, iters);
+        uint64_t dt = now_ns() - t0;
+        allocs += alloc_count - a0;
+        samples[i] = (double)dt / (double)iters;
+    }
+    qsort(samples, runs, sizeof(double), cmp_double);
+
+    snprintf(r->name, sizeof(r->name), "%s", b->name);
+    snprintf(r->mode, sizeof(r->mode), "%s", f->mode->name);
+    r->ns_op     = samples[runs / 2];
+    r->min_ns_op = samples[0];
+    r->allocs_op = (double)allocs / ((double)iters * runs);
+}
+
+// Linhas "nome modo ns/op allocs/op"
+static int load_baseline(const char *path, Result *out, int max) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+    int n = 0;
+    char line[256];
+    while (n < max && fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%47s %15s %lf %lf", out[n].name, out[n].mode,
+                   &out[n].ns_op, &out[n].allocs_op) == 4) n++;
+    }
+    fclose(fp);
+    return n;
+}
+
+static bool save_baseline(const char *path, const Result *res, int n) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        return false;
+    }
+    fprintf(fp, "# benchmark modo ns/op allocs/op\n");
+    for (int i = 0; i < n; i++) {
+        fprintf(fp, "%s %s %.3f %.4f\n", res[i].name, res[i].mode, res[i].ns_op, res[i].allocs_op);
+    }
+    fclose(fp);
+    return true;
+}
+
+static const Result *find_result(const Result *res, int n, const Result *key) {
+    for (int i = 0; i < n; i++) {
+        if (strcmp(res[i].name, key->name) == 0 && strcmp(res[i].mode, key->mode) == 0) {
+            return &res[i];
+        }
+    }
+    return NULL;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Uso: %s [-r repetições] [-t ms] [-o arquivo] [-b arquivo] [-T %%] [-M modo]... [filtro]\n"
+        "  -r repetições medidas por caso, reporta a mediana (padrão %d)\n"
+        "  -t ms         duração aproximada de cada repetição (padrão %d)\n"
+        "  -o arquivo    salva os resultados como baseline\n"
+        "  -b arquivo    compara com um baseline salvo; sai com 1 se houver regressão\n"
+        "  -T %%          piora tolerada em relação ao baseline (padrão %.0f%%)\n"
+        "  -M modo       mede também um modo NOME:LxA:TIPO=TAMxQTD[,...]\n"
+        "  filtro        roda só os casos cujo nome contém o texto\n",
+        prog, DEFAULT_RUNS, DEFAULT_RUN_MS, DEFAULT_THRESHOLD);
+}
+
+int main(int argc, char *argv[]) {
+    int runs = DEFAULT_RUNS, run_ms = DEFAULT_RUN_MS;
+    double threshold = DEFAULT_THRESHOLD;
+    const char *save_path = NULL, *base_path = NULL;
+    GameMode modes[MAX_MODES];
+    int mode_count = 0;
+    int opt;
+
+    modes[mode_count++] = *classic_game_mode();
+    parse_game_mode(EVENT_MODE_SPEC, &modes[mode_count++]);
+    while ((opt = getopt(argc, argv, "r:t:o:b:T:M:h")) != -1) {
+        switch (opt) {
+        case 'r': runs = atoi(optarg); break;
+        case 't': run_ms = atoi(optarg); break;
+        case 'o': save_path = optarg; break;
+        case 'b': base_path = optarg; break;
+        case 'T': threshold = atof(optarg); break;
+        case 'M':
+            if (mode_count == MAX_MODES || !parse_game_mode(optarg, &modes[mode_count])) {
+                fprintf(stderr, "Modo inválido: %s\n", optarg);
+                return 2;
+            }
+            mode_count++;
+            break;
+        default:  usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (runs < 1 || run_ms < 1 || threshold < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    const char *filter = optind < argc ? argv[optind] : NULL;
+
+    Result base[MAX_RESULTS];
+    int base_count = 0;
+    if (base_path && (base_count = load_baseline(base_path, base, MAX_RESULTS)) < 0) return 2;
+
+    static Fixture fixture;
+    Result results[MAX_RESULTS];
+    int count = 0;
+    int regressions = 0;
+
+    printf("%-18s %-10s %12s %12s %10s", "benchmark", "modo", "ns/op", "min ns/op", "allocs/op");
+    if (base_count) printf(" %12s %8s", "baseline", "delta");
+    printf("\n");
+
+    for (int m = 0; m < mode_count; m++) {
+        if (!fixture_init(&fixture, &modes[m])) {
+            fprintf(stderr, "Não foi possível montar a partida do modo %s\n", modes[m].name);
+            destroy_game(&fixture.g);
+            continue;
+        }
+        for (int b = 0; b < BENCH_COUNT && count < MAX_RESULTS; b++) {
+            if (filter && !strstr(benches[b].name, filter)) continue;
+            Result *r = &results[count++];
+            run_bench(&benches[b], &fixture, runs, run_ms, r);
+            printf("%-18s %-10s %12.2f %12.2f %10.2f", r->name, r->mode,
+                   r->ns_op, r->min_ns_op, r->allocs_op);
+
+            const Result *old = base_count ? find_result(base, base_count, r) : NULL;
+            if (old && old->ns_op > 0) {
+                double delta = (r->ns_op - old->ns_op) / old->ns_op * 100.0;
+                bool worse = delta > threshold || r->allocs_op > old->allocs_op + 1e-3;
+                printf(" %12.2f %+7.1f%%%s", old->ns_op, delta, worse ? "  REGRESSÃO" : "");
+                regressions += worse;
+            }
+            printf("\n");
+            fflush(stdout);
+        }
+        destroy_game(&fixture.g);
+    }
+
+    if (save_path && !save_baseline(save_path, results, count)) return 2;
+    if (base_count) {
+        printf("%d regressão(ões) acima de %.0f%% em relação a %s\n",
+               regressions, threshold, base_path);
+    }
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,654 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "../common/protocol.h"
+#include "../common/histogram.h"
+
+// Gerador de carga: muitos jogadores simulados, cada um jogando partidas completas pelo
+// protocolo binário com sockets não bloqueantes. Mede latências e partidas por segundo.
+
+#define SERVER_PORT       8080
+#define SERVER_IP         "127.0.0.1"
+#define DEFAULT_PLAYERS   100
+#define MAX_EVENTS        256
+#define OUT_CAP           4096    // frota inteira de POS + READY cabe de uma vez
+#define RANDOM_PLACE_MAX  65536   // células; acima disso a frota é posicionada em fileiras
+#define MAX_TARGETS       64
+#define DRAIN_GRACE_US    10000000u  // tempo extra para terminar partidas após -d
+
+enum { ST_IDLE, ST_CONNECTING, ST_HELLO, ST_PLAYING };
+enum { STRAT_SEQ, STRAT_RANDOM, STRAT_HUNT };
+
+static const char *strategy_names[] = { "seq", "random", "hunt" };
+
+typedef struct Worker Worker;
+
+// Um jogador simulado
+typedef struct {
+    Worker   *w;
+    int       fd;
+    int       state;
+    int       index;            // número do jogador (nome carga<index>)
+    int       id;               // 1 ou 2 na partida atual
+    int       strategy;         // STRAT_* desta partida
+    uint8_t   in[64];
+    int       inlen;
+    uint8_t   out[OUT_CAP];
+    int       outlen, outoff;
+    bool      want_out;         // EPOLLOUT registrado
+
+    // tabuleiro do adversário, do ponto de vista de quem atira
+    int       width, height;
+    uint32_t  cells;
+    uint32_t  fired;            // tiros já disparados (estratégia seq)
+    uint32_t  perm_next, perm_mask, perm_a, perm_c;  // permutação das células (random/hunt)
+    uint8_t  *marks;            // bitmap: ocupação ao posicionar, depois tiros (hunt)
+    size_t    marks_cap;
+    uint32_t  targets[MAX_TARGETS];
+    int       ntargets;
+
+    uint64_t  t_join, t_fire;
+    uint64_t  rng;
+} Sim;
+
+struct Worker {
+    int        id;
+    int        epfd;
+    pthread_t  tid;
+    Sim       *sims;
+    int        count;
+    int        active;
+
+    Histogram  join_match;      // JOIN -> OP_WELCOME (tempo no lobby)
+    Histogram  join_ready;      // JOIN -> OP_READIED do próprio jogador
+    Histogram  fire_shot;       // FIRE -> OP_SHOT do próprio tiro
+    unsigned long games, wins, shots, errors, dropped, failed;
+};
+
+static struct sockaddr_in server_addr;
+static int         players       = DEFAULT_PLAYERS;
+static int         thread_count  = 1;
+static int         total_games   = 0;     // 0: uma partida por par de jogadores
+static int         duration_secs = 0;     // > 0: joga até o prazo em vez de -g partidas
+static atomic_long joins_left;            // JOINs que ainda cabem em -g partidas
+static int         strategy      = STRAT_RANDOM;
+static const char *mode_name     = "";
+static uint64_t    seed          = 1;
+static uint64_t    deadline_us   = 0;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+// splitmix64: cada jogador tem sua própria sequência, reproduzível pela semente
+static uint64_t next_rand(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static bool mark_test(const Sim *s, uint32_t cell) {
+    return s->marks[cell >> 3] & (1u << (cell & 7));
+}
+
+static void mark_set(Sim *s, uint32_t cell) {
+    s->marks[cell >> 3] |= (uint8_t)(1u << (cell & 7));
+}
+
+// ---------------------------------------------------------------------------
+// Saída
+// ---------------------------------------------------------------------------
+
+static void sim_update_events(Sim *s) {
+    bool want = s->outoff < s->outlen;
+    if (want == s->want_out) return;
+    struct epoll_event ev = { .events = EPOLLIN | (want ? EPOLLOUT : 0), .data.ptr = s };
+    epoll_ctl(s->w->epfd, EPOLL_CTL_MOD, s->fd, &ev);
+    s->want_out = want;
+}
+
+static bool sim_flush(Sim *s) {
+    while (s->outoff < s->outlen) {
+        ssize_t n = send(s->fd, s->out + s->outoff, s->outlen - s->outoff,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) break;
+            return false;
+        }
+        s->outoff += (int)n;
+    }
+    if (s->outoff == s->outlen) s->outoff = s->outlen = 0;
+    sim_update_events(s);
+    return true;
+}
+
+static uint8_t *sim_reserve(Sim *s, int len) {
+    if (s->outlen + len > OUT_CAP) return NULL;
+    uint8_t *p = s->out + s->outlen;
+    s->outlen += len;
+    return p;
+}
+
+static void queue_pos(Sim *s, int kind, int x, int y, int vertical) {
+    uint8_t *f = sim_reserve(s, 7);
+    if (!f) return;
+    f[0] = OP_POS;
+    f[1] = (uint8_t)kind;
+    bin_put16(f + 2, (unsigned)x);
+    bin_put16(f + 4, (unsigned)y);
+    f[6] = (uint8_t)vertical;
+}
+
+// ---------------------------------------------------------------------------
+// Conexão e ciclo de partidas
+// ---------------------------------------------------------------------------
+
+static void sim_start(Sim *s);
+
+// Com -g os JOINs são um orçamento global: pares são formados pelo lobby em qualquer
+// combinação, então limitar por jogador poderia deixar alguém esperando sem adversário
+static bool sim_wants_more(void) {
+    if (duration_secs > 0) return now_us() < deadline_us;
+    return atomic_fetch_sub(&joins_left, 1) > 0;
+}
+
+static void sim_close(Sim *s) {
+    if (s->fd != -1) {
+        epoll_ctl(s->w->epfd, EPOLL_CTL_DEL, s->fd, NULL);
+        close(s->fd);
+        s->fd = -1;
+    }
+    s->state = ST_IDLE;
+    s->w->active--;
+}
+
+// Fim normal da partida: conta e, se for o caso, entra na fila de novo
+static void sim_finish(Sim *s) {
+    s->w->games++;
+    sim_close(s);
+    if (sim_wants_more()) sim_start(s);
+}
+
+// Conexão perdida ou recusada: o jogador para de jogar
+static void sim_fail(Sim *s, bool during_game) {
+    if (during_game) s->w->dropped++;
+    else             s->w->failed++;
+    sim_close(s);
+}
+
+static void sim_start(Sim *s) {
+    s->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (s->fd == -1) {
+        perror("socket");
+        s->w->failed++;
+        return;
+    }
+    int one = 1;
+    setsockopt(s->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    s->w->active++;
+    s->state  = ST_CONNECTING;
+    s->inlen  = s->outlen = s->outoff = 0;
+    s->id     = 0;
+    s->ntargets = 0;
+    if (connect(s->fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) == -1 &&
+        errno != EINPROGRESS)
+    {
+        sim_fail(s, false);
+        return;
+    }
+    struct epoll_event ev = { .events = EPOLLOUT, .data.ptr = s };
+    epoll_ctl(s->w->epfd, EPOLL_CTL_ADD, s->fd, &ev);
+    s->want_out = true;
+}
+
+static void sim_connected(Sim *s) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(s->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    if (err) {
+        sim_fail(s, false);
+        return;
+    }
+
+    uint8_t *f = sim_reserve(s, 3 + BIN_NAME_LEN + BIN_MODE_LEN);
+    if (!f) {
+        sim_fail(s, false);
+        return;
+    }
+    memset(f, 0, 3 + BIN_NAME_LEN + BIN_MODE_LEN);
+    f[0] = BIN_MAGIC;
+    f[1] = BIN_VERSION;
+    f[2] = OP_JOIN;
+    snprintf((char *)f + 3, BIN_NAME_LEN, "carga%d", s->index);
+    strncpy((char *)f + 3 + BIN_NAME_LEN, mode_name, BIN_MODE_LEN);
+    s->state  = ST_HELLO;
+    s->t_join = now_us();
+    if (!sim_flush(s)) sim_fail(s, false);
+}
+
+// ---------------------------------------------------------------------------
+// Posicionamento e tiros
+// ---------------------------------------------------------------------------
+
+// Frota em fileiras, da primeira linha para baixo; sempre cabe se couber no tabuleiro
+static bool place_packed(Sim *s, const uint8_t *sizes, const uint8_t *counts, int kinds) {
+    int x = 1, y = 1;
+    for (int k = 0; k < kinds; k++) {
+        for (int n = 0; n < counts[k]; n++) {
+            if (y + sizes[k] - 1 > s->height) { x++; y = 1; }
+            if (x > s->width || sizes[k] > s->height) return false;
+            queue_pos(s, k, x, y, 0);
+            y += sizes[k];
+        }
+    }
+    return true;
+}
+
+static bool place_random(Sim *s, const uint8_t *sizes, const uint8_t *counts, int kinds) {
+    memset(s->marks, 0, (s->cells + 7) / 8);
+    int start = s->outlen;
+    for (int k = 0; k < kinds; k++) {
+        for (int n = 0; n < counts[k]; n++) {
+            int tries = 0;
+            for (;;) {
+                if (++tries > 1000) { s->outlen = start; return false; }
+                int v  = (int)(next_rand(&s->rng) & 1);
+                int mx = s->width  - (v ? sizes[k] - 1 : 0);
+                int my = s->height - (v ? 0 : sizes[k] - 1);
+                if (mx < 1 || my < 1) continue;
+                int x = 1 + (int)(next_rand(&s->rng) % (uint64_t)mx);
+                int y = 1 + (int)(next_rand(&s->rng) % (uint64_t)my);
+                bool clear = true;
+                for (int i = 0; i < sizes[k] && clear; i++) {
+                    uint32_t c = (uint32_t)(x - 1 + (v ? i : 0)) * s->height + (y - 1 + (v ? 0 : i));
+                    clear = !mark_test(s, c);
+                }
+                if (!clear) continue;
+                for (int i = 0; i < sizes[k]; i++) {
+                    mark_set(s, (uint32_t)(x - 1 + (v ? i : 0)) * s->height + (y - 1 + (v ? 0 : i)));
+                }
+                queue_pos(s, k, x, y, v);
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+// OP_MODE: prepara o tabuleiro, posiciona a frota e manda READY, tudo num só envio
+static void on_mode(Sim *s, const uint8_t *a) {
+    s->width  = (int)bin_get16(a);
+    s->height = (int)bin_get16(a + 2);
+    s->cells  = (uint32_t)s->width * (uint32_t)s->height;
+    int kinds = a[4] > BIN_MAX_KINDS ? BIN_MAX_KINDS : a[4];
+    uint8_t sizes[BIN_MAX_KINDS], counts[BIN_MAX_KINDS];
+    for (int k = 0; k < kinds; k++) {
+        sizes[k]  = a[5 + 2*k];
+        counts[k] = a[5 + 2*k + 1];
+    }
+
+    size_t need = (s->cells + 7) / 8;
+    bool use_marks = strategy == STRAT_HUNT || s->cells <= RANDOM_PLACE_MAX;
+    if (use_marks && need > s->marks_cap) {
+        uint8_t *m = realloc(s->marks, need);
+        if (m) { s->marks = m; s->marks_cap = need; }
+    }
+    use_marks = use_marks && s->marks_cap >= need;
+
+    if (!(use_marks && s->cells <= RANDOM_PLACE_MAX && place_random(s, sizes, counts, kinds))) {
+        place_packed(s, sizes, counts, kinds);
+    }
+    uint8_t *f = sim_reserve(s, 1);
+    if (f) f[0] = OP_READY;
+
+    // permutação completa das células: LCG com módulo potência de 2 (a = 1 mod 4, c ímpar)
+    s->fired     = 0;
+    s->perm_mask = 1;
+    while (s->perm_mask < s->cells) s->perm_mask <<= 1;
+    s->perm_mask--;
+    s->perm_a    = ((uint32_t)next_rand(&s->rng) & ~3u) | 1u;
+    s->perm_c    = (uint32_t)next_rand(&s->rng) | 1u;
+    s->perm_next = (uint32_t)next_rand(&s->rng) & s->perm_mask;
+    s->strategy  = strategy;
+    if (strategy == STRAT_HUNT) {
+        if (use_marks) memset(s->marks, 0, need);
+        else           s->strategy = STRAT_RANDOM;  // sem memória para o mapa de tiros
+    }
+}
+
+static uint32_t next_perm_cell(Sim *s) {
+    uint32_t v;
+    do {
+        v = s->perm_next;
+        s->perm_next = (s->perm_a * s->perm_next + s->perm_c) & s->perm_mask;
+    } while (v >= s->cells);
+    return v;
+}
+
+static uint32_t choose_shot(Sim *s) {
+    if (s->strategy == STRAT_SEQ) {
+        return s->fired < s->cells ? s->fired++ : 0;
+    }
+    if (s->strategy == STRAT_HUNT) {
+        while (s->ntargets > 0) {
+            uint32_t c = s->targets[--s->ntargets];
+            if (!mark_test(s, c)) { mark_set(s, c); return c; }
+        }
+        if (s->fired >= s->cells) return 0;
+        uint32_t c;
+        do { c = next_perm_cell(s); } while (mark_test(s, c));
+        mark_set(s, c);
+        s->fired++;
+        return c;
+    }
+    return next_perm_cell(s);
+}
+
+static void fire(Sim *s) {
+    uint32_t c = choose_shot(s);
+    uint8_t *f = sim_reserve(s, 5);
+    if (!f) return;
+    f[0] = OP_FIRE;
+    bin_put16(f + 1, c / (uint32_t)s->height + 1);
+    bin_put16(f + 3, c % (uint32_t)s->height + 1);
+    s->t_fire = now_us();
+}
+
+// Acerto na estratégia hunt: os vizinhos ortogonais viram alvos prioritários
+static void add_targets(Sim *s, int x, int y) {
+    static const int dx[] = { -1, 1, 0, 0 }, dy[] = { 0, 0, -1, 1 };
+    for (int i = 0; i < 4 && s->ntargets < MAX_TARGETS; i++) {
+        int nx = x - 1 + dx[i], ny = y - 1 + dy[i];
+        if (nx < 0 || ny < 0 || nx >= s->width || ny >= s->height) continue;
+        uint32_t c = (uint32_t)nx * s->height + (uint32_t)ny;
+        if (!mark_test(s, c)) s->targets[s->ntargets++] = c;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Quadros do servidor
+// ---------------------------------------------------------------------------
+
+static void on_frame(Sim *s, const uint8_t *frame) {
+    const uint8_t *a = frame + 1;
+    Worker *w = s->w;
+    switch (frame[0]) {
+    case OP_WELCOME:
+        s->id = a[0];
+        hist_record(&w->join_match, now_us() - s->t_join);
+        break;
+    case OP_MODE:
+        on_mode(s, a);
+        break;
+    case OP_READIED:
+        if (a[0] == s->id) hist_record(&w->join_ready, now_us() - s->t_join);
+        break;
+    case OP_TURN:
+        if (a[0] == s->id) fire(s);
+        break;
+    case OP_SHOT:
+        if (a[0] != s->id) break;
+        hist_record(&w->fire_shot, now_us() - s->t_fire);
+        w->shots++;
+        if (s->strategy == STRAT_HUNT && a[5] != RESULT_MISS) {
+            add_targets(s, (int)bin_get16(a + 1), (int)bin_get16(a + 3));
+        }
+        break;
+    case OP_RESULT:
+        if (a[0] == OUTCOME_WIN) w->wins++;
+        break;
+    case OP_ERROR:
+        w->errors++;
+        break;
+    default:
+        break;
+    }
+}
+
+// Consome os bytes recebidos; false se a conexão deve ser fechada
+static bool sim_readable(Sim *s) {
+    for (;;) {
+        ssize_t n = recv(s->fd, s->in + s->inlen, sizeof(s->in) - s->inlen, MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) break;
+            sim_fail(s, true);
+            return false;
+        }
+        if (n == 0) {
+            sim_fail(s, true);
+            return false;
+        }
+        s->inlen += (int)n;
+
+        int off = 0;
+        if (s->state == ST_HELLO) {
+            if (s->inlen < 2) continue;
+            if (s->in[0] != BIN_MAGIC || s->in[1] != BIN_VERSION) {
+                sim_fail(s, false);
+                return false;
+            }
+            s->state = ST_PLAYING;
+            off = 2;
+        }
+        while (off < s->inlen) {
+            int size = bin_payload_size(s->in[off]);
+            if (size < 0) {
+                s->w->errors++;
+                sim_fail(s, true);
+                return false;
+            }
+            if (s->inlen - off < 1 + size) break;
+            if (s->in[off] == OP_END) {
+                sim_finish(s);
+                return false;
+            }
+            on_frame(s, s->in + off);
+            off += 1 + size;
+        }
+        memmove(s->in, s->in + off, s->inlen - off);
+        s->inlen -= off;
+    }
+    if (!sim_flush(s)) {
+        sim_fail(s, true);
+        return false;
+    }
+    return true;
+}
+
+static void *worker_loop(void *arg) {
+    Worker *w = arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    for (int i = 0; i < w->count && sim_wants_more(); i++) sim_start(&w->sims[i]);
+
+    while (w->active > 0) {
+        if (duration_secs > 0 && now_us() > deadline_us + DRAIN_GRACE_US) break;
+        int n = epoll_wait(w->epfd, events, MAX_EVENTS, 500);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            Sim *s = events[i].data.ptr;
+            if (s->state == ST_IDLE) continue;
+            if (s->state == ST_CONNECTING) {
+                sim_connected(s);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                if (!sim_readable(s)) continue;
+            }
+            if ((events[i].events & EPOLLOUT) && !sim_flush(s)) {
+                sim_fail(s, true);
+            }
+        }
+    }
+
+    // prazo estourado: o que ficou aberto conta como abandonado
+    for (int i = 0; i < w->count; i++) {
+        if (w->sims[i].state != ST_IDLE) sim_fail(&w->sims[i], true);
+    }
+    return NULL;
+}
+
+static void print_latency(const char *label, const Histogram *h) {
+    printf("[LOAD] %-16s %9lu %8lu %8lu %8lu %8lu %8lu\n", label,
+           (unsigned long)h->total,
+           (unsigned long)hist_percentile(h, 50),
+           (unsigned long)hist_percentile(h, 90),
+           (unsigned long)hist_percentile(h, 99),
+           (unsigned long)hist_percentile(h, 99.9),
+           (unsigned long)(h->total ? h->max : 0));
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Uso: %s [-H ip] [-p porta] [-n jogadores] [-t threads] [-g partidas | -d segundos]\n"
+        "          [-s seq|random|hunt] [-m modo] [-S semente]\n"
+        "  -H ip         servidor (padrão %s)\n"
+        "  -p porta      porta do servidor (padrão %d)\n"
+        "  -n jogadores  conexões simultâneas (padrão %d)\n"
+        "  -t threads    threads de eventos, os jogadores são divididos entre elas\n"
+        "  -g partidas   total de partidas (padrão: uma por par de jogadores)\n"
+        "  -d segundos   joga continuamente até o prazo (ignora -g)\n"
+        "  -s estratégia escolha dos tiros (padrão random)\n"
+        "  -m modo       modo pedido no JOIN (padrão do servidor)\n"
+        "  -S semente    semente dos posicionamentos e tiros\n",
+        prog, SERVER_IP, SERVER_PORT, DEFAULT_PLAYERS);
+}
+
+int main(int argc, char *argv[]) {
+    const char *host = SERVER_IP;
+    int port = SERVER_PORT;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "H:p:n:t:g:d:s:m:S:h")) != -1) {
+        switch (opt) {
+        case 'H': host = optarg; break;
+        case 'p': port = atoi(optarg); break;
+        case 'n': players = atoi(optarg); break;
+        case 't': thread_count = atoi(optarg); break;
+        case 'g': total_games = atoi(optarg); break;
+        case 'd': duration_secs = atoi(optarg); break;
+        case 'm': mode_name = optarg; break;
+        case 'S': seed = strtoull(optarg, NULL, 10); break;
+        case 's':
+            strategy = -1;
+            for (int i = 0; i < 3; i++) {
+                if (strcasecmp(optarg, strategy_names[i]) == 0) strategy = i;
+            }
+            if (strategy == -1) { usage(argv[0]); return 1; }
+            break;
+        default:  usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (port <= 0 || port > 65535 || players < 1 || thread_count < 1 ||
+        total_games < 0 || duration_secs < 0 || strlen(mode_name) >= BIN_MODE_LEN)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (thread_count > players) thread_count = players;
+    if (total_games == 0) total_games = (players + 1) / 2;
+    atomic_store(&joins_left, 2L * total_games);
+
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port   = htons(port);
+    if (inet_pton(AF_INET, host, &server_addr.sin_addr) != 1) {
+        fprintf(stderr, "Endereço inválido: %s\n", host);
+        return 1;
+    }
+
+    // milhares de conexões: sobe o limite de descritores até o teto permitido
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    Sim    *sims    = calloc((size_t)players, sizeof(Sim));
+    Worker *workers = calloc((size_t)thread_count, sizeof(Worker));
+    if (!sims || !workers) {
+        perror("calloc");
+        return 1;
+    }
+
+    uint64_t start = now_us();
+    deadline_us = start + (uint64_t)duration_secs * 1000000u;
+    for (int t = 0; t < thread_count; t++) {
+        Worker *w = &workers[t];
+        w->id    = t;
+        w->epfd  = epoll_create1(0);
+        w->sims  = sims + (size_t)players * t / thread_count;
+        w->count = (int)((size_t)players * (t + 1) / thread_count - (size_t)players * t / thread_count);
+        hist_init(&w->join_match);
+        hist_init(&w->join_ready);
+        hist_init(&w->fire_shot);
+        for (int i = 0; i < w->count; i++) {
+            Sim *s = &w->sims[i];
+            s->w     = w;
+            s->fd    = -1;
+            s->index = (int)(s - sims) + 1;
+            s->rng   = seed * 0x100000001B3ull + (uint64_t)s->index;
+        }
+        pthread_create(&w->tid, NULL, worker_loop, w);
+    }
+
+    Worker total = {0};
+    hist_init(&total.join_match);
+    hist_init(&total.join_ready);
+    hist_init(&total.fire_shot);
+    for (int t = 0; t < thread_count; t++) {
+        Worker *w = &workers[t];
+        pthread_join(w->tid, NULL);
+        close(w->epfd);
+        hist_merge(&total.join_match, &w->join_match);
+        hist_merge(&total.join_ready, &w->join_ready);
+        hist_merge(&total.fire_shot,  &w->fire_shot);
+        total.games   += w->games;
+        total.wins    += w->wins;
+        total.shots   += w->shots;
+        total.errors  += w->errors;
+        total.dropped += w->dropped;
+        total.failed  += w->failed;
+    }
+    double secs = (now_us() - start) / 1e6;
+    if (secs <= 0) secs = 1e-6;
+
+    printf("[LOAD] %d jogadores em %d thread(s), estratégia %s, modo %s\n",
+           players, thread_count, strategy_names[strategy], *mode_name ? mode_name : "padrão");
+    printf("[LOAD] %lu partidas em %.2fs: %.1f partidas/s, %lu tiros (%.0f/s)\n",
+           total.wins, secs, total.wins / secs, total.shots, total.shots / secs);
+    printf("[LOAD] erros do servidor=%lu conexões perdidas=%lu falhas de conexão=%lu\n",
+           total.errors, total.dropped, total.failed);
+    printf("[LOAD] %-16s %9s %8s %8s %8s %8s %8s\n",
+           "latência (us)", "amostras", "p50", "p90", "p99", "p99.9", "máx");
+    print_latency("JOIN->partida", &total.join_match);
+    print_latency("JOIN->READY",   &total.join_ready);
+    print_latency("FIRE->resultado", &total.fire_shot);
+
+    for (int i = 0; i < players; i++) free(sims[i].marks);
+    free(sims);
+    free(workers);
+    return (total.dropped || total.failed || total.wins == 0) ? 1 : 0;
+}
@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+#include "battleship.h"
+#include "../common/protocol.h"
+#include "../server/binlog.h"
+#include "../server/gamelog.h"
+
+// Lê o log binário do servidor (-G): lista as partidas pelo índice, mostra uma partida
+// ou só um turno dela, e converte de volta para o texto do game_log.txt / partida_<id>.txt
+// (que o battlereplay reexecuta). Os ids recomeçam a cada execução do servidor: uma
+// partida é identificada pela execução e pelo id.
+
+// Trechos em ordem de execução, de partida e, dentro dela, de gravação
+static int by_match(const void *a, const void *b) {
+    const BinlogEntry *x = a, *y = b;
+    if (x->run != y->run) return x->run < y->run ? -1 : 1;
+    if (x->match_id != y->match_id) return x->match_id < y->match_id ? -1 : 1;
+    return x->offset < y->offset ? -1 : x->offset > y->offset;
+}
+
+static bool same_match(const BinlogEntry *x, const BinlogEntry *y) {
+    return x->run == y->run && x->match_id == y->match_id;
+}
+
+// Texto dos trechos [from, to) de uma partida; turn >= 0 só os eventos daquele turno
+static bool print_match(int fd, const BinlogEntry *e, long from, long to, long turn, FILE *out) {
+    BinlogNames names = {0};
+    char text[MAX_MSG * 2];
+    for (long i = from; i < to; i++) {
+        if (turn >= 0 && (turn < (long)e[i].first_turn || turn > (long)e[i].last_turn)) continue;
+        BinlogRecord *recs;
+        long count = binlog_read_run(fd, &e[i], &recs);
+        if (count < 0) {
+            fprintf(stderr, "partida %u: trecho ilegível em %llu\n",
+                    e[i].match_id, (unsigned long long)e[i].offset);
+            return false;
+        }
+        for (long j = 0; j < count; ) {
+            long turn_of = recs[j].turn;
+            j += binlog_format(&recs[j], (int)(count - j), &names, text, sizeof(text));
+            if (turn < 0 || turn_of == turn) fputs(text, out);
+        }
+        free(recs);
+    }
+    return true;
+}
+
+static void list_match(const BinlogEntry *e, long from, long to) {
+    unsigned long records = 0;
+    unsigned long first = e[from].first_turn, last = e[from].last_turn;
+    int flags = 0, winner = 0;
+    for (long i = from; i < to; i++) {
+        records += e[i].count;
+        if (e[i].first_turn < first) first = e[i].first_turn;
+        if (e[i].last_turn > last)   last  = e[i].last_turn;
+        if (e[i].flags & BLOG_RUN_RESULT) winner = e[i].winner;
+        flags |= e[i].flags;
+    }
+    printf("EXECUÇÃO %u PARTIDA %u: %lu registros em %ld trecho(s), turnos %lu-%lu, ",
+           e[from].run, e[from].match_id, records, to - from, first, last);
+    if (flags & BLOG_RUN_RESULT)   printf("PLAYER %d venceu\n", winner);
+    else if (flags & BLOG_RUN_END) printf("encerrada sem resultado\n");
+    else                           printf("em andamento\n");
+}
+
+// <dir>/execucao_<n>/partida_<id>.txt
+static bool convert_match(int fd, const char *dir, const BinlogEntry *e, long from, long to) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/execucao_%u", dir, e[from].run);
+    if (mkdir(path, 0755) == -1 && errno != EEXIST) {
+        perror(path);
+        return false;
+    }
+    snprintf(path, sizeof(path), "%s/execucao_%u/partida_%u.txt", dir, e[from].run, e[from].match_id);
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    fputs(LOG_HEADER, f);
+    bool ok = print_match(fd, e, from, to, -1, f);
+    if (fclose(f) != 0) {
+        perror(path);
+        ok = false;
+    }
+    return ok;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Uso: %s [-e execução] [-m partida [-T turno]] [-o diretório] <arquivo>\n"
+        "  (sem opções)  lista as partidas do log com turnos e vencedor\n"
+        "  -e execução   só as partidas dessa execução do servidor\n"
+        "  -m partida    imprime a partida no formato do game_log.txt (da última\n"
+        "                execução em que o id aparece, se faltar -e)\n"
+        "  -T turno      só os eventos do turno (0 é o posicionamento)\n"
+        "  -o diretório  converte as partidas (ou só a de -m) em\n"
+        "                execucao_<n>/partida_<id>.txt\n",
+        prog);
+}
+
+int main(int argc, char *argv[]) {
+    long match = -1, run = -1;
+    long turn = -1;
+    const char *dir = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "e:m:T:o:h")) != -1) {
+        switch (opt) {
+        case 'e': run = atol(optarg); break;
+        case 'm': match = atol(optarg); break;
+        case 'T': turn = atol(optarg); break;
+        case 'o': dir = optarg; break;
+        default:  usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (optind != argc - 1 || (turn >= 0 && (match < 0 || dir))) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const char *path = argv[optind];
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror(path);
+        return 2;
+    }
+    BinlogEntry *entries;
+    long n = binlog_read_index(fd, &entries);
+    if (n < 0) {
+        fprintf(stderr, "%s: não é um log binário do servidor (-G)\n", path);
+        return 2;
+    }
+    qsort(entries, (size_t)n, sizeof(*entries), by_match);
+    if (match >= 0 && run < 0) {
+        for (long i = 0; i < n; i++) {
+            if (entries[i].match_id == (unsigned long)match) run = entries[i].run;
+        }
+    }
+
+    if (dir && mkdir(dir, 0755) == -1 && errno != EEXIST) {
+        perror(dir);
+        return 2;
+    }
+
+    int status = match >= 0 ? 1 : 0;   // partida pedida e não encontrada
+    long matches = 0, chunks = 0;
+    for (long from = 0, to; from < n; from = to) {
+        for (to = from + 1; to < n && same_match(&entries[to], &entries[from]); to++) {}
+        if (run >= 0 && entries[from].run != (unsigned long)run) continue;
+        matches++;
+        chunks += to - from;
+        if (match >= 0 && entries[from].match_id != (unsigned long)match) continue;
+
+        if (dir) {
+            if (!convert_match(fd, dir, entries, from, to)) status = 2;
+            else if (match >= 0) status = 0;
+        } else if (match >= 0) {
+            if (turn < 0) fputs(LOG_HEADER, stdout);
+            status = print_match(fd, entries, from, to, turn, stdout) ? 0 : 2;
+        } else {
+            list_match(entries, from, to);
+        }
+    }
+    if (match >= 0 && status == 1) fprintf(stderr, "partida %ld não está em %s\n", match, path);
+    if (match < 0 && !dir) printf("[LOG] %ld partida(s) em %ld trecho(s)\n", matches, chunks);
+    if (match < 0 && dir)  printf("[LOG] %ld partida(s) convertidas em %s\n", matches, dir);
+
+    free(entries);
+    close(fd);
+    return status;
+}
@@ -0,0 +1,474 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+#include "battleship.h"
+#include "../common/protocol.h"
+#include "../server/gamelog.h"
+
+// Reexecuta logs de partidas (game_log.txt ou partida_<id>.txt) com as mesmas regras
+// do servidor, sem sockets, e confere o vencedor com a linha RESULTADO gravada. Os
+// prazos esgotados (W.O.) não são comandos: o aviso do log é reaplicado como veio.
+// No game_log.txt as partidas se intercalam; as linhas são separadas pela marca
+// [partida N] antes do replay. Linhas sem marca (logs antigos, -L) formam uma sequência
+// de partidas, uma depois da outra. Uma execução que recomeça os ids abre com LOG_HEADER:
+// dali em diante a partida N é outra.
+
+#define PLAYER_PREFIX  "PLAYER "
+#define RESULT_PREFIX  "RESULTADO: "
+#define MODE_PREFIX    "=== MODO "
+#define TIMEOUT_PREFIX "=== TEMPO ESGOTADO: "
+
+typedef struct {
+    unsigned long files;
+    unsigned long unreadable;
+    unsigned long matches;
+    unsigned long ok;
+    unsigned long mismatched;
+    unsigned long incomplete;    // log sem RESULTADO e replay sem fim de jogo
+    unsigned long commands;
+} ReplayStats;
+
+// Trecho de um arquivo com uma partida: termina na linha RESULTADO (inclusive) ou no fim
+typedef struct {
+    const char *start, *end;
+    char  mode[MAX_MODE_NAME];
+    bool  has_result;
+    bool  has_commands;
+    char  winner[MAX_NAME_LEN];
+    int   winner_id;
+} Segment;
+
+static GameMode modes[MAX_MODES];
+static int      mode_count = 0;
+static bool     verbose    = false;
+
+// Linha de um game_log.txt com a marca da partida (já sem ela)
+typedef struct {
+    unsigned    epoch;        // LOG_HEADERs até esta linha (execuções do servidor)
+    long        match;        // -1 sem marca
+    size_t      seq;          // ordem no arquivo
+    const char *s;
+    size_t      len;          // com o \n
+} TaggedLine;
+
+// Memória reaproveitada por uma thread de arquivo em arquivo
+typedef struct {
+    char       *file;         // arquivo inteiro
+    size_t      file_cap;
+    TaggedLine *lines;
+    size_t      line_cap;
+    char       *match;        // linhas de uma partida, juntas
+    size_t      match_cap;
+} ReplayBuf;
+
+// Arquivos a reproduzir; cada thread pega o próximo índice livre
+static char   **files;
+static size_t   file_count, file_cap;
+static atomic_size_t next_file;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+static const GameMode *find_mode(const char *name) {
+    for (int i = 0; i < mode_count; i++) {
+        if (strcasecmp(modes[i].name, name) == 0) return &modes[i];
+    }
+    return NULL;
+}
+
+static bool add_mode(const char *spec) {
+    if (mode_count == MAX_MODES) return false;
+    GameMode mode;
+    if (!parse_game_mode(spec, &mode)) return false;
+    for (int i = 0; i < mode_count; i++) {
+        if (strcasecmp(modes[i].name, mode.name) == 0) {
+            modes[i] = mode;
+            return true;
+        }
+    }
+    modes[mode_count++] = mode;
+    return true;
+}
+
+static bool starts_with(const char *line, const char *end, const char *prefix) {
+    size_t n = strlen(prefix);
+    return (size_t)(end - line) >= n && memcmp(line, prefix, n) == 0;
+}
+
+static const char *line_end(const char *p, const char *end) {
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    return nl ? nl : end;
+}
+
+// Delimita a próxima partida a partir de p e coleta modo e resultado esperado
+static const char *next_segment(const char *p, const char *end, Segment *seg) {
+    memset(seg, 0, sizeof(*seg));
+    strcpy(seg->mode, classic_game_mode()->name);   // logs antigos não anunciam o modo
+    seg->start = p;
+
+    while (p < end) {
+        const char *eol = line_end(p, end);
+        const char *next = eol < end ? eol + 1 : end;
+        char line[MAX_MSG];
+        size_t len = (size_t)(eol - p);
+        if (len >= sizeof(line)) len = sizeof(line) - 1;
+        memcpy(line, p, len);
+        line[len] = '\0';
+
+        if (starts_with(p, eol, PLAYER_PREFIX)) {
+            seg->has_commands = true;
+        } else if (starts_with(p, eol, MODE_PREFIX)) {
+            sscanf(line + strlen(MODE_PREFIX), "%15[^: ]", seg->mode);
+        } else if (starts_with(p, eol, RESULT_PREFIX)) {
+            seg->has_result =
+                sscanf(line + strlen(RESULT_PREFIX), "%31s (Player %d) WINS",
+                       seg->winner, &seg->winner_id) == 2;
+            seg->end = next;
+            return next;
+        } else if (starts_with(p, eol, TIMEOUT_PREFIX) &&
+                   !starts_with(p + strlen(TIMEOUT_PREFIX), eol, "PLAYER ")) {
+            // prazo esgotado sem ninguém pronto: a partida acaba sem RESULTADO
+            seg->end = next;
+            return next;
+        }
+        p = next;
+    }
+    seg->end = end;
+    return end;
+}
+
+// Aplica os comandos PLAYER n -> ... do trecho a uma partida nova
+static void replay_segment(const char *path, long ordinal, const Segment *seg,
+                           ReplayStats *st)
+{
+    const GameMode *mode = find_mode(seg->mode);
+    if (!mode) {
+        printf("DIVERGE %s (partida %ld): modo %s desconhecido (use -M)\n",
+               path, ordinal, seg->mode);
+        st->matches++;
+        st->mismatched++;
+        return;
+    }
+
+    Game g;
+    if (!init_game(&g, mode)) {
+        fprintf(stderr, "%s: sem memória para a partida %ld\n", path, ordinal);
+        st->unreadable++;
+        return;
+    }
+    g.id = (uint32_t)ordinal;
+    add_player(&g, -1);
+    add_player(&g, -1);
+
+    for (const char *p = seg->start; p < seg->end && !g.game_over; ) {
+        const char *eol = line_end(p, seg->end);
+        int id, skip = 0;
+        if (starts_with(p, eol, PLAYER_PREFIX) &&
+            sscanf(p + strlen(PLAYER_PREFIX), "%d -> %n", &id, &skip) == 1 && skip > 0 &&
+            id >= 1 && id <= MAX_CLIENTS)
+        {
+            const char *cmd = p + strlen(PLAYER_PREFIX) + skip;
+            char buf[MAX_MSG];
+            size_t len = (size_t)(eol - cmd);
+            if (len >= sizeof(buf)) len = sizeof(buf) - 1;
+            memcpy(buf, cmd, len);
+            buf[len] = '\0';
+            process_command(&g, &g.players[id - 1], buf);
+            st->commands++;
+        } else if (starts_with(p, eol, TIMEOUT_PREFIX)) {
+            bool player = sscanf(p + strlen(TIMEOUT_PREFIX), "PLAYER %d", &id) == 1 &&
+                          id >= 1 && id <= MAX_CLIENTS;
+            forfeit_game(&g, player ? &g.players[id - 1] : NULL);
+        }
+        p = eol < seg->end ? eol + 1 : seg->end;
+    }
+
+    Player *winner = NULL, *loser = NULL;
+    bool finished = g.game_over && check_winner(&g, &winner, &loser);
+    st->matches++;
+    if (!seg->has_result) {
+        if (finished) {
+            printf("DIVERGE %s (partida %ld): replay terminou (%s venceu) mas o log não tem RESULTADO\n",
+                   path, ordinal, winner->name);
+            st->mismatched++;
+        } else if (g.game_over) {
+            // prazo esgotado sem vencedor: o log também termina sem RESULTADO
+            st->ok++;
+            if (verbose) printf("OK %s (partida %ld): sem vencedor\n", path, ordinal);
+        } else {
+            st->incomplete++;
+        }
+    } else if (!finished) {
+        printf("DIVERGE %s (partida %ld): log diz %s (Player %d) WINS, replay não terminou\n",
+               path, ordinal, seg->winner, seg->winner_id);
+        st->mismatched++;
+    } else if (winner->player_id != seg->winner_id || strcmp(winner->name, seg->winner) != 0) {
+        printf("DIVERGE %s (partida %ld): log diz %s (Player %d) WINS, replay deu %s (Player %d)\n",
+               path, ordinal, seg->winner, seg->winner_id, winner->name, winner->player_id);
+        st->mismatched++;
+    } else {
+        st->ok++;
+        if (verbose) {
+            printf("OK %s (partida %ld): %s (Player %d) WINS\n",
+                   path, ordinal, winner->name, winner->player_id);
+        }
+    }
+    destroy_game(&g);
+}
+
+// Lê o arquivo inteiro no buffer da thread
+static bool read_file(const char *path, char **buf, size_t *cap, size_t *len) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        perror(path);
+        return false;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) == -1) {
+        perror(path);
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t)sb.st_size;
+    if (size + 1 > *cap) {
+        char *nbuf = realloc(*buf, size + 1);
+        if (!nbuf) {
+            close(fd);
+            return false;
+        }
+        *buf = nbuf;
+        *cap = size + 1;
+    }
+    size_t off = 0;
+    while (off < size) {
+        ssize_t n = read(fd, *buf + off, size - off);
+        if (n <= 0) break;
+        off += (size_t)n;
+    }
+    close(fd);
+    *len = off;
+    return true;
+}
+
+// Partidas em sequência de p a end; ordinal numera as que não têm id
+static void replay_stream(const char *path, const char *p, const char *end, long *ordinal,
+                          ReplayStats *st)
+{
+    while (p < end) {
+        Segment seg;
+        p = next_segment(p, end, &seg);
+        if (seg.has_commands) replay_segment(path, ++*ordinal, &seg, st);
+    }
+}
+
+// "[partida N] ": id da partida e início do texto; false se a linha não tem a marca
+static bool match_tag(const char *p, const char *eol, long *match, const char **text) {
+    static const char open[] = "[partida ";
+    if (!starts_with(p, eol, open)) return false;
+    p += sizeof(open) - 1;
+    long id = 0;
+    const char *digits = p;
+    while (p < eol && *p >= '0' && *p <= '9' && id <= UINT32_MAX) id = id * 10 + (*p++ - '0');
+    if (p == digits || id > UINT32_MAX || eol - p < 2 || p[0] != ']' || p[1] != ' ') return false;
+    *match = id;
+    *text  = p + 2;
+    return true;
+}
+
+static int by_match_seq(const void *a, const void *b) {
+    const TaggedLine *x = a, *y = b;
+    if (x->epoch != y->epoch) return x->epoch < y->epoch ? -1 : 1;
+    if (x->match != y->match) return x->match < y->match ? -1 : 1;
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static bool grow(void **buf, size_t *cap, size_t need, size_t elem) {
+    if (need <= *cap) return true;
+    size_t ncap = *cap ? *cap : 1024;
+    while (ncap < need) ncap *= 2;
+    void *nbuf = realloc(*buf, ncap * elem);
+    if (!nbuf) return false;
+    *buf = nbuf;
+    *cap = ncap;
+    return true;
+}
+
+static void replay_file(const char *path, ReplayStats *st, ReplayBuf *rb) {
+    size_t len;
+    st->files++;
+    if (!read_file(path, &rb->file, &rb->file_cap, &len)) {
+        st->unreadable++;
+        return;
+    }
+
+    // cada linha vai para a partida da marca; as sem marca ficam juntas na sequência -1
+    // da execução
+    static const char header[] = LOG_HEADER;
+    const char *p = rb->file, *end = rb->file + len;
+    size_t count = 0;
+    unsigned epoch = 0;
+    while (p < end) {
+        const char *eol  = line_end(p, end);
+        const char *next = eol < end ? eol + 1 : end;
+        const char *text = p;
+        long match = -1;
+        if (!match_tag(p, eol, &match, &text) && (size_t)(eol - p) == strcspn(header, "\n") &&
+            memcmp(p, header, (size_t)(eol - p)) == 0) {
+            epoch++;
+        }
+        if (!grow((void **)&rb->lines, &rb->line_cap, count + 1, sizeof(*rb->lines))) {
+            fprintf(stderr, "%s: sem memória para separar as partidas\n", path);
+            st->unreadable++;
+            return;
+        }
+        rb->lines[count] = (TaggedLine){ epoch, match, count, text, (size_t)(next - text) };
+        count++;
+        p = next;
+    }
+    qsort(rb->lines, count, sizeof(*rb->lines), by_match_seq);
+
+    for (size_t from = 0, to; from < count; from = to) {
+        unsigned epoch = rb->lines[from].epoch;
+        long     match = rb->lines[from].match;
+        size_t   bytes = 0;
+        for (to = from; to < count && rb->lines[to].epoch == epoch && rb->lines[to].match == match;
+             to++) {
+            bytes += rb->lines[to].len;
+        }
+        if (!grow((void **)&rb->match, &rb->match_cap, bytes, 1)) {
+            fprintf(stderr, "%s: sem memória para a partida %ld\n", path, match);
+            st->unreadable++;
+            continue;
+        }
+        char *q = rb->match;
+        for (size_t i = from; i < to; i++) {
+            memcpy(q, rb->lines[i].s, rb->lines[i].len);
+            q += rb->lines[i].len;
+        }
+        // sem marca as partidas são numeradas pela ordem; com marca, pelo id
+        long ordinal = match == -1 ? 0 : match - 1;
+        replay_stream(path, rb->match, q, &ordinal, st);
+    }
+}
+
+static void *worker(void *arg) {
+    ReplayStats *st = arg;
+    ReplayBuf rb = { 0 };
+    size_t i;
+    while ((i = atomic_fetch_add(&next_file, 1)) < file_count) {
+        replay_file(files[i], st, &rb);
+    }
+    free(rb.file);
+    free(rb.lines);
+    free(rb.match);
+    return NULL;
+}
+
+static int collect(const char *path, const struct stat *sb, int type, struct FTW *ftw) {
+    (void)sb; (void)ftw;
+    if (type != FTW_F) return 0;
+    if (file_count == file_cap) {
+        size_t cap = file_cap ? file_cap * 2 : 1024;
+        char **nfiles = realloc(files, cap * sizeof(*files));
+        if (!nfiles) return -1;
+        files = nfiles;
+        file_cap = cap;
+    }
+    if (!(files[file_count] = strdup(path))) return -1;
+    file_count++;
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Uso: %s [-j threads] [-M modo]... [-v] <log|diretório>...\n"
+        "  -j threads  arquivos reproduzidos em paralelo (padrão: núcleos online)\n"
+        "  -M modo     registra um modo NOME:LxA:TIPO=TAMxQTD[,...] usado nos logs\n"
+        "  -v          lista também as partidas que conferem\n",
+        prog);
+}
+
+int main(int argc, char *argv[]) {
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+
+    modes[mode_count++] = *classic_game_mode();
+    add_mode(EVENT_MODE_SPEC);
+    while ((opt = getopt(argc, argv, "j:M:vh")) != -1) {
+        switch (opt) {
+        case 'j': threads = atol(optarg); break;
+        case 'v': verbose = true; break;
+        case 'M':
+            if (!add_mode(optarg)) {
+                fprintf(stderr, "Modo inválido: %s\n", optarg);
+                return 2;
+            }
+            break;
+        default:  usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (optind == argc || threads < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    for (int i = optind; i < argc; i++) {
+        if (nftw(argv[i], collect, 64, FTW_PHYS) == -1) {
+            perror(argv[i]);
+            return 2;
+        }
+    }
+    if ((size_t)threads > file_count) threads = file_count ? (long)file_count : 1;
+
+    pthread_t   *tids  = calloc((size_t)threads, sizeof(*tids));
+    ReplayStats *stats = calloc((size_t)threads, sizeof(*stats));
+    if (!tids || !stats) {
+        perror("calloc");
+        return 2;
+    }
+
+    uint64_t start = now_us();
+    for (long i = 0; i < threads; i++) {
+        pthread_create(&tids[i], NULL, worker, &stats[i]);
+    }
+    ReplayStats total = {0};
+    for (long i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        total.files      += stats[i].files;
+        total.unreadable += stats[i].unreadable;
+        total.matches    += stats[i].matches;
+        total.ok         += stats[i].ok;
+        total.mismatched += stats[i].mismatched;
+        total.incomplete += stats[i].incomplete;
+        total.commands   += stats[i].commands;
+    }
+    double secs = (now_us() - start) / 1e6;
+    if (secs <= 0) secs = 1e-6;
+
+    printf("[REPLAY] %lu arquivo(s), %lu partida(s): %lu conferem, %lu divergem, "
+           "%lu incompletas, %lu ilegíveis\n",
+           total.files, total.matches, total.ok, total.mismatched,
+           total.incomplete, total.unreadable);
+    printf("[REPLAY] %lu comandos em %.3fs com %ld thread(s): %.0f partidas/s, %.0f comandos/s\n",
+           total.commands, secs, threads, total.matches / secs, total.commands / secs);
+
+    for (size_t i = 0; i < file_count; i++) free(files[i]);
+    free(files);
+    free(tids);
+    free(stats);
+    return (total.mismatched || total.unreadable) ? 1 : 0;
+}
@@ -0,0 +1,509 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "battleship.h"
+#include "../common/protocol.h"
+#include "../server/ai.h"
+
+// Torneio entre estratégias de tiro rodando as regras do servidor no próprio processo,
+// sem sockets: place_ship posiciona as frotas, handle_fire resolve os tiros e
+// check_winner decide a partida.
+//
+// Cada partida tem um índice global e sua semente depende só da semente do torneio
+// e desse índice, e as estatísticas são somas inteiras; por isso o resultado é o
+// mesmo com qualquer número de threads. As threads dividem os índices em faixas e,
+// quando a própria acaba, roubam metade da faixa de outra (work stealing).
+
+#define DEFAULT_GAMES  10000     // partidas por confronto
+#define DEFAULT_CHUNK  64        // partidas retiradas da própria faixa de cada vez
+#define Z95            1.959964  // quantil da normal para intervalos de 95%
+
+enum { STRAT_SEQ, STRAT_RANDOM, STRAT_HUNT, STRAT_BOT, STRAT_COUNT };
+static const char *strategy_names[] = { "seq", "random", "hunt", "bot" };
+
+// Estado de um atirador durante uma partida
+typedef struct {
+    int       strategy;
+    Bot      *bot;              // posiciona a frota em todas; escolhe os tiros em "bot"
+    uint64_t  rng;
+    uint32_t  cells;
+    int       height;
+    uint32_t  fired;
+    uint32_t  perm_next, perm_mask, perm_a, perm_c;  // permutação das células (random/hunt)
+    uint8_t  *marks;            // bitmap de tiros já dados (hunt)
+    uint32_t *targets;          // vizinhos de acertos a tentar primeiro (hunt)
+    uint32_t  ntargets;
+} Shooter;
+
+// Totais de um lado de um confronto; só inteiros, para somar na mesma ordem em qualquer thread
+typedef struct {
+    uint64_t wins;
+    uint64_t first_wins;        // vitórias de quem atirou primeiro
+    uint64_t shots;             // tiros do vencedor, somados nas vitórias
+    uint64_t shots_sq;
+} SideStats;
+
+typedef struct {
+    int a, b;                   // índices em strategies[]
+} Pairing;
+
+// Faixa de índices de partida de uma thread; o dono tira do início, ladrões levam o fim
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t  lo, hi;
+    int       id;
+    uint64_t  games, shots, steals;
+    SideStats *stats;           // [pairing][2]
+    Shooter   shooters[2];
+} Worker;
+
+static const GameMode *mode;
+static GameMode        custom_mode;
+static int      strategies[STRAT_COUNT];
+static int      strategy_count;
+static Pairing  pairings[STRAT_COUNT * STRAT_COUNT];
+static int      pairing_count;
+static uint64_t games_per_pairing = DEFAULT_GAMES;
+static uint64_t chunk = DEFAULT_CHUNK;
+static uint64_t seed  = 1;
+static Worker  *workers;
+static long     worker_count;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+// splitmix64
+static uint64_t next_rand(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// ---------------------------------------------------------------------------
+// Estratégias de tiro (seq, random e hunt como no battleload; bot é o do servidor)
+// ---------------------------------------------------------------------------
+
+static bool shooter_alloc(Shooter *s) {
+    s->cells   = (uint32_t)mode->width * (uint32_t)mode->height;
+    s->height  = mode->height;
+    s->marks   = malloc((s->cells + 7) / 8);
+    s->targets = malloc(4 * (size_t)mode->total_cells * sizeof(*s->targets));
+    return s->marks && s->targets;
+}
+
+static void shooter_free(Shooter *s) {
+    free(s->marks);
+    free(s->targets);
+}
+
+static bool shooter_reset(Shooter *s, int strategy, uint64_t game_seed) {
+    s->strategy = strategy;
+    s->rng      = game_seed;
+    s->bot      = ai_create(mode, next_rand(&s->rng));
+    if (!s->bot) return false;
+
+    // permutação completa das células: LCG com módulo potência de 2 (a = 1 mod 4, c ímpar)
+    s->fired     = 0;
+    s->ntargets  = 0;
+    s->perm_mask = 1;
+    while (s->perm_mask < s->cells) s->perm_mask <<= 1;
+    s->perm_mask--;
+    s->perm_a    = ((uint32_t)next_rand(&s->rng) & ~3u) | 1u;
+    s->perm_c    = (uint32_t)next_rand(&s->rng) | 1u;
+    s->perm_next = (uint32_t)next_rand(&s->rng) & s->perm_mask;
+    if (strategy == STRAT_HUNT) memset(s->marks, 0, (s->cells + 7) / 8);
+    return true;
+}
+
+static uint32_t next_perm_cell(Shooter *s) {
+    uint32_t v;
+    do {
+        v = s->perm_next;
+        s->perm_next = (s->perm_a * s->perm_next + s->perm_c) & s->perm_mask;
+    } while (v >= s->cells);
+    return v;
+}
+
+static inline bool mark_test(const Shooter *s, uint32_t c) {
+    return s->marks[c >> 3] & (1u << (c & 7));
+}
+
+static inline void mark_set(Shooter *s, uint32_t c) {
+    s->marks[c >> 3] |= (uint8_t)(1u << (c & 7));
+}
+
+static Coord choose_shot(Shooter *s) {
+    uint32_t c;
+    switch (s->strategy) {
+    case STRAT_BOT:
+        return ai_choose_shot(s->bot);
+    case STRAT_SEQ:
+        c = s->fired < s->cells ? s->fired++ : 0;
+        break;
+    case STRAT_HUNT:
+        c = UINT32_MAX;
+        while (s->ntargets > 0 && c == UINT32_MAX) {
+            uint32_t t = s->targets[--s->ntargets];
+            if (!mark_test(s, t)) c = t;
+        }
+        if (c == UINT32_MAX) {
+            do { c = next_perm_cell(s); } while (mark_test(s, c));
+        }
+        mark_set(s, c);
+        break;
+    default:
+        c = next_perm_cell(s);
+        break;
+    }
+    return (Coord){ (int)(c / (uint32_t)s->height), (int)(c % (uint32_t)s->height) };
+}
+
+static void observe(Shooter *s, Coord c, int result, const Ship *sunk) {
+    if (s->strategy == STRAT_BOT) {
+        ai_observe(s->bot, c, result, sunk);
+        return;
+    }
+    if (s->strategy != STRAT_HUNT || result == RESULT_MISS) return;
+    // acerto: os vizinhos ortogonais viram alvos prioritários
+    static const int dx[] = { -1, 1, 0, 0 }, dy[] = { 0, 0, -1, 1 };
+    for (int i = 0; i < 4; i++) {
+        int nx = c.x + dx[i], ny = c.y + dy[i];
+        if (nx < 0 || ny < 0 || nx >= mode->width || ny >= mode->height) continue;
+        uint32_t t = (uint32_t)nx * (uint32_t)s->height + (uint32_t)ny;
+        if (!mark_test(s, t)) s->targets[s->ntargets++] = t;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Partida
+// ---------------------------------------------------------------------------
+
+static bool place_fleet(Shooter *s, Player *p) {
+    ShipType type;
+    Coord c;
+    Orientation o;
+    while (ai_next_placement(s->bot, p, &type, &c, &o)) {
+        if (!place_ship(p, type, c, o)) return false;
+    }
+    return p->ship_count == mode->total_ships;
+}
+
+// Atira e devolve o resultado (RESULT_*); em RESULT_SUNK, *sunk aponta o navio
+static int fire(Game *g, Player *p, Player *opp, Coord c, const Ship **sunk) {
+    int idx = ship_at(opp, c);
+    uint64_t before = idx == -1 ? 0 : opp->ships[idx].hits;
+    handle_fire(g, p, c);
+    if (idx == -1 || opp->ships[idx].hits == before) return RESULT_MISS;
+    const Ship *ship = &opp->ships[idx];
+    if (ship->hits != (ship->size == 64 ? ~0ull : (1ull << ship->size) - 1)) return RESULT_HIT;
+    *sunk = ship;
+    return RESULT_SUNK;
+}
+
+// Joga a partida de índice global idx e soma o resultado nas estatísticas do worker
+static bool play_game(Worker *w, uint64_t idx) {
+    const Pairing *pr = &pairings[idx / games_per_pairing];
+    uint64_t n = idx % games_per_pairing;
+    uint64_t game_seed = seed ^ (idx * 0xD1B54A32D192ED03ull);
+    int first = (int)(n & 1);   // alterna quem abre o fogo
+
+    Game g;
+    if (!init_game(&g, mode)) return false;
+    bool ok = true;
+    for (int i = 0; i < MAX_CLIENTS && ok; i++) {
+        Shooter *s = &w->shooters[i];
+        ok = add_player(&g, -1) &&
+             shooter_reset(s, i == 0 ? strategies[pr->a] : strategies[pr->b],
+                           next_rand(&game_seed)) &&
+             place_fleet(s, &g.players[i]);
+        g.players[i].joined = g.players[i].ready = true;
+    }
+    g.game_started = true;
+    g.players[first].active_turn = true;
+
+    uint32_t fired[MAX_CLIENTS] = {0};
+    uint32_t limit = w->shooters[0].cells;
+    int turn = first;
+    while (ok && !g.game_over && fired[turn] < limit) {
+        Player *p = &g.players[turn], *opp = &g.players[!turn];
+        Shooter *s = &w->shooters[turn];
+        Coord c = choose_shot(s);
+        const Ship *sunk = NULL;
+        int result = fire(&g, p, opp, c, &sunk);
+        observe(s, c, result, sunk);
+        fired[turn]++;
+        turn = !turn;
+    }
+
+    Player *winner = NULL, *loser = NULL;
+    if (ok && check_winner(&g, &winner, &loser)) {
+        int side = winner == &g.players[0] ? 0 : 1;
+        SideStats *st = &w->stats[(idx / games_per_pairing) * 2 + side];
+        st->wins++;
+        st->first_wins += side == first;
+        st->shots      += fired[side];
+        st->shots_sq   += (uint64_t)fired[side] * fired[side];
+    } else {
+        ok = false;
+    }
+    w->games++;
+    w->shots += fired[0] + fired[1];
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        ai_destroy(w->shooters[i].bot);
+        w->shooters[i].bot = NULL;
+    }
+    destroy_game(&g);
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Escalonador com roubo de trabalho
+// ---------------------------------------------------------------------------
+
+// Tira até chunk partidas do início da própria faixa
+static bool take_own(Worker *w, uint64_t *lo, uint64_t *hi) {
+    pthread_mutex_lock(&w->lock);
+    *lo = w->lo;
+    *hi = w->lo + chunk < w->hi ? w->lo + chunk : w->hi;
+    w->lo = *hi;
+    pthread_mutex_unlock(&w->lock);
+    return *lo < *hi;
+}
+
+// Leva a metade final da faixa de outra thread para a própria
+static bool steal(Worker *w) {
+    for (long k = 1; k < worker_count; k++) {
+        Worker *v = &workers[(w->id + k) % worker_count];
+        pthread_mutex_lock(&v->lock);
+        uint64_t left = v->hi - v->lo;
+        if (left < 2) {
+            pthread_mutex_unlock(&v->lock);
+            continue;
+        }
+        uint64_t mid = v->lo + left / 2;
+        uint64_t hi  = v->hi;
+        v->hi = mid;
+        pthread_mutex_unlock(&v->lock);
+
+        pthread_mutex_lock(&w->lock);
+        w->lo = mid;
+        w->hi = hi;
+        pthread_mutex_unlock(&w->lock);
+        w->steals++;
+        return true;
+    }
+    return false;
+}
+
+static atomic_ulong failures;
+
+static void *worker(void *arg) {
+    Worker *w = arg;
+    for (;;) {
+        uint64_t lo, hi;
+        if (!take_own(w, &lo, &hi)) {
+            if (!steal(w)) break;
+            continue;
+        }
+        for (uint64_t i = lo; i < hi; i++) {
+            if (!play_game(w, i)) atomic_fetch_add(&failures, 1);
+        }
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Relatório
+// ---------------------------------------------------------------------------
+
+// Intervalo de Wilson (95%) para a proporção k/n
+static void wilson(uint64_t k, uint64_t n, double *lo, double *hi) {
+    if (n == 0) { *lo = *hi = 0; return; }
+    double p = (double)k / n, z2 = Z95 * Z95;
+    double den = 1 + z2 / n;
+    double mid = (p + z2 / (2.0 * n)) / den;
+    double half = Z95 * sqrt(p * (1 - p) / n + z2 / (4.0 * n * n)) / den;
+    *lo = mid - half;
+    *hi = mid + half;
+}
+
+// Média e meia-largura do intervalo de 95% dos tiros até vencer
+static void shots_ci(const SideStats *s, double *mean, double *half) {
+    *mean = *half = 0;
+    if (s->wins == 0) return;
+    *mean = (double)s->shots / s->wins;
+    if (s->wins < 2) return;
+    double var = ((double)s->shots_sq - (double)s->wins * *mean * *mean) / (s->wins - 1);
+    *half = var > 0 ? Z95 * sqrt(var / s->wins) : 0;
+}
+
+static void print_side(const char *name, const SideStats *s, uint64_t games) {
+    double lo, hi, mean, half;
+    wilson(s->wins, games, &lo, &hi);
+    shots_ci(s, &mean, &half);
+    printf("  %-8s vitórias %6.2f%% [%6.2f, %6.2f]  tiros p/ vencer %9.2f ± %.2f\n",
+           name, 100.0 * s->wins / games, 100 * lo, 100 * hi, mean, half);
+}
+
+static bool parse_strategies(const char *list) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s", list);
+    strategy_count = 0;
+    for (char *save, *tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        int found = -1;
+        for (int i = 0; i < STRAT_COUNT; i++) {
+            if (strcasecmp(tok, strategy_names[i]) == 0) found = i;
+        }
+        if (found == -1 || strategy_count == STRAT_COUNT) return false;
+        strategies[strategy_count++] = found;
+    }
+    return strategy_count > 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Uso: %s [-s estratégias] [-n partidas] [-j threads] [-S semente] [-M modo] [-c lote]\n"
+        "  -s estratégias lista separada por vírgulas de seq, random, hunt, bot\n"
+        "                 (padrão todas); com uma só, ela joga contra si mesma\n"
+        "  -n partidas    partidas por confronto (padrão %d)\n"
+        "  -j threads     threads de simulação (padrão: núcleos online)\n"
+        "  -S semente     semente do torneio; o resultado não depende de -j (padrão 1)\n"
+        "  -M modo        CLASSICO, EVENTO ou NOME:LxA:TIPO=TAMxQTD[,...] (padrão CLASSICO)\n"
+        "  -c lote        partidas que uma thread tira da própria faixa por vez (padrão %d)\n",
+        prog, DEFAULT_GAMES, DEFAULT_CHUNK);
+}
+
+int main(int argc, char *argv[]) {
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+
+    mode = classic_game_mode();
+    parse_strategies("seq,random,hunt,bot");
+    while ((opt = getopt(argc, argv, "s:n:j:S:M:c:h")) != -1) {
+        switch (opt) {
+        case 's':
+            if (!parse_strategies(optarg)) {
+                fprintf(stderr, "Estratégias inválidas: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'n': games_per_pairing = strtoull(optarg, NULL, 10); break;
+        case 'j': threads = atol(optarg); break;
+        case 'S': seed = strtoull(optarg, NULL, 0); break;
+        case 'c': chunk = strtoull(optarg, NULL, 10); break;
+        case 'M':
+            if (strcasecmp(optarg, "CLASSICO") == 0) {
+                mode = classic_game_mode();
+            } else if (parse_game_mode(strcasecmp(optarg, "EVENTO") == 0 ? EVENT_MODE_SPEC : optarg,
+                                       &custom_mode)) {
+                mode = &custom_mode;
+            } else {
+                fprintf(stderr, "Modo inválido: %s\n", optarg);
+                return 2;
+            }
+            break;
+        default:  usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (games_per_pairing < 1 || threads < 1 || chunk < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // todos os pares de estratégias distintas; com uma só, espelho
+    for (int a = 0; a < strategy_count; a++) {
+        for (int b = a + 1; b < strategy_count; b++) pairings[pairing_count++] = (Pairing){ a, b };
+    }
+    if (strategy_count == 1) pairings[pairing_count++] = (Pairing){ 0, 0 };
+    uint64_t total = games_per_pairing * (uint64_t)pairing_count;
+    if ((uint64_t)threads > total) threads = (long)total;
+
+    worker_count = threads;
+    workers = calloc((size_t)threads, sizeof(*workers));
+    pthread_t *tids = calloc((size_t)threads, sizeof(*tids));
+    if (!workers || !tids) {
+        perror("calloc");
+        return 2;
+    }
+    for (long i = 0; i < threads; i++) {
+        Worker *w = &workers[i];
+        pthread_mutex_init(&w->lock, NULL);
+        w->id    = (int)i;
+        w->lo    = total * (uint64_t)i / (uint64_t)threads;
+        w->hi    = total * (uint64_t)(i + 1) / (uint64_t)threads;
+        w->stats = calloc((size_t)pairing_count * 2, sizeof(*w->stats));
+        if (!w->stats || !shooter_alloc(&w->shooters[0]) || !shooter_alloc(&w->shooters[1])) {
+            perror("malloc");
+            return 2;
+        }
+    }
+
+    printf("[TORNEIO] modo %s %dx%d, %d confronto(s) x %llu partidas, semente %llu\n",
+           mode->name, mode->width, mode->height, pairing_count,
+           (unsigned long long)games_per_pairing, (unsigned long long)seed);
+    fflush(stdout);
+
+    uint64_t start = now_us();
+    for (long i = 0; i < threads; i++) {
+        pthread_create(&tids[i], NULL, worker, &workers[i]);
+    }
+    uint64_t games = 0, shots = 0, steals = 0;
+    for (long i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        games  += workers[i].games;
+        shots  += workers[i].shots;
+        steals += workers[i].steals;
+    }
+    double secs = (now_us() - start) / 1e6;
+    if (secs <= 0) secs = 1e-6;
+
+    for (int p = 0; p < pairing_count; p++) {
+        SideStats side[2] = {{0}};
+        for (long i = 0; i < threads; i++) {
+            for (int s = 0; s < 2; s++) {
+                const SideStats *ws = &workers[i].stats[p * 2 + s];
+                side[s].wins       += ws->wins;
+                side[s].first_wins += ws->first_wins;
+                side[s].shots      += ws->shots;
+                side[s].shots_sq   += ws->shots_sq;
+            }
+        }
+        const char *a = strategy_names[strategies[pairings[p].a]];
+        const char *b = strategy_names[strategies[pairings[p].b]];
+        uint64_t first = side[0].first_wins + side[1].first_wins;
+        printf("%s x %s: %llu partidas, quem abre o fogo vence %.2f%%\n", a, b,
+               (unsigned long long)games_per_pairing, 100.0 * first / games_per_pairing);
+        print_side(a, &side[0], games_per_pairing);
+        print_side(b, &side[1], games_per_pairing);
+    }
+
+    unsigned long failed = atomic_load(&failures);
+    printf("[TORNEIO] %llu partidas em %.3fs com %ld thread(s): %.0f partidas/s, "
+           "%.0f tiros/s, %llu roubo(s), %lu falha(s)\n",
+           (unsigned long long)games, secs, threads, games / secs, shots / secs,
+           (unsigned long long)steals, failed);
+
+    for (long i = 0; i < threads; i++) {
+        shooter_free(&workers[i].shooters[0]);
+        shooter_free(&workers[i].shooters[1]);
+        free(workers[i].stats);
+        pthread_mutex_destroy(&workers[i].lock);
+    }
+    free(workers);
+    free(tids);
+    return failed ? 1 : 0;
+}